@@ -7,3 +7,25 @@ DROP FUNCTION IF EXISTS json_formatter_write(record);
 CREATE FUNCTION json_formatter_write(record) RETURNS bytea
 as '$libdir/json_formatter.so', 'json_formatter_write'
 LANGUAGE C STABLE;
+
+DROP FUNCTION IF EXISTS json_formatter_msgpack_read();
+CREATE FUNCTION json_formatter_msgpack_read() RETURNS record
+as '$libdir/json_formatter.so', 'json_formatter_msgpack_read'
+LANGUAGE C STABLE;
+
+DROP FUNCTION IF EXISTS json_formatter_msgpack_write(record);
+CREATE FUNCTION json_formatter_msgpack_write(record) RETURNS bytea
+as '$libdir/json_formatter.so', 'json_formatter_msgpack_write'
+LANGUAGE C STABLE;
+
+DROP FUNCTION IF EXISTS json_formatter_stats();
+CREATE FUNCTION json_formatter_stats(
+    OUT direction text, OUT calls bigint, OUT rows bigint, OUT rejected bigint,
+    OUT objects bigint, OUT filtered bigint, OUT bytes bigint, OUT max_object bigint,
+    OUT need_more bigint, OUT rescans bigint, OUT shape_hits bigint, OUT shape_misses bigint,
+    OUT inflate_ticks bigint, OUT scan_ticks bigint, OUT filter_ticks bigint,
+    OUT parse_ticks bigint, OUT lookup_ticks bigint, OUT convert_ticks bigint,
+    OUT form_ticks bigint, OUT write_ticks bigint
+) RETURNS SETOF record
+as '$libdir/json_formatter.so', 'json_formatter_stats'
+LANGUAGE C VOLATILE;
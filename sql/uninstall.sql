@@ -1,2 +1,5 @@
 DROP FUNCTION IF EXISTS json_formatter_read();
 DROP FUNCTION IF EXISTS json_formatter_write(record);
+DROP FUNCTION IF EXISTS json_formatter_msgpack_read();
+DROP FUNCTION IF EXISTS json_formatter_msgpack_write(record);
+DROP FUNCTION IF EXISTS json_formatter_stats();
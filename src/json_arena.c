@@ -0,0 +1,150 @@
+/*
+ * Copyright (c) 2013 Dillon Woods <dewoods@gmail.com>
+ *
+ * greenplum-json-formatter is free software; you can redistribute it and/or modify
+ * it under the terms of the MIT license. See LICENSE for details.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "json_formatter.h"
+
+#include "utils/memutils.h"
+
+/**
+ * Arena for jansson values
+ *
+ * jansson's allocation hooks are installed when the module is loaded.
+ * While an arena is active, every jansson allocation is carved from it
+ * and frees are ignored; the whole tree is released at once when the
+ * arena is reset.  Outside an arena the hooks fall back to malloc, so
+ * values that outlive a row (the writer's template) behave as before.
+ *
+ * Each allocation is preceded by a header saying where it came from, so
+ * a value can be freed correctly whichever way it was allocated.
+ */
+
+#define JSON_ARENA_HEAP     0x4A484541  /* allocated with malloc */
+#define JSON_ARENA_BUMP     0x4A415241  /* carved from an arena */
+
+typedef union {
+    uint32  tag;
+    double  align;      /* keep the value that follows maximally aligned */
+    void    *ptr;
+} json_arena_hdr_t;
+
+static json_arena_t *json_arena_current = NULL;
+
+static void *
+json_arena_malloc( size_t size ) {
+    json_arena_t        *arena = json_arena_current;
+    json_arena_hdr_t    *hdr;
+    Size                need = MAXALIGN( sizeof(json_arena_hdr_t) + size );
+
+    if( !arena ) {
+        hdr = malloc( sizeof(json_arena_hdr_t) + size );
+        if( !hdr )
+            return NULL;
+        hdr->tag = JSON_ARENA_HEAP;
+        return hdr + 1;
+    }
+
+    if( arena->end - arena->ptr < need ) {
+        /**
+         * The first block is kept across resets; anything more a row needs
+         * comes from the overflow context, which is emptied on reset
+         */
+        Size size = need > arena->block_size ? need : arena->block_size;
+
+        /* an allocation failure must not leave jansson pointed at the arena */
+        PG_TRY();
+        {
+            arena->ptr = MemoryContextAlloc( arena->overflow, size );
+        }
+        PG_CATCH();
+        {
+            json_arena_current = NULL;
+            PG_RE_THROW();
+        }
+        PG_END_TRY();
+
+        arena->end = arena->ptr + size;
+        arena->overflowed = true;
+    }
+
+    hdr = (json_arena_hdr_t *)arena->ptr;
+    hdr->tag = JSON_ARENA_BUMP;
+    arena->ptr += need;
+
+    return hdr + 1;
+}
+
+/**
+ * Also used to free memory jansson returns, such as json_dumps output
+ */
+void
+json_arena_free( void *ptr ) {
+    json_arena_hdr_t *hdr;
+
+    if( !ptr )
+        return;
+
+    hdr = (json_arena_hdr_t *)ptr - 1;
+    if( hdr->tag == JSON_ARENA_HEAP )
+        free( hdr );
+}
+
+/**
+ * Route jansson's allocations through the arena hooks.  Must run before
+ * any jansson value is created, so it is called from _PG_init.
+ */
+void
+json_arena_install( void ) {
+    json_set_alloc_funcs( json_arena_malloc, json_arena_free );
+}
+
+json_arena_t *
+json_arena_create( MemoryContext parent, Size block_size ) {
+    json_arena_t *arena = MemoryContextAlloc( parent, sizeof(json_arena_t) );
+
+    arena->block_size = MAXALIGN( block_size );
+    arena->block = MemoryContextAlloc( parent, arena->block_size );
+    arena->overflow = AllocSetContextCreate( parent,
+                                             "json_formatter arena",
+                                             ALLOCSET_DEFAULT_MINSIZE,
+                                             ALLOCSET_DEFAULT_INITSIZE,
+                                             ALLOCSET_DEFAULT_MAXSIZE );
+    arena->overflowed = false;
+    arena->ptr = arena->block;
+    arena->end = arena->block + arena->block_size;
+
+    return arena;
+}
+
+/**
+ * Make jansson allocate from arena until json_arena_end
+ */
+void
+json_arena_begin( json_arena_t *arena ) {
+    json_arena_current = arena;
+}
+
+void
+json_arena_end( void ) {
+    json_arena_current = NULL;
+}
+
+/**
+ * Release everything allocated from the arena
+ */
+void
+json_arena_reset( json_arena_t *arena ) {
+    if( arena->overflowed ) {
+        MemoryContextReset( arena->overflow );
+        arena->overflowed = false;
+    }
+
+    arena->ptr = arena->block;
+    arena->end = arena->block + arena->block_size;
+}
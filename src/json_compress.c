@@ -0,0 +1,281 @@
+/*
+ * Copyright (c) 2013 Dillon Woods <dewoods@gmail.com>
+ *
+ * greenplum-json-formatter is free software; you can redistribute it and/or modify
+ * it under the terms of the MIT license. See LICENSE for details.
+ */
+
+#include <string.h>
+
+#include <zlib.h>
+
+#ifdef JSON_ZSTD
+#define ZSTD_STATIC_LINKING_ONLY
+#include <zstd.h>
+#endif
+
+#include "json_formatter.h"
+
+#include "utils/memutils.h"
+
+/**
+ * Compressed input
+ *
+ * gzip input may hold several concatenated members and zstd input several
+ * frames, as written by tools that compress in parallel or append.  Both
+ * libraries allocate from a memory context of their own, which lives as
+ * long as the scan.
+ */
+
+static voidpf
+json_zalloc( voidpf opaque, uInt items, uInt size ) {
+    return MemoryContextAlloc( (MemoryContext)opaque, (Size)items * size );
+}
+
+static void
+json_zfree( voidpf opaque, voidpf ptr ) {
+    pfree( ptr );
+}
+
+#ifdef JSON_ZSTD
+static void *
+json_zstd_alloc( void *opaque, size_t size ) {
+    return MemoryContextAlloc( (MemoryContext)opaque, size );
+}
+
+static void
+json_zstd_free( void *opaque, void *ptr ) {
+    if( ptr )
+        pfree( ptr );
+}
+#endif
+
+static MemoryContext
+json_compress_context( void ) {
+    return AllocSetContextCreate( CurrentMemoryContext,
+                                  "json_formatter compression",
+                                  ALLOCSET_DEFAULT_MINSIZE,
+                                  ALLOCSET_DEFAULT_INITSIZE,
+                                  ALLOCSET_DEFAULT_MAXSIZE );
+}
+
+/**
+ * Parse the 'compression' option
+ */
+json_compress_t
+json_compress_parse( const char *val ) {
+    if( strcmp( val, "none" ) == 0 )
+        return JSON_COMPRESS_NONE;
+    if( strcmp( val, "gzip" ) == 0 )
+        return JSON_COMPRESS_GZIP;
+    if( strcmp( val, "zstd" ) == 0 ) {
+#ifndef JSON_ZSTD
+        ereport( ERROR, (
+            errcode( ERRCODE_INVALID_PARAMETER_VALUE ),
+            errmsg( "Invalid compression 'zstd', json_formatter was built without zstd support" )
+        ) );
+#endif
+        return JSON_COMPRESS_ZSTD;
+    }
+
+    ereport( ERROR, (
+        errcode( ERRCODE_INVALID_PARAMETER_VALUE ),
+        errmsg( "Invalid compression '%s', expected 'gzip', 'zstd' or 'none'", val )
+    ) );
+    return JSON_COMPRESS_NONE;
+}
+
+json_inflate_t *
+json_inflate_create( json_compress_t method ) {
+    json_inflate_t  *z = palloc( sizeof(json_inflate_t) );
+
+    z->method = method;
+    z->ctx = json_compress_context();
+    z->in = NULL;
+    z->in_cur = 0;
+    z->in_len = 0;
+    z->in_size = 0;
+    z->size = JSON_INFLATE_WINDOW_SIZE;
+    z->buf = MemoryContextAlloc( z->ctx, z->size + 1 );
+    z->cur = 0;
+    z->len = 0;
+    z->skip = 0;
+    z->pending = false;
+    z->partial = false;
+
+    if( method == JSON_COMPRESS_GZIP ) {
+        z_stream *zs = MemoryContextAllocZero( z->ctx, sizeof(z_stream) );
+
+        zs->zalloc = json_zalloc;
+        zs->zfree = json_zfree;
+        zs->opaque = (voidpf)z->ctx;
+
+        /* gzip header and trailer only */
+        if( inflateInit2( zs, 16 + MAX_WBITS ) != Z_OK )
+            elog( ERROR, "Could not initialize gzip decoder" );
+        z->stream = zs;
+    }
+#ifdef JSON_ZSTD
+    else {
+        ZSTD_customMem mem = { json_zstd_alloc, json_zstd_free, (void *)z->ctx };
+
+        z->stream = ZSTD_createDCtx_advanced( mem );
+        if( !z->stream )
+            elog( ERROR, "Could not initialize zstd decoder" );
+    }
+#endif
+
+    return z;
+}
+
+/**
+ * Take new compressed bytes from the data buffer
+ */
+void
+json_inflate_input( json_inflate_t *z, const char *buf, int len ) {
+    if( len <= 0 )
+        return;
+
+    if( z->in_cur > 0 ) {
+        memmove( z->in, z->in + z->in_cur, z->in_len - z->in_cur );
+        z->in_len -= z->in_cur;
+        z->in_cur = 0;
+    }
+
+    if( z->in_len + len > z->in_size ) {
+        z->in_size = z->in_len + len;
+        z->in = z->in ? repalloc( z->in, z->in_size ) : MemoryContextAlloc( z->ctx, z->in_size );
+    }
+
+    memcpy( z->in + z->in_len, buf, len );
+    z->in_len += len;
+}
+
+static void
+json_inflate_gzip( json_inflate_t *z ) {
+    z_stream    *zs = z->stream;
+    int         ret;
+
+    zs->next_in = (Bytef *)z->in + z->in_cur;
+    zs->avail_in = z->in_len - z->in_cur;
+    zs->next_out = (Bytef *)z->buf + z->len;
+    zs->avail_out = z->size - z->len;
+
+    while( zs->avail_out > 0 ) {
+        /* the next member starts where the last one ended */
+        if( !z->partial ) {
+            if( zs->avail_in == 0 )
+                break;
+            inflateReset( zs );
+            z->partial = true;
+        }
+
+        ret = inflate( zs, Z_NO_FLUSH );
+        if( ret == Z_STREAM_END ) {
+            z->partial = false;
+        } else if( ret == Z_BUF_ERROR ) {
+            break;
+        } else if( ret != Z_OK ) {
+            ereport( ERROR, (
+                errcode( ERRCODE_DATA_EXCEPTION ),
+                errmsg( "Invalid gzip input: %s", zs->msg ? zs->msg : "corrupt data" )
+            ) );
+        }
+    }
+
+    z->in_cur = z->in_len - zs->avail_in;
+    z->len = z->size - zs->avail_out;
+    z->pending = (zs->avail_out == 0);
+}
+
+#ifdef JSON_ZSTD
+static void
+json_inflate_zstd( json_inflate_t *z ) {
+    ZSTD_inBuffer   in = { z->in + z->in_cur, z->in_len - z->in_cur, 0 };
+    ZSTD_outBuffer  out = { z->buf, z->size, z->len };
+
+    while( out.pos < out.size ) {
+        size_t  inpos = in.pos;
+        size_t  outpos = out.pos;
+        size_t  ret = ZSTD_decompressStream( z->stream, &out, &in );
+
+        if( ZSTD_isError( ret ) ) {
+            ereport( ERROR, (
+                errcode( ERRCODE_DATA_EXCEPTION ),
+                errmsg( "Invalid zstd input: %s", ZSTD_getErrorName( ret ) )
+            ) );
+        }
+
+        if( in.pos == inpos && out.pos == outpos )
+            break;
+
+        /* 0 once a frame is decoded and flushed */
+        z->partial = (ret != 0);
+    }
+
+    z->in_cur += in.pos;
+    z->len = out.pos;
+    z->pending = (out.pos == out.size);
+}
+#endif
+
+/**
+ * Decode more input into the window after the bytes from the cursor on,
+ * which are moved to its start.  The window doubles when those bytes
+ * already fill it, so an object never has to fit a fixed size.  Returns
+ * true if splitting again may find more: bytes were added, or the input
+ * has just been drained, which may be the end of it.
+ */
+bool
+json_inflate_fill( json_inflate_t *z ) {
+    bool    was_drained = json_inflate_drained( z );
+    int     before;
+
+    if( z->cur > 0 ) {
+        memmove( z->buf, z->buf + z->cur, z->len - z->cur );
+        z->len -= z->cur;
+        z->cur = 0;
+    }
+
+    if( z->len == z->size ) {
+        z->size *= 2;
+        z->buf = repalloc( z->buf, z->size + 1 );
+    }
+
+    before = z->len;
+
+#ifdef JSON_ZSTD
+    if( z->method == JSON_COMPRESS_ZSTD )
+        json_inflate_zstd( z );
+    else
+#endif
+        json_inflate_gzip( z );
+
+    /* error messages print the window from the cursor on */
+    z->buf[z->len] = '\0';
+
+    return z->len > before || (!was_drained && json_inflate_drained( z ));
+}
+
+/**
+ * Every byte taken so far has been decoded into the window
+ */
+bool
+json_inflate_drained( json_inflate_t *z ) {
+    return z->in_cur == z->in_len && !z->pending;
+}
+
+/**
+ * At the end of the input, fail if it stopped inside a member or frame
+ */
+void
+json_inflate_finish( json_inflate_t *z ) {
+    if( z->partial ) {
+        ereport( ERROR, (
+            errcode( ERRCODE_DATA_EXCEPTION ),
+            errmsg( "Truncated %s input, the last %s is incomplete",
+                    z->method == JSON_COMPRESS_GZIP ? "gzip" : "zstd",
+                    z->method == JSON_COMPRESS_GZIP ? "member" : "frame" )
+        ) );
+    }
+}
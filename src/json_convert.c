@@ -0,0 +1,718 @@
+/*
+ * Copyright (c) 2013 Dillon Woods <dewoods@gmail.com>
+ *
+ * greenplum-json-formatter is free software; you can redistribute it and/or modify
+ * it under the terms of the MIT license. See LICENSE for details.
+ */
+
+#include <errno.h>
+#include <float.h>
+#include <limits.h>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "json_formatter.h"
+
+#include "fmgr.h"
+#include "catalog/pg_type.h"
+#include "mb/pg_wchar.h"
+#include "utils/array.h"
+#include "utils/builtins.h"
+#include "utils/date.h"
+#include "utils/datetime.h"
+#include "utils/lsyscache.h"
+#include "utils/timestamp.h"
+
+/**
+ * Column converters
+ *
+ * Each column gets a converter chosen from its type when the scan starts.
+ * Converters turn a token straight into a Datum without going through the
+ * type's input function.  Values a fast path does not handle (numerics,
+ * timestamps without an explicit zone, ...) are left to the type's input
+ * function, which is called when the row is handed out so that any error
+ * it raises belongs to that row.
+ */
+
+static json_convert_result_t
+convert_fail( json_column_t *col, json_read_error_t *err, json_read_status_t status ) {
+    err->status = status;
+    err->attnum = col->attnum;
+    err->detail = col->expected;
+    return JSON_CONVERT_ERROR;
+}
+
+/**
+ * Parse the digits of an integer token, which the extractor has already
+ * checked against the JSON grammar
+ */
+static bool
+convert_int64( const char *s, int len, int64 *result ) {
+    const char  *end = s + len;
+    bool        neg = false;
+    uint64      limit;
+    uint64      val = 0;
+
+    if( s < end && *s == '-' ) {
+        neg = true;
+        s++;
+    }
+
+    limit = neg ? (uint64)INT64CONST(0x7FFFFFFFFFFFFFFF) + 1 : (uint64)INT64CONST(0x7FFFFFFFFFFFFFFF);
+
+    for( ; s < end; s++ ) {
+        uint64 digit = *s - '0';
+
+        if( val > (limit - digit) / 10 )
+            return false;
+        val = val * 10 + digit;
+    }
+
+    *result = neg ? (int64)(0 - val) : (int64)val;
+    return true;
+}
+
+static json_convert_result_t
+convert_int2( json_column_t *col, json_token_t *tok, Datum *value, json_read_error_t *err ) {
+    int64   val;
+
+    if( tok->type != JSON_TOK_INTEGER )
+        return convert_fail( col, err, JSON_READ_TYPE_ERROR );
+
+    if( !convert_int64( tok->start, tok->len, &val ) || val < SHRT_MIN || val > SHRT_MAX )
+        return convert_fail( col, err, JSON_READ_RANGE_ERROR );
+
+    *value = Int16GetDatum( (int16)val );
+    return JSON_CONVERT_OK;
+}
+
+static json_convert_result_t
+convert_int4( json_column_t *col, json_token_t *tok, Datum *value, json_read_error_t *err ) {
+    int64   val;
+
+    if( tok->type != JSON_TOK_INTEGER )
+        return convert_fail( col, err, JSON_READ_TYPE_ERROR );
+
+    if( !convert_int64( tok->start, tok->len, &val ) || val < INT_MIN || val > INT_MAX )
+        return convert_fail( col, err, JSON_READ_RANGE_ERROR );
+
+    *value = Int32GetDatum( (int32)val );
+    return JSON_CONVERT_OK;
+}
+
+static json_convert_result_t
+convert_int8( json_column_t *col, json_token_t *tok, Datum *value, json_read_error_t *err ) {
+    int64   val;
+
+    if( tok->type != JSON_TOK_INTEGER )
+        return convert_fail( col, err, JSON_READ_TYPE_ERROR );
+
+    if( !convert_int64( tok->start, tok->len, &val ) )
+        return convert_fail( col, err, JSON_READ_RANGE_ERROR );
+
+    *value = Int64GetDatum( val );
+    return JSON_CONVERT_OK;
+}
+
+/**
+ * strtod needs a terminated string; numbers longer than the stack buffer
+ * are copied to the heap
+ */
+static bool
+convert_double( const char *s, int len, double *result ) {
+    char    buf[64];
+    char    *str = len < (int)sizeof(buf) ? buf : palloc( len + 1 );
+    char    *end;
+    double  val;
+
+    memcpy( str, s, len );
+    str[len] = '\0';
+
+    errno = 0;
+    val = strtod( str, &end );
+
+    if( str != buf )
+        pfree( str );
+
+    if( errno == ERANGE && (val == 0.0 || isinf( val )) )
+        return false;
+
+    *result = val;
+    return true;
+}
+
+static json_convert_result_t
+convert_float4( json_column_t *col, json_token_t *tok, Datum *value, json_read_error_t *err ) {
+    double  val;
+
+    if( tok->type != JSON_TOK_REAL && tok->type != JSON_TOK_INTEGER )
+        return convert_fail( col, err, JSON_READ_TYPE_ERROR );
+
+    if( !convert_double( tok->start, tok->len, &val )
+        || isinf( (float4)val ) || ((float4)val == 0.0 && val != 0.0) )
+        return convert_fail( col, err, JSON_READ_RANGE_ERROR );
+
+    *value = Float4GetDatum( (float4)val );
+    return JSON_CONVERT_OK;
+}
+
+static json_convert_result_t
+convert_float8( json_column_t *col, json_token_t *tok, Datum *value, json_read_error_t *err ) {
+    double  val;
+
+    if( tok->type != JSON_TOK_REAL && tok->type != JSON_TOK_INTEGER )
+        return convert_fail( col, err, JSON_READ_TYPE_ERROR );
+
+    if( !convert_double( tok->start, tok->len, &val ) )
+        return convert_fail( col, err, JSON_READ_RANGE_ERROR );
+
+    *value = Float8GetDatum( val );
+    return JSON_CONVERT_OK;
+}
+
+static json_convert_result_t
+convert_bool( json_column_t *col, json_token_t *tok, Datum *value, json_read_error_t *err ) {
+    if( tok->type != JSON_TOK_TRUE && tok->type != JSON_TOK_FALSE )
+        return convert_fail( col, err, JSON_READ_TYPE_ERROR );
+
+    *value = BoolGetDatum( tok->type == JSON_TOK_TRUE );
+    return JSON_CONVERT_OK;
+}
+
+/**
+ * Strings are unescaped; every other value is stored as it appeared in
+ * the input, copied once into the varlena.  varchar(n) limits are checked
+ * in characters.
+ */
+static json_convert_result_t
+convert_text( json_column_t *col, json_token_t *tok, Datum *value, json_read_error_t *err ) {
+    text    *txtval;
+    int     len;
+
+    if( !tok->prepared && !json_sax_valid_utf8( tok->start, tok->len ) ) {
+        err->status = JSON_READ_PARSE_ERROR;
+        err->attnum = col->attnum;
+        err->detail = "invalid UTF-8";
+        return JSON_CONVERT_ERROR;
+    }
+
+    txtval = palloc( tok->len + VARHDRSZ );
+
+    if( tok->prepared ) {
+        len = tok->len;
+        memcpy( VARDATA(txtval), tok->start, len );
+    } else if( tok->type == JSON_TOK_STRING && tok->escaped ) {
+        len = json_sax_unescape( tok->start, tok->len, VARDATA(txtval) );
+        if( len < 0 ) {
+            pfree( txtval );
+            err->status = JSON_READ_PARSE_ERROR;
+            err->attnum = col->attnum;
+            err->detail = "invalid \\u escape";
+            return JSON_CONVERT_ERROR;
+        }
+    } else if( col->minify && (tok->type == JSON_TOK_OBJECT || tok->type == JSON_TOK_ARRAY) ) {
+        len = json_sax_minify( tok->start, tok->len, VARDATA(txtval) );
+    } else {
+        len = tok->len;
+        memcpy( VARDATA(txtval), tok->start, len );
+    }
+
+    if( col->maxlen >= 0 && len > col->maxlen
+        && pg_mbstrlen_with_len( VARDATA(txtval), len ) > col->maxlen ) {
+        pfree( txtval );
+        return convert_fail( col, err, JSON_READ_RANGE_ERROR );
+    }
+
+    SET_VARSIZE( txtval, len + VARHDRSZ );
+    *value = PointerGetDatum( txtval );
+
+    return JSON_CONVERT_OK;
+}
+
+/**
+ * json columns store the value's JSON text as the engine found it
+ */
+static json_convert_result_t
+convert_json( json_column_t *col, json_token_t *tok, Datum *value, json_read_error_t *err ) {
+    text    *txtval;
+
+    if( !json_sax_valid_utf8( tok->start, tok->len ) ) {
+        err->status = JSON_READ_PARSE_ERROR;
+        err->attnum = col->attnum;
+        err->detail = "invalid UTF-8";
+        return JSON_CONVERT_ERROR;
+    }
+
+    txtval = palloc( tok->len + VARHDRSZ );
+    SET_VARSIZE( txtval, tok->len + VARHDRSZ );
+    memcpy( VARDATA(txtval), tok->start, tok->len );
+    *value = PointerGetDatum( txtval );
+
+    return JSON_CONVERT_OK;
+}
+
+static json_convert_result_t
+convert_numeric( json_column_t *col, json_token_t *tok, Datum *value, json_read_error_t *err ) {
+    if( tok->type != JSON_TOK_REAL && tok->type != JSON_TOK_INTEGER )
+        return convert_fail( col, err, JSON_READ_TYPE_ERROR );
+
+    return JSON_CONVERT_DEFER;
+}
+
+/**
+ * Fixed width unsigned decimal field
+ */
+static bool
+convert_digits( const char *s, int n, int *result ) {
+    int i, val = 0;
+
+    for( i=0; i < n; i++ ) {
+        if( s[i] < '0' || s[i] > '9' )
+            return false;
+        val = val * 10 + (s[i] - '0');
+    }
+
+    *result = val;
+    return true;
+}
+
+/**
+ * YYYY-MM-DD
+ */
+static bool
+convert_ymd( const char *s, int len, struct pg_tm *tm ) {
+    if( len < 10 || s[4] != '-' || s[7] != '-'
+        || !convert_digits( s, 4, &tm->tm_year )
+        || !convert_digits( s + 5, 2, &tm->tm_mon )
+        || !convert_digits( s + 8, 2, &tm->tm_mday ) )
+        return false;
+
+    if( tm->tm_year < 1 || tm->tm_mon < 1 || tm->tm_mon > 12 || tm->tm_mday < 1
+        || tm->tm_mday > day_tab[isleap( tm->tm_year )][tm->tm_mon - 1] )
+        return false;
+
+    return true;
+}
+
+/**
+ * YYYY-MM-DD[T ]HH:MM:SS[.ffffff], returning the length parsed.  Anything
+ * beyond microsecond precision, or beyond the column's precision, is left
+ * to the input function so rounding matches it.
+ */
+static int
+convert_ymdhms( json_column_t *col, const char *s, int len, struct pg_tm *tm, fsec_t *fsec ) {
+    int     i = 19;
+    int     frac = 0;
+    int     ndigits = 0;
+
+    if( !convert_ymd( s, len, tm ) || len < 19 || (s[10] != 'T' && s[10] != ' ')
+        || s[13] != ':' || s[16] != ':'
+        || !convert_digits( s + 11, 2, &tm->tm_hour )
+        || !convert_digits( s + 14, 2, &tm->tm_min )
+        || !convert_digits( s + 17, 2, &tm->tm_sec ) )
+        return -1;
+
+    if( tm->tm_hour > 23 || tm->tm_min > 59 || tm->tm_sec > 59 )
+        return -1;
+
+    if( i < len && s[i] == '.' ) {
+        for( i++; i < len && s[i] >= '0' && s[i] <= '9'; i++ ) {
+            if( ++ndigits > 6 )
+                return -1;
+            frac = frac * 10 + (s[i] - '0');
+        }
+
+        if( ndigits == 0 || (col->typmod >= 0 && ndigits > col->typmod) )
+            return -1;
+    }
+
+    for( ; ndigits < 6; ndigits++ )
+        frac *= 10;
+
+#ifdef JSON_FSEC_SCALE
+    *fsec = frac;
+#else
+    *fsec = frac / 1000000.0;
+#endif
+
+    return i;
+}
+
+static json_convert_result_t
+convert_date( json_column_t *col, json_token_t *tok, Datum *value, json_read_error_t *err ) {
+    struct pg_tm    tm;
+
+    if( tok->type != JSON_TOK_STRING )
+        return convert_fail( col, err, JSON_READ_TYPE_ERROR );
+
+    if( tok->escaped || tok->len != 10 || !convert_ymd( tok->start, tok->len, &tm ) )
+        return JSON_CONVERT_DEFER;
+
+    *value = DateADTGetDatum( date2j( tm.tm_year, tm.tm_mon, tm.tm_mday ) - POSTGRES_EPOCH_JDATE );
+    return JSON_CONVERT_OK;
+}
+
+static json_convert_result_t
+convert_timestamp( json_column_t *col, json_token_t *tok, Datum *value, json_read_error_t *err ) {
+    struct pg_tm    tm;
+    fsec_t          fsec;
+    Timestamp       result;
+
+    if( tok->type != JSON_TOK_STRING )
+        return convert_fail( col, err, JSON_READ_TYPE_ERROR );
+
+    if( tok->escaped || convert_ymdhms( col, tok->start, tok->len, &tm, &fsec ) != tok->len
+        || tm2timestamp( &tm, fsec, NULL, &result ) != 0 )
+        return JSON_CONVERT_DEFER;
+
+    *value = TimestampGetDatum( result );
+    return JSON_CONVERT_OK;
+}
+
+/**
+ * Only timestamps with an explicit zone (Z, +HH, +HHMM or +HH:MM) take the
+ * fast path; the rest depend on the session time zone
+ */
+static json_convert_result_t
+convert_timestamptz( json_column_t *col, json_token_t *tok, Datum *value, json_read_error_t *err ) {
+    struct pg_tm    tm;
+    fsec_t          fsec;
+    TimestampTz     result;
+    const char      *s = tok->start;
+    int             len = tok->len;
+    int             i, tz, hh, mm = 0;
+
+    if( tok->type != JSON_TOK_STRING )
+        return convert_fail( col, err, JSON_READ_TYPE_ERROR );
+
+    if( tok->escaped || (i = convert_ymdhms( col, s, len, &tm, &fsec )) < 0 )
+        return JSON_CONVERT_DEFER;
+
+    if( len - i == 1 && s[i] == 'Z' ) {
+        tz = 0;
+    } else if( (len - i == 3 || len - i == 5 || len - i == 6) && (s[i] == '+' || s[i] == '-')
+        && convert_digits( s + i + 1, 2, &hh )
+        && (len - i == 3
+            || (len - i == 5 && convert_digits( s + i + 3, 2, &mm ))
+            || (len - i == 6 && s[i + 3] == ':' && convert_digits( s + i + 4, 2, &mm )))
+        && hh <= 15 && mm <= 59 ) {
+        /* PostgreSQL counts zone offsets in seconds west of UTC */
+        tz = (hh * 3600 + mm * 60) * (s[i] == '+' ? -1 : 1);
+    } else {
+        return JSON_CONVERT_DEFER;
+    }
+
+    if( tm2timestamp( &tm, fsec, &tz, &result ) != 0 )
+        return JSON_CONVERT_DEFER;
+
+    *value = TimestampTzGetDatum( result );
+    return JSON_CONVERT_OK;
+}
+
+static json_convert_result_t
+convert_unsupported( json_column_t *col, json_token_t *tok, Datum *value, json_read_error_t *err ) {
+    return convert_fail( col, err, JSON_READ_UNSUPPORTED );
+}
+
+/**
+ * Convert each member of an array with the element's converter.  When an
+ * element is left to the input function the whole array is deferred,
+ * unless input is set, in which case it is converted on the spot.
+ */
+static json_convert_result_t
+convert_array_build( json_column_t *col, json_token_t *tok, Datum *value, json_read_error_t *err, bool input ) {
+    json_column_t   *elem = col->element;
+    json_elems_t    *elems = &col->elems;
+    Datum           *values;
+    bool            *nulls;
+    bool            deferred = false;
+    int             dims[1];
+    int             lbs[1];
+    int             i;
+
+    if( tok->type != JSON_TOK_ARRAY )
+        return convert_fail( col, err, JSON_READ_TYPE_ERROR );
+
+    if( !json_sax_elements( tok->start, tok->len, elems ) ) {
+        err->status = JSON_READ_PARSE_ERROR;
+        err->attnum = col->attnum;
+        err->detail = "invalid array";
+        return JSON_CONVERT_ERROR;
+    }
+
+    values = palloc( sizeof(Datum) * (elems->count + 1) );
+    nulls = palloc( sizeof(bool) * (elems->count + 1) );
+
+    for( i=0; i < elems->count; i++ ) {
+        json_token_t etok = elems->toks[i];
+
+        nulls[i] = (etok.type == JSON_TOK_NULL);
+        if( nulls[i] )
+            continue;
+
+        if( elem->raw && etok.type == JSON_TOK_STRING ) {
+            etok.start--;
+            etok.len += 2;
+        }
+
+        switch( elem->convert( elem, &etok, &values[i], err ) ) {
+            case JSON_CONVERT_OK:
+                break;
+            case JSON_CONVERT_DEFER:
+                if( input )
+                    values[i] = json_convert_input( elem, &etok );
+                else
+                    deferred = true;
+                break;
+            default:
+                return JSON_CONVERT_ERROR;
+        }
+    }
+
+    if( deferred )
+        return JSON_CONVERT_DEFER;
+
+    dims[0] = elems->count;
+    lbs[0] = 1;
+
+    if( elems->count == 0 )
+        *value = PointerGetDatum( construct_empty_array( elem->typid ) );
+    else
+        *value = PointerGetDatum( construct_md_array( values, nulls, 1, dims, lbs, elem->typid,
+                                                      col->elmlen, col->elmbyval, col->elmalign ) );
+
+    pfree( values );
+    pfree( nulls );
+
+    return JSON_CONVERT_OK;
+}
+
+static json_convert_result_t
+convert_array( json_column_t *col, json_token_t *tok, Datum *value, json_read_error_t *err ) {
+    return convert_array_build( col, tok, value, err, false );
+}
+
+static void convert_choose( json_column_t *col );
+
+/**
+ * One dimensional arrays of any supported type are read from JSON arrays
+ */
+static void
+convert_array_setup( json_column_t *col, Oid elmtype ) {
+    json_column_t *elem = palloc0( sizeof(json_column_t) );
+
+    elem->attnum = col->attnum;
+    elem->typid = elmtype;
+    elem->typmod = col->typmod;
+    elem->maxlen = -1;
+    convert_choose( elem );
+
+    if( elem->convert == convert_unsupported ) {
+        pfree( elem );
+        col->convert = convert_unsupported;
+        col->expected = NULL;
+        return;
+    }
+
+    get_typlenbyvalalign( elmtype, &col->elmlen, &col->elmbyval, &col->elmalign );
+
+    col->element = elem;
+    col->convert = convert_array;
+    col->expected = "array";
+    col->elems.count = 0;
+    col->elems.max = 16;
+    col->elems.toks = palloc( sizeof(json_token_t) * col->elems.max );
+}
+
+/**
+ * Choose the converter for a column's type
+ */
+static void
+convert_choose( json_column_t *col ) {
+    Oid elmtype;
+
+    switch( col->typid ) {
+        case INT2OID:
+            col->convert = convert_int2;
+            col->expected = "number";
+            break;
+        case INT4OID:
+            col->convert = convert_int4;
+            col->expected = "number";
+            break;
+        case INT8OID:
+            col->convert = convert_int8;
+            col->expected = "number";
+            break;
+        case FLOAT4OID:
+            col->convert = convert_float4;
+            col->expected = "float4";
+            break;
+        case FLOAT8OID:
+            col->convert = convert_float8;
+            col->expected = "float8";
+            break;
+        case NUMERICOID:
+            col->convert = convert_numeric;
+            col->infunc = numeric_in;
+            col->expected = "number";
+            break;
+        case BOOLOID:
+            col->convert = convert_bool;
+            col->expected = "boolean";
+            break;
+        case DATEOID:
+            col->convert = convert_date;
+            col->infunc = date_in;
+            col->expected = "date";
+            break;
+        case TIMESTAMPOID:
+            col->convert = convert_timestamp;
+            col->infunc = timestamp_in;
+            col->expected = "timestamp";
+            break;
+        case TIMESTAMPTZOID:
+            col->convert = convert_timestamptz;
+            col->infunc = timestamptz_in;
+            col->expected = "timestamptz";
+            break;
+        case TEXTOID:
+            col->convert = convert_text;
+            col->expected = "text";
+            break;
+        case VARCHAROID:
+            col->convert = convert_text;
+            col->expected = "varchar";
+            if( col->typmod >= (int32)VARHDRSZ ) {
+                char *expected = palloc( 32 );
+
+                col->maxlen = col->typmod - VARHDRSZ;
+                snprintf( expected, 32, "varchar(%d)", col->maxlen );
+                col->expected = expected;
+            }
+            break;
+#ifdef JSONOID
+        case JSONOID:
+            col->convert = convert_json;
+            col->expected = "json";
+            col->raw = true;
+            break;
+#endif
+        default:
+            elmtype = get_element_type( col->typid );
+            if( elmtype != InvalidOid ) {
+                convert_array_setup( col, elmtype );
+            } else {
+                col->convert = convert_unsupported;
+                col->expected = NULL;
+            }
+            break;
+    }
+}
+
+/**
+ * Choose a converter for every column
+ */
+json_column_t *
+json_convert_setup( TupleDesc tupdesc ) {
+    json_column_t   *cols = palloc0( sizeof(json_column_t) * tupdesc->natts );
+    int             i;
+
+    for( i=0; i < tupdesc->natts; i++ ) {
+        json_column_t   *col = &cols[i];
+
+        col->attnum = i;
+        col->typid = tupdesc->attrs[i]->atttypid;
+        col->typmod = tupdesc->attrs[i]->atttypmod;
+        col->maxlen = -1;
+        col->raw = false;
+        col->minify = false;
+        col->infunc = NULL;
+        col->element = NULL;
+
+        convert_choose( col );
+    }
+
+    return cols;
+}
+
+/**
+ * Check a text column's value ahead of its conversion, on a worker thread,
+ * unescaping or minifying it into buf, which must hold tok->len bytes.
+ * Only the token and buf are touched.  A value that fails a check is left
+ * as it was, so the converter fails on it in column order.  Returns the
+ * bytes of buf used.
+ */
+int
+json_convert_prepare( json_column_t *col, json_token_t *tok, char *buf ) {
+    int len;
+
+    if( col->convert != convert_text || tok->type == JSON_TOK_NONE || tok->type == JSON_TOK_NULL )
+        return 0;
+
+    if( !json_sax_valid_utf8( tok->start, tok->len ) )
+        return 0;
+
+    if( tok->type == JSON_TOK_STRING && tok->escaped ) {
+        len = json_sax_unescape( tok->start, tok->len, buf );
+        if( len < 0 )
+            return 0;
+    } else if( col->minify && (tok->type == JSON_TOK_OBJECT || tok->type == JSON_TOK_ARRAY) ) {
+        len = json_sax_minify( tok->start, tok->len, buf );
+    } else {
+        tok->prepared = true;
+        return 0;
+    }
+
+    tok->start = buf;
+    tok->len = len;
+    tok->escaped = false;
+    tok->prepared = true;
+
+    return len;
+}
+
+/**
+ * Convert a value the fast path left behind with the column's input
+ * function.  Runs while the row is being handed out, so errors are raised
+ * against it.
+ */
+Datum
+json_convert_input( json_column_t *col, json_token_t *tok ) {
+    char    *str;
+    int     len = tok->len;
+
+    if( col->element ) {
+        json_read_error_t   err;
+        Datum               value;
+
+        if( convert_array_build( col, tok, &value, &err, true ) != JSON_CONVERT_OK )
+            ereport( ERROR, (
+                errcode( ERRCODE_INVALID_TEXT_REPRESENTATION ),
+                errmsg( "Could not convert JSON array" )
+            ) );
+
+        return value;
+    }
+
+    str = palloc( tok->len + 1 );
+
+    if( tok->type == JSON_TOK_STRING && tok->escaped ) {
+        len = json_sax_unescape( tok->start, tok->len, str );
+        if( len < 0 )
+            ereport( ERROR, (
+                errcode( ERRCODE_INVALID_TEXT_REPRESENTATION ),
+                errmsg( "Could not parse JSON string: invalid \\u escape" )
+            ) );
+    } else {
+        memcpy( str, tok->start, len );
+    }
+    str[len] = '\0';
+
+    return DirectFunctionCall3( col->infunc,
+                                CStringGetDatum( str ),
+                                ObjectIdGetDatum( InvalidOid ),
+                                Int32GetDatum( col->typmod ) );
+}
@@ -0,0 +1,284 @@
+/*
+ * Copyright (c) 2013 Dillon Woods <dewoods@gmail.com>
+ *
+ * greenplum-json-formatter is free software; you can redistribute it and/or modify
+ * it under the terms of the MIT license. See LICENSE for details.
+ */
+
+#include <errno.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "json_formatter.h"
+
+/**
+ * Row filter
+ *
+ * The 'filter' option is a list of conditions separated by ';', each a
+ * dotted path, an operator (= != < <= > >=) and a value.  Every object is
+ * checked against the raw tokens of those paths before it is converted,
+ * walking it only as far as needed to find them; objects that fail any
+ * condition are dropped without becoming a row.
+ *
+ * Numbers are compared numerically with a value that is a number, as
+ * 64 bit integers when both are integers so ids past 2^53 stay exact,
+ * strings are compared byte by byte after unescaping, and true, false and
+ * null compare as their literal text.  A value in double quotes is always
+ * compared as a string, and may hold ';'.  A missing path fails every
+ * condition.
+ */
+
+static void
+json_filter_invalid( const char *spec ) {
+    ereport( ERROR, (
+        errcode( ERRCODE_INVALID_PARAMETER_VALUE ),
+        errmsg( "Invalid filter '%s', expected path=value, path!=value, path<value, path<=value, path>value or path>=value", spec )
+    ) );
+}
+
+static char *
+json_filter_trim( char *str ) {
+    char *end;
+
+    while( *str == ' ' )
+        str++;
+
+    end = str + strlen( str );
+    while( end > str && end[-1] == ' ' )
+        *--end = '\0';
+
+    return str;
+}
+
+/**
+ * Parse one condition, splitting it at its operator
+ */
+static void
+json_filter_cond( char *spec, json_filter_cond_t *cond, char **path ) {
+    char    *op = strpbrk( spec, "!<>=" );
+    char    *value;
+    char    *end;
+
+    if( !op )
+        json_filter_invalid( spec );
+
+    switch( op[0] ) {
+        case '=':
+            cond->op = JSON_FILTER_EQ;
+            value = op + 1;
+            break;
+        case '!':
+            if( op[1] != '=' )
+                json_filter_invalid( spec );
+            cond->op = JSON_FILTER_NE;
+            value = op + 2;
+            break;
+        case '<':
+            cond->op = op[1] == '=' ? JSON_FILTER_LE : JSON_FILTER_LT;
+            value = op + (op[1] == '=' ? 2 : 1);
+            break;
+        default:
+            cond->op = op[1] == '=' ? JSON_FILTER_GE : JSON_FILTER_GT;
+            value = op + (op[1] == '=' ? 2 : 1);
+            break;
+    }
+
+    *op = '\0';
+    *path = json_filter_trim( spec );
+    value = json_filter_trim( value );
+
+    if( **path == '\0' )
+        json_filter_invalid( spec );
+
+    cond->len = strlen( value );
+    cond->numeric = false;
+    cond->integral = false;
+
+    if( cond->len >= 2 && value[0] == '"' && value[cond->len - 1] == '"' ) {
+        value[cond->len - 1] = '\0';
+        value++;
+        cond->len -= 2;
+    } else if( cond->len > 0 ) {
+        cond->number = strtod( value, &end );
+        cond->numeric = (*end == '\0');
+
+        errno = 0;
+        cond->integer = strtoll( value, &end, 10 );
+        cond->integral = (*end == '\0' && errno == 0);
+    }
+
+    cond->value = value;
+}
+
+/**
+ * Split the next condition off list at a ';' outside double quotes, as
+ * strsep does
+ */
+static char *
+json_filter_next( char **list ) {
+    char    *item = *list;
+    char    *p;
+    bool    quoted = false;
+
+    if( !item )
+        return NULL;
+
+    for( p = item; *p; p++ ) {
+        if( *p == '"' ) {
+            quoted = !quoted;
+        } else if( *p == ';' && !quoted ) {
+            *p = '\0';
+            *list = p + 1;
+            return item;
+        }
+    }
+
+    *list = NULL;
+    return item;
+}
+
+/**
+ * Parse the 'filter' option
+ */
+json_filter_t *
+json_filter_parse( const char *spec ) {
+    json_filter_t   *filter = palloc( sizeof(json_filter_t) );
+    char            *list = pstrdup( spec );
+    char            **paths;
+    int             *slots;
+    char            *item;
+    int             max = 1;
+    int             i;
+
+    for( i=0; spec[i]; i++ ) {
+        if( spec[i] == ';' )
+            max++;
+    }
+
+    filter->nconds = 0;
+    filter->conds = palloc( sizeof(json_filter_cond_t) * max );
+    paths = palloc( sizeof(char *) * max );
+    slots = palloc( sizeof(int) * max );
+
+    while( (item = json_filter_next( &list )) != NULL ) {
+        if( *json_filter_trim( item ) == '\0' )
+            continue;
+
+        json_filter_cond( item, &filter->conds[filter->nconds], &paths[filter->nconds] );
+        filter->nconds++;
+    }
+
+    if( filter->nconds == 0 )
+        json_filter_invalid( spec );
+
+    filter->plan = json_plan_paths( paths, filter->nconds, slots );
+    filter->toks = palloc( sizeof(json_token_t) * filter->plan->ncols );
+
+    for( i=0; i < filter->nconds; i++ )
+        filter->conds[i].slot = slots[i];
+
+    pfree( paths );
+    pfree( slots );
+
+    return filter;
+}
+
+static int
+json_filter_compare( const char *a, int alen, const char *b, int blen ) {
+    int cmp = memcmp( a, b, alen < blen ? alen : blen );
+
+    if( cmp != 0 )
+        return cmp;
+
+    return alen - blen;
+}
+
+static bool
+json_filter_test( json_filter_cond_t *cond, json_token_t *tok ) {
+    char    buf[256];
+    char    *copy = NULL;
+    int     cmp;
+
+    switch( tok->type ) {
+        case JSON_TOK_NONE:
+            return false;
+        case JSON_TOK_INTEGER:
+        case JSON_TOK_REAL:
+        {
+            double  d;
+
+            if( !cond->numeric )
+                return false;
+
+            if( tok->len >= (int)sizeof(buf) )
+                return false;
+            memcpy( buf, tok->start, tok->len );
+            buf[tok->len] = '\0';
+
+            /* doubles can not tell apart integers past 2^53 */
+            if( tok->type == JSON_TOK_INTEGER && cond->integral ) {
+                int64 n;
+
+                errno = 0;
+                n = strtoll( buf, NULL, 10 );
+                if( errno == 0 ) {
+                    cmp = n < cond->integer ? -1 : (n > cond->integer ? 1 : 0);
+                    break;
+                }
+            }
+
+            d = strtod( buf, NULL );
+            cmp = d < cond->number ? -1 : (d > cond->number ? 1 : 0);
+            break;
+        }
+        case JSON_TOK_STRING:
+            if( tok->escaped ) {
+                int len;
+
+                copy = tok->len < (int)sizeof(buf) ? buf : palloc( tok->len + 1 );
+                len = json_sax_unescape( tok->start, tok->len, copy );
+                if( len < 0 )
+                    return false;
+                cmp = json_filter_compare( copy, len, cond->value, cond->len );
+                if( copy != buf )
+                    pfree( copy );
+            } else {
+                cmp = json_filter_compare( tok->start, tok->len, cond->value, cond->len );
+            }
+            break;
+        default:
+            cmp = json_filter_compare( tok->start, tok->len, cond->value, cond->len );
+            break;
+    }
+
+    switch( cond->op ) {
+        case JSON_FILTER_EQ:    return cmp == 0;
+        case JSON_FILTER_NE:    return cmp != 0;
+        case JSON_FILTER_LT:    return cmp < 0;
+        case JSON_FILTER_LE:    return cmp <= 0;
+        case JSON_FILTER_GT:    return cmp > 0;
+        default:                return cmp >= 0;
+    }
+}
+
+/**
+ * Check an object against every condition.  An object the partial walk
+ * cannot read is let through, so it is rejected by the read engine with
+ * the usual error.
+ */
+bool
+json_filter_match( json_filter_t *filter, const char *buf, int len ) {
+    int i;
+
+    if( !json_sax_find( filter->plan, buf, len, filter->toks ) )
+        return true;
+
+    for( i=0; i < filter->nconds; i++ ) {
+        json_filter_cond_t *cond = &filter->conds[i];
+
+        if( !json_filter_test( cond, &filter->toks[cond->slot] ) )
+            return false;
+    }
+
+    return true;
+}
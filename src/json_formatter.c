@@ -5,15 +5,18 @@
  * it under the terms of the MIT license. See LICENSE for details.
  */
 
+#include <errno.h>
+#include <stdlib.h>
 #include <string.h>
-#include "jansson.h"
 
-#include "postgres.h"
+#include "json_formatter.h"
+
 #include "fmgr.h"
 #include "funcapi.h"
 
 #include "access/formatter.h"
 #include "catalog/pg_proc.h"
+#include "catalog/pg_type.h"
 #include "utils/array.h"
 #include "utils/builtins.h"
 #include "utils/memutils.h"
@@ -23,43 +26,764 @@ PG_MODULE_MAGIC;
 PG_FUNCTION_INFO_V1( json_formatter_read );
 PG_FUNCTION_INFO_V1( json_formatter_write );
 
+void _PG_init( void );
 Datum json_formatter_read( PG_FUNCTION_ARGS );
 Datum json_formatter_write( PG_FUNCTION_ARGS );
 
-typedef struct {
-    int             ncols;
+/**
+ * Module load: send jansson's allocations through the arena hooks before
+ * any value is created, and stop worker threads and log scan counters at
+ * transaction end
+ */
+void
+_PG_init( void ) {
+    json_arena_install();
+    json_workers_install();
+#ifdef JSON_STATS
+    json_stats_install();
+#endif
+}
+
+/**
+ * Mark the columns named in the 'columns' option.  The format manager does
+ * not tell the formatter which columns a query uses, so the option stands
+ * in for it; the rest are never located or converted and read as NULL.
+ */
+static bool *
+json_read_needed( TupleDesc tupdesc, const char *val ) {
+    bool    *needed = palloc0( sizeof(bool) * tupdesc->natts );
+    char    *list = pstrdup( val );
+    char    *name;
+    int     i;
+
+    while( (name = strsep( &list, "," )) != NULL ) {
+        char *end;
+
+        while( *name == ' ' )
+            name++;
+        end = name + strlen( name );
+        while( end > name && end[-1] == ' ' )
+            *--end = '\0';
+
+        if( *name == '\0' )
+            continue;
+
+        for( i=0; i < tupdesc->natts; i++ ) {
+            if( strcmp( tupdesc->attrs[i]->attname.data, name ) == 0 )
+                break;
+        }
+
+        if( i == tupdesc->natts ) {
+            ereport( ERROR, (
+                errcode( ERRCODE_INVALID_PARAMETER_VALUE ),
+                errmsg( "Invalid columns, no column named '%s'", name )
+            ) );
+        }
+
+        needed[i] = true;
+    }
+
+    return needed;
+}
+
+/**
+ * Parse formatter options given in the external table's FORMAT clause
+ */
+static void
+json_read_options( FunctionCallInfo fcinfo, TupleDesc tupdesc, user_read_ctx_t *user_ctx ) {
+    int     nargs = FORMATTER_GET_NUM_ARGS( fcinfo );
+    int     i;
+    char    *engine = NULL;
+
+    user_ctx->engine = JSON_ENGINE_JANSSON;
+    user_ctx->minify = false;
+    user_ctx->needed = NULL;
+    user_ctx->unnest = NULL;
+    user_ctx->filter = NULL;
+    user_ctx->inflate = NULL;
+    user_ctx->nthreads = 0;
+    user_ctx->framing = JSON_FRAMING_OBJECT;
+
+    for( i=1; i <= nargs; i++ ) {
+        char    *key = FORMATTER_GET_NTH_ARG_KEY( fcinfo, i );
+        char    *val = FORMATTER_GET_NTH_ARG_VAL( fcinfo, i );
+
+        if( strcmp( key, "minify" ) == 0 ) {
+            if( strcmp( val, "true" ) == 0 ) {
+                user_ctx->minify = true;
+            } else if( strcmp( val, "false" ) == 0 ) {
+                user_ctx->minify = false;
+            } else {
+                ereport( ERROR, (
+                    errcode( ERRCODE_INVALID_PARAMETER_VALUE ),
+                    errmsg( "Invalid minify '%s', expected 'true' or 'false'", val )
+                ) );
+            }
+        } else if( strcmp( key, "engine" ) == 0 ) {
+            engine = val;
+            if( strcmp( val, "jansson" ) == 0 ) {
+                user_ctx->engine = JSON_ENGINE_JANSSON;
+            } else if( strcmp( val, "sax" ) == 0 ) {
+                user_ctx->engine = JSON_ENGINE_SAX;
+            } else {
+                ereport( ERROR, (
+                    errcode( ERRCODE_INVALID_PARAMETER_VALUE ),
+                    errmsg( "Invalid engine '%s', expected 'jansson' or 'sax'", val )
+                ) );
+            }
+        } else if( strcmp( key, "columns" ) == 0 ) {
+            user_ctx->needed = json_read_needed( tupdesc, val );
+        } else if( strcmp( key, "filter" ) == 0 ) {
+            user_ctx->filter = json_filter_parse( val );
+        } else if( strcmp( key, "framing" ) == 0 ) {
+            if( strcmp( val, "object" ) == 0 ) {
+                user_ctx->framing = JSON_FRAMING_OBJECT;
+            } else if( strcmp( val, "ndjson" ) == 0 ) {
+                user_ctx->framing = JSON_FRAMING_NDJSON;
+            } else {
+                ereport( ERROR, (
+                    errcode( ERRCODE_INVALID_PARAMETER_VALUE ),
+                    errmsg( "Invalid framing '%s', expected 'object' or 'ndjson'", val )
+                ) );
+            }
+        } else if( strcmp( key, "unnest" ) == 0 ) {
+            user_ctx->unnest = pstrdup( val );
+        } else if( strcmp( key, "compression" ) == 0 ) {
+            json_compress_t method = json_compress_parse( val );
+
+            user_ctx->inflate = method == JSON_COMPRESS_NONE ? NULL : json_inflate_create( method );
+        } else if( strcmp( key, "threads" ) == 0 ) {
+            char    *end;
+            long    n = strtol( val, &end, 10 );
+
+            if( *val == '\0' || *end != '\0' || n < 0 || n > JSON_WORKERS_MAX ) {
+                ereport( ERROR, (
+                    errcode( ERRCODE_INVALID_PARAMETER_VALUE ),
+                    errmsg( "Invalid threads '%s', expected a number from 0 to %d", val, JSON_WORKERS_MAX )
+                ) );
+            }
+            user_ctx->nthreads = (int)n;
+        }
+    }
+
+    /* elements are only split out by the sax engine */
+    if( user_ctx->unnest ) {
+        if( user_ctx->engine != JSON_ENGINE_SAX && engine ) {
+            ereport( ERROR, (
+                errcode( ERRCODE_INVALID_PARAMETER_VALUE ),
+                errmsg( "Invalid engine '%s', unnest requires 'sax'", engine )
+            ) );
+        }
+        user_ctx->engine = JSON_ENGINE_SAX;
+    }
+
+    /* worker threads run the sax engine, one object per job */
+    if( user_ctx->nthreads > 0 ) {
+        if( user_ctx->unnest ) {
+            ereport( ERROR, (
+                errcode( ERRCODE_INVALID_PARAMETER_VALUE ),
+                errmsg( "Invalid threads, unnest is read without worker threads" )
+            ) );
+        }
+        if( user_ctx->engine != JSON_ENGINE_SAX && engine ) {
+            ereport( ERROR, (
+                errcode( ERRCODE_INVALID_PARAMETER_VALUE ),
+                errmsg( "Invalid engine '%s', threads requires 'sax'", engine )
+            ) );
+        }
+        user_ctx->engine = JSON_ENGINE_SAX;
+    }
+}
+
+/**
+ * Record why a row could not be converted.  The error is raised when the
+ * row is handed out, so rows queued before it are still returned.
+ */
+static bool
+json_read_fail( json_read_error_t *err, json_read_status_t status, int attnum, const char *detail ) {
+    err->status = status;
+    err->attnum = attnum;
+    err->detail = detail;
+    return false;
+}
+
+/**
+ * Raise the error recorded for a row.  buf and len are the row's input,
+ * reported with rejected rows.
+ */
+void
+json_read_raise( FunctionCallInfo fcinfo, TupleDesc tupdesc, int rownum, char *buf, int len, json_read_error_t *err ) {
+    switch( err->status ) {
+        case JSON_READ_PARSE_ERROR:
+            if( err->detail )
+                elog( ERROR, "Could not parse JSON string: %s", err->detail );
+            else
+                elog( ERROR, "Could not parse JSON string" );
+            break;
+        case JSON_READ_NOT_OBJECT:
+            elog( ERROR, "Could not parse JSON object" );
+            break;
+        case JSON_READ_TYPE_ERROR:
+            FORMATTER_SET_BAD_ROW_NUM( fcinfo, rownum );
+            FORMATTER_SET_BAD_ROW_DATA( fcinfo, buf, len );
+            ereport( ERROR, (
+                errcode( ERRCODE_DATA_EXCEPTION ),
+                errmsg( "Wrong data type for column '%s', expected %s", tupdesc->attrs[err->attnum]->attname.data, err->detail )
+            ) );
+            break;
+        case JSON_READ_RANGE_ERROR:
+            FORMATTER_SET_BAD_ROW_NUM( fcinfo, rownum );
+            FORMATTER_SET_BAD_ROW_DATA( fcinfo, buf, len );
+            ereport( ERROR, (
+                errcode( ERRCODE_NUMERIC_VALUE_OUT_OF_RANGE ),
+                errmsg( "Value out of range for column '%s', expected %s", tupdesc->attrs[err->attnum]->attname.data, err->detail )
+            ) );
+            break;
+        case JSON_READ_UNSUPPORTED:
+            FORMATTER_SET_BAD_ROW_NUM( fcinfo, rownum );
+            FORMATTER_SET_BAD_ROW_DATA( fcinfo, buf, len );
+            ereport( ERROR, (
+                errcode( ERRCODE_DATA_EXCEPTION ),
+                errmsg( "Unsupported data type '%d' for column '%s'", tupdesc->attrs[err->attnum]->atttypid, tupdesc->attrs[err->attnum]->attname.data )
+            ) );
+            break;
+        case JSON_READ_OK:
+            break;
+    }
+}
+
+/**
+ * Convert one column's token, remembering tokens the converter leaves to
+ * the column's input function
+ */
+static bool
+json_read_convert( json_column_t *col, json_token_t *tok, Datum *value, json_token_t *deferred, json_read_error_t *err ) {
+    switch( col->convert( col, tok, value, err ) ) {
+        case JSON_CONVERT_OK:
+            return true;
+        case JSON_CONVERT_DEFER:
+            *deferred = *tok;
+            return true;
+        default:
+            return false;
+    }
+}
+
+/**
+ * Parse an object into a jansson tree and convert each column
+ */
+static bool
+json_read_jansson( user_read_ctx_t *user_ctx, const char *buf, int len, Datum *values, bool *nulls, json_token_t *deferred, json_read_error_t *err ) {
+    const char  *errmsg = NULL;
+    bool        ok = true;
+    int         spans = 0;
+    int         i;
+
+    /**
+     * The tree is built in the arena and released in bulk once the row is
+     * converted, so it is never freed node by node
+     */
+    JSON_STATS_BEGIN( user_ctx->stats );
+    json_arena_begin( user_ctx->j_arena );
+    user_ctx->j_root = json_loadb( buf, len, 0, user_ctx->j_error );
+    json_arena_end();
+    JSON_STATS_END( user_ctx->stats, JSON_PHASE_PARSE );
+
+    if( !user_ctx->j_root ) {
+        json_arena_reset( user_ctx->j_arena );
+        return json_read_fail( err, JSON_READ_PARSE_ERROR, -1, NULL );
+    }
+    if( !json_is_object(user_ctx->j_root) ) {
+        json_arena_reset( user_ctx->j_arena );
+        return json_read_fail( err, JSON_READ_NOT_OBJECT, -1, NULL );
+    }
+
+    JSON_STATS_BEGIN( user_ctx->stats );
+    json_plan_resolve( user_ctx->plan, user_ctx->j_root, user_ctx->j_vals );
+    JSON_STATS_END( user_ctx->stats, JSON_PHASE_LOOKUP );
+
+    JSON_STATS_BEGIN( user_ctx->stats );
+    for( i=0; ok && i < user_ctx->ncols; i++ ) {
+        json_column_t   *col = &user_ctx->columns[i];
+        json_t          *val = user_ctx->j_vals[i];
+        json_token_t    tok;
+        char            num[64];
+
+        if( !val || json_is_null( val ) ) {
+            nulls[i] = true;
+            continue;
+        }
+
+        /**
+         * Present the value the way the single pass extractor would, so
+         * both engines share the column converters
+         */
+        tok.escaped = false;
+        tok.prepared = false;
+        switch( json_typeof( val ) ) {
+            case JSON_STRING:
+                tok.type = JSON_TOK_STRING;
+                tok.start = json_string_value( val );
+                tok.len = strlen( tok.start );
+                break;
+            case JSON_INTEGER:
+                tok.type = JSON_TOK_INTEGER;
+                tok.len = snprintf( num, sizeof(num), "%lld", (long long)json_integer_value( val ) );
+                tok.start = num;
+                break;
+            case JSON_REAL:
+                tok.type = JSON_TOK_REAL;
+                /* the form json_dumps gives reals, which text columns keep */
+                tok.len = snprintf( num, sizeof(num), "%.17g", json_real_value( val ) );
+                if( !strpbrk( num, ".eE" ) ) {
+                    strcpy( num + tok.len, ".0" );
+                    tok.len += 2;
+                }
+                tok.start = num;
+                break;
+            case JSON_TRUE:
+            case JSON_FALSE:
+                tok.type = json_is_true( val ) ? JSON_TOK_TRUE : JSON_TOK_FALSE;
+                tok.start = json_is_true( val ) ? "true" : "false";
+                tok.len = strlen( tok.start );
+                break;
+            default:
+                tok.type = json_is_object( val ) ? JSON_TOK_OBJECT : JSON_TOK_ARRAY;
+                break;
+        }
+
+        /**
+         * Objects and arrays, and every value of a json column, are taken
+         * as their span of the input rather than serialized again.  So are
+         * reals read into anything but a float column, which would keep
+         * the noise of the double jansson parsed them into.  The spans are
+         * located once per row, and only for rows that need them.
+         */
+        if( tok.type == JSON_TOK_OBJECT || tok.type == JSON_TOK_ARRAY || col->raw ||
+            (tok.type == JSON_TOK_REAL && col->typid != FLOAT4OID && col->typid != FLOAT8OID) ) {
+            if( spans == 0 )
+                spans = json_sax_extract( user_ctx->plan, buf, len, user_ctx->j_toks, &errmsg ) ? 1 : -1;
+            if( spans < 0 ) {
+                ok = json_read_fail( err, JSON_READ_PARSE_ERROR, i, errmsg );
+                break;
+            }
+
+            tok = user_ctx->j_toks[i];
+            if( col->raw && tok.type == JSON_TOK_STRING ) {
+                tok.start--;
+                tok.len += 2;
+            }
+        }
+
+        ok = json_read_convert( col, &tok, &values[i], &deferred[i], err );
+
+        /* the arena is reset below, keep what the input function needs */
+        if( ok && deferred[i].type != JSON_TOK_NONE ) {
+            char *copy = palloc( tok.len + 1 );
+
+            memcpy( copy, tok.start, tok.len );
+            copy[tok.len] = '\0';
+            deferred[i].start = copy;
+        }
+    }
+    JSON_STATS_END( user_ctx->stats, JSON_PHASE_CONVERT );
+
+    json_arena_reset( user_ctx->j_arena );
+    user_ctx->j_root = NULL;
+
+    return ok;
+}
+
+/**
+ * Convert each column from its token.  Columns of an unnested element take
+ * the element's token, the others the object's.
+ */
+static bool
+json_read_tokens( user_read_ctx_t *user_ctx, json_token_t *toks, json_token_t *elem, Datum *values, bool *nulls, json_token_t *deferred, json_read_error_t *err ) {
+    int i;
+
+    for( i=0; i < user_ctx->ncols; i++ ) {
+        json_column_t   *col = &user_ctx->columns[i];
+        json_token_t    tok = (elem && elem[i].type != JSON_TOK_NONE) ? elem[i] : toks[i];
+
+        if( tok.type == JSON_TOK_NONE || tok.type == JSON_TOK_NULL ) {
+            nulls[i] = true;
+            continue;
+        }
+
+        /* strings span the bytes between their quotes */
+        if( col->raw && tok.type == JSON_TOK_STRING ) {
+            tok.start--;
+            tok.len += 2;
+        }
+
+        if( !json_read_convert( col, &tok, &values[i], &deferred[i], err ) )
+            return false;
+    }
+
+    return true;
+}
+
+/**
+ * Extract an object in a single pass and convert each column straight
+ * from its span of the input
+ */
+static bool
+json_read_sax( user_read_ctx_t *user_ctx, const char *buf, int len, Datum *values, bool *nulls, json_token_t *deferred, json_read_error_t *err ) {
+    const char  *errmsg = NULL;
+    bool        ok;
+
+    JSON_STATS_BEGIN( user_ctx->stats );
+    ok = json_sax_extract( user_ctx->plan, buf, len, user_ctx->j_toks, &errmsg );
+    JSON_STATS_END( user_ctx->stats, JSON_PHASE_PARSE );
+
+    if( !ok ) {
+        return json_read_fail( err, JSON_READ_PARSE_ERROR, -1, errmsg );
+    }
+
+    JSON_STATS_BEGIN( user_ctx->stats );
+    ok = json_read_tokens( user_ctx, user_ctx->j_toks, NULL, values, nulls, deferred, err );
+    JSON_STATS_END( user_ctx->stats, JSON_PHASE_CONVERT );
+
+    return ok;
+}
+
+/**
+ * Queue a row for the object at start, growing the queue if an unnested
+ * object has more elements than it holds
+ */
+static json_read_row_t *
+json_read_queue_row( user_read_ctx_t *user_ctx, int start, int len, Datum **values, bool **nulls, json_token_t **deferred ) {
+    json_read_queue_t   *q = &user_ctx->queue;
+    json_read_row_t     *row;
+    int                 ncols = user_ctx->ncols;
+
+    if( q->nrows == q->maxrows ) {
+        q->maxrows *= 2;
+        q->rows = repalloc( q->rows, sizeof(json_read_row_t) * q->maxrows );
+        q->values = repalloc( q->values, sizeof(Datum) * ncols * q->maxrows );
+        q->nulls = repalloc( q->nulls, sizeof(bool) * ncols * q->maxrows );
+        q->deferred = repalloc( q->deferred, sizeof(json_token_t) * ncols * q->maxrows );
+    }
+
+    row = &q->rows[q->nrows];
+    row->start = start;
+    row->array = user_ctx->scan.array;
+    row->len = len;
+    row->element = 0;
+    row->error.status = JSON_READ_OK;
+
+    *values = &q->values[q->nrows * ncols];
+    *nulls = &q->nulls[q->nrows * ncols];
+    *deferred = &q->deferred[q->nrows * ncols];
+
+    MemSet( *values, 0, ncols * sizeof(Datum) );
+    MemSet( *nulls, false, ncols * sizeof(bool) );
+    MemSet( *deferred, 0, ncols * sizeof(json_token_t) );
+
+    q->nrows++;
+
+    return row;
+}
+
+/**
+ * Convert the object at start into one row
+ */
+static bool
+json_read_object( user_read_ctx_t *user_ctx, const char *data_buf, int start, int len ) {
+    json_read_row_t *row;
     Datum           *values;
     bool            *nulls;
-    char            *j_buf;
-    json_t          *j_root;
-    json_error_t    *j_error;
-    int             j_len;
-    int             j_counter;
-    bool            j_quotation_opened;
-    int             j_cursor;
-    int             rownum;
-} user_read_ctx_t;
-
-typedef struct {
-    int             ncolumns;
-    json_t          *j_root;
-    json_t          **j_vals;
-    bytea           *buf;
-    Datum           *dbvalues;
-    bool            *dbnulls;
-} user_write_ctx_t;
+    json_token_t    *deferred;
+
+    row = json_read_queue_row( user_ctx, start, len, &values, &nulls, &deferred );
+
+    /* extracted by a worker, and converted once the batch is split */
+    if( user_ctx->workers ) {
+        json_workers_add( user_ctx->workers, data_buf+start, len );
+        return true;
+    }
+
+    if( user_ctx->engine == JSON_ENGINE_SAX )
+        return json_read_sax( user_ctx, data_buf+start, len, values, nulls, deferred, &row->error );
+    else
+        return json_read_jansson( user_ctx, data_buf+start, len, values, nulls, deferred, &row->error );
+}
+
+/**
+ * Convert the object at start into one row per element of the unnested
+ * array.  If any element fails, the object's rows are replaced by a single
+ * row carrying the error, so the object is rejected as a whole.  The
+ * first resume elements were handed out before the queue was refilled.
+ */
+static bool
+json_read_unnest( user_read_ctx_t *user_ctx, const char *data_buf, int start, int len, int resume ) {
+    json_read_queue_t   *q = &user_ctx->queue;
+    json_elems_t        *elems = &user_ctx->elems;
+    json_read_row_t     *row;
+    json_read_error_t   err;
+    const char          *errmsg = NULL;
+    int                 first = q->nrows;
+    int                 e;
+    bool                ok;
+    Datum               *values;
+    bool                *nulls;
+    json_token_t        *deferred;
+
+    JSON_STATS_BEGIN( user_ctx->stats );
+    ok = json_sax_extract_unnest( user_ctx->plan, data_buf+start, len, user_ctx->j_toks, elems, &errmsg );
+    JSON_STATS_END( user_ctx->stats, JSON_PHASE_PARSE );
+
+    if( !ok ) {
+        json_read_fail( &err, JSON_READ_PARSE_ERROR, -1, errmsg );
+        goto fail;
+    }
+
+    JSON_STATS_BEGIN( user_ctx->stats );
+    for( e=resume; ok && e < elems->count; e++ ) {
+        json_token_t *elem = &elems->toks[e * user_ctx->ncols];
+
+        row = json_read_queue_row( user_ctx, start, len, &values, &nulls, &deferred );
+        row->element = e;
+        ok = json_read_tokens( user_ctx, user_ctx->j_toks, elem, values, nulls, deferred, &err );
+    }
+    JSON_STATS_END( user_ctx->stats, JSON_PHASE_CONVERT );
+
+    if( !ok )
+        goto fail;
+
+    return true;
+
+fail:
+    q->nrows = first;
+    row = json_read_queue_row( user_ctx, start, len, &values, &nulls, &deferred );
+    row->error = err;
+    return false;
+}
+
+/**
+ * Convert the rows whose objects the worker threads extracted, in input
+ * order.  The batch ends at the first row that fails, as it does without
+ * threads, with cur moved to the end of that row.
+ */
+static void
+json_read_collect( user_read_ctx_t *user_ctx, int *cur ) {
+    json_read_queue_t   *q = &user_ctx->queue;
+    json_workers_t      *w = user_ctx->workers;
+    int                 ncols = user_ctx->ncols;
+    int                 i;
+
+    for( i=0; i < q->nrows; i++ ) {
+        json_read_row_t *row = &q->rows[i];
+        json_job_t      *job;
+        bool            ok;
+
+        /* time spent waiting for the threads */
+        JSON_STATS_BEGIN( user_ctx->stats );
+        job = json_workers_wait( w, i );
+        JSON_STATS_END( user_ctx->stats, JSON_PHASE_PARSE );
+
+        if( job->ok ) {
+            JSON_STATS_BEGIN( user_ctx->stats );
+            ok = json_read_tokens( user_ctx, job->toks, NULL, &q->values[i * ncols], &q->nulls[i * ncols], &q->deferred[i * ncols], &row->error );
+            JSON_STATS_END( user_ctx->stats, JSON_PHASE_CONVERT );
+        } else {
+            ok = json_read_fail( &row->error, JSON_READ_PARSE_ERROR, -1, job->errmsg );
+        }
+
+        /* the scanner may have read past the row, up to a closing bracket */
+        if( !ok ) {
+            q->nrows = i + 1;
+            *cur = row->start + row->len;
+            user_ctx->scan.array = row->array;
+            break;
+        }
+    }
+
+    json_workers_finish( w );
+
+#ifdef JSON_STATS
+    /* the backend's own plan extracts nothing, so it carries the threads' totals */
+    user_ctx->plan->shape_hits = 0;
+    user_ctx->plan->shape_misses = 0;
+    for( i=0; i < w->nthreads; i++ ) {
+        user_ctx->plan->shape_hits += w->plans[i]->shape_hits;
+        user_ctx->plan->shape_misses += w->plans[i]->shape_misses;
+    }
+#endif
+}
+
+/**
+ * Split every complete object in the data buffer, from data_cur on, and
+ * convert each into the row queue.  Stops early at a row that fails to
+ * convert, which is queued with its error, and after JSON_READ_BATCH_ROWS
+ * rows.  Returns the scanner's result for the position where splitting
+ * stopped when no row could be queued at all.  at_eof says the buffer
+ * holds the rest of the input.
+ */
+static json_scan_result_t
+json_read_fill( user_read_ctx_t *user_ctx, char *data_buf, int data_len, int *data_cur, bool at_eof ) {
+    json_read_queue_t   *q = &user_ctx->queue;
+    MemoryContext       omc;
+    json_scan_result_t  res = JSON_SCAN_MORE;
+    int                 cur = *data_cur;
+    int                 resume = q->resume;
+
+    MemoryContextReset( q->ctx );
+    omc = MemoryContextSwitchTo( q->ctx );
+
+    q->data_buf = data_buf;
+    q->data_len = data_len;
+    q->nrows = 0;
+    q->next = 0;
+    q->resume = 0;
+
+    /**
+     * Threads still reading the data buffer are waited for before an error
+     * is passed on, since the next call may refill it
+     */
+    PG_TRY();
+    {
+        while( q->nrows < JSON_READ_BATCH_ROWS ) {
+            int             skip, length;
+            bool            ok;
+
+            JSON_STATS_BEGIN( user_ctx->stats );
+            if( user_ctx->framing == JSON_FRAMING_NDJSON )
+                res = json_scan_line( &user_ctx->scan, data_buf+cur, data_len-cur, at_eof, &skip, &length );
+            else
+                res = json_scan_next( &user_ctx->scan, data_buf+cur, data_len-cur, &skip, &length );
+            JSON_STATS_END( user_ctx->stats, JSON_PHASE_SCAN );
+            cur += skip;
+            if( res != JSON_SCAN_FOUND )
+                break;
+
+            JSON_STATS_COUNT( user_ctx->stats, objects, 1 );
+            JSON_STATS_COUNT( user_ctx->stats, bytes, length );
+            JSON_STATS_MAX( user_ctx->stats, max_object, length );
+
+            /* objects the filter drops never become rows */
+            if( user_ctx->filter ) {
+                JSON_STATS_BEGIN( user_ctx->stats );
+                ok = json_filter_match( user_ctx->filter, data_buf+cur, length );
+                JSON_STATS_END( user_ctx->stats, JSON_PHASE_FILTER );
+
+                if( !ok ) {
+                    JSON_STATS_COUNT( user_ctx->stats, filtered, 1 );
+                    cur += length;
+                    resume = 0;
+                    continue;
+                }
+            }
+
+            /* only the object at the cursor can have been partly handed out */
+            if( user_ctx->unnest )
+                ok = json_read_unnest( user_ctx, data_buf, cur, length, resume );
+            else
+                ok = json_read_object( user_ctx, data_buf, cur, length );
+
+            cur += length;
+            resume = 0;
+            if( !ok )
+                break;
+        }
+
+        if( user_ctx->workers )
+            json_read_collect( user_ctx, &cur );
+    }
+    PG_CATCH();
+    {
+        if( user_ctx->workers )
+            json_workers_finish( user_ctx->workers );
+        PG_RE_THROW();
+    }
+    PG_END_TRY();
+
+    MemoryContextSwitchTo( omc );
+
+    JSON_STATS_SET( user_ctx->stats, shape_hits, user_ctx->plan->shape_hits );
+    JSON_STATS_SET( user_ctx->stats, shape_misses, user_ctx->plan->shape_misses );
+
+    q->end = cur;
+    q->array = user_ctx->scan.array;
+
+    /**
+     * An object left incomplete after at least one queued row is scanned
+     * again from its opening brace by the next fill, which starts at the
+     * cursor of the last row handed out.
+     */
+    if( q->nrows > 0 ) {
+        if( res == JSON_SCAN_MORE && user_ctx->scan.pos > 0 )
+            JSON_STATS_COUNT( user_ctx->stats, rescans, 1 );
+        json_scan_reset( &user_ctx->scan );
+        q->cursor = *data_cur;
+        return JSON_SCAN_FOUND;
+    }
+
+    *data_cur = cur;
+    return res;
+}
+
+/**
+ * Decode more compressed input into the window
+ */
+static bool
+json_read_inflate( user_read_ctx_t *user_ctx ) {
+    bool    more;
+
+    JSON_STATS_BEGIN( user_ctx->stats );
+    more = json_inflate_fill( user_ctx->inflate );
+    JSON_STATS_END( user_ctx->stats, JSON_PHASE_INFLATE );
+
+    return more;
+}
+
+/**
+ * Move the data cursor, which for compressed input is the cursor of the
+ * decoded window
+ */
+static void
+json_read_cursor( FunctionCallInfo fcinfo, user_read_ctx_t *user_ctx, int cur ) {
+    if( user_ctx->inflate )
+        user_ctx->inflate->cur = cur;
+    else
+        FORMATTER_SET_DATACURSOR( fcinfo, cur );
+}
+
+/**
+ * The input is exhausted: stop the worker threads and log the counters.
+ * A top level array must have been closed by then.
+ */
+static void
+json_read_end( user_read_ctx_t *user_ctx ) {
+    if( user_ctx->workers ) {
+        json_workers_stop( user_ctx->workers );
+        user_ctx->workers = NULL;
+    }
+
+    JSON_STATS_REPORT( user_ctx->stats );
+
+    if( user_ctx->scan.array == JSON_SCAN_ARRAY_OPEN )
+        elog( ERROR, "Invalid JSON Format, top level array is not closed" );
+}
 
 Datum
 json_formatter_read( PG_FUNCTION_ARGS ) {
-    HeapTuple       tuple;
-    TupleDesc       tupdesc;
-    MemoryContext   mc, omc;
-    user_read_ctx_t      *user_ctx;
-    char            *data_buf;
-    int             data_cur;
-    int             data_len;
-    int             ncols = 0;
-    int             i=0;
+    HeapTuple           tuple;
+    TupleDesc           tupdesc;
+    MemoryContext       mc, omc;
+    user_read_ctx_t     *user_ctx;
+    json_read_queue_t   *q;
+    json_read_row_t     *row;
+    json_token_t        *deferred;
+    json_inflate_t      *z;
+    char                *data_buf;
+    int                 data_cur;
+    int                 data_len;
+    bool                saw_eof;
+    bool                at_eof;
+    int                 ncols = 0;
+    int                 i;
 
     if( !CALLED_AS_FORMATTER( fcinfo ) )
         elog( ERROR, "json_formatter_read: not called by format manager" );
@@ -74,6 +798,7 @@ json_formatter_read( PG_FUNCTION_ARGS ) {
     data_buf = FORMATTER_GET_DATABUF( fcinfo );
     data_len = FORMATTER_GET_DATALEN( fcinfo );
     data_cur = FORMATTER_GET_DATACURSOR( fcinfo );
+    saw_eof = at_eof = FORMATTER_GET_SAW_EOF( fcinfo );
 
     /**
      * First call to formatter, setup context
@@ -81,28 +806,90 @@ json_formatter_read( PG_FUNCTION_ARGS ) {
     if( user_ctx == NULL ) {
         user_ctx = palloc( sizeof( user_read_ctx_t ) );
         user_ctx->ncols = ncols;
-        user_ctx->values = palloc( sizeof(Datum) * ncols );
-        user_ctx->nulls = palloc( sizeof(bool) * ncols );
-        user_ctx->j_buf = palloc( sizeof(char) * data_len );
-        user_ctx->j_root = palloc( sizeof(json_t) );
+        user_ctx->values = NULL;
+        user_ctx->nulls = NULL;
+        user_ctx->j_buf = NULL;
+        user_ctx->j_root = NULL;
+        /* columns left out of the plan are never resolved and stay NULL */
+        user_ctx->j_vals = palloc0( sizeof(json_t*) * ncols );
         user_ctx->j_error = palloc( sizeof(json_error_t) );
+        user_ctx->j_arena = json_arena_create( CurrentMemoryContext, JSON_ARENA_BLOCK_SIZE );
         user_ctx->j_len = 0;
-        user_ctx->j_counter = 0;
-        user_ctx->j_quotation_opened = false;
         user_ctx->j_cursor = 0;
         user_ctx->rownum = 0;
+        json_read_options( fcinfo, tupdesc, user_ctx );
+        user_ctx->plan = json_plan_build( tupdesc, user_ctx->needed, user_ctx->unnest );
+        user_ctx->columns = json_convert_setup( tupdesc );
+        json_scan_init( &user_ctx->scan );
+        user_ctx->j_toks = palloc( sizeof(json_token_t) * ncols );
+        user_ctx->elems.count = 0;
+        user_ctx->elems.max = 16;
+        user_ctx->elems.toks = palloc( sizeof(json_token_t) * ncols * user_ctx->elems.max );
+
+        q = &user_ctx->queue;
+        q->ctx = AllocSetContextCreate( CurrentMemoryContext,
+                                        "json_formatter_read batch",
+                                        ALLOCSET_DEFAULT_MINSIZE,
+                                        ALLOCSET_DEFAULT_INITSIZE,
+                                        ALLOCSET_DEFAULT_MAXSIZE );
+        q->data_buf = NULL;
+        q->data_len = 0;
+        q->cursor = -1;
+        q->end = 0;
+        q->resume = 0;
+        q->nrows = 0;
+        q->next = 0;
+        q->maxrows = JSON_READ_BATCH_ROWS;
+        q->rows = palloc( sizeof(json_read_row_t) * q->maxrows );
+        q->values = palloc( sizeof(Datum) * ncols * q->maxrows );
+        q->nulls = palloc( sizeof(bool) * ncols * q->maxrows );
+        q->deferred = palloc( sizeof(json_token_t) * ncols * q->maxrows );
+
+        for( i=0; i < ncols; i++ ) {
+            user_ctx->columns[i].minify = user_ctx->minify;
+            if( user_ctx->columns[i].element )
+                user_ctx->columns[i].element->minify = user_ctx->minify;
+        }
 
+        user_ctx->workers = NULL;
+        if( user_ctx->nthreads > 0 )
+            user_ctx->workers = json_workers_start( user_ctx->plan, user_ctx->columns, ncols, user_ctx->nthreads );
 
+#ifdef JSON_STATS
+        user_ctx->stats = json_stats_create( false );
+#endif
         FORMATTER_SET_USER_CTX( fcinfo, user_ctx );
     } else {
         user_ctx->rownum++;
     }
 
+#ifdef JSON_STATS
+    /* the row handed out last time was rejected if it never came back */
+    user_ctx->stats->calls++;
+    if( user_ctx->stats->handed_out ) {
+        user_ctx->stats->rejected++;
+        user_ctx->stats->handed_out = false;
+    }
+#endif
+
+    q = &user_ctx->queue;
+    z = user_ctx->inflate;
+
     /**
-     * Clear column buffers
+     * Compressed input is taken from the data buffer as soon as it arrives
+     * and objects are split from the decoded window instead.  A row
+     * rejected by the last call is stepped over here, as the format manager
+     * does with its own cursor for uncompressed input.
      */
-    MemSet( user_ctx->values, 0, ncols * sizeof(Datum) );
-    MemSet( user_ctx->nulls, false, ncols * sizeof(bool) );
+    if( z ) {
+        json_inflate_input( z, data_buf+data_cur, data_len-data_cur );
+        FORMATTER_SET_DATACURSOR( fcinfo, data_len );
+
+        if( z->skip > 0 ) {
+            z->cur = Min( z->cur + z->skip, z->len );
+            z->skip = 0;
+        }
+    }
 
     /**
      * Switch memory contexts, create tuple from data
@@ -110,262 +897,207 @@ json_formatter_read( PG_FUNCTION_ARGS ) {
     mc = FORMATTER_GET_PER_ROW_MEM_CTX( fcinfo );
     omc = MemoryContextSwitchTo( mc );
 
-    char c;
-    char pc;
-    int length = 0;
+window:
+    if( z ) {
+        data_buf = z->buf;
+        data_len = z->len;
+        data_cur = z->cur;
+        at_eof = saw_eof && json_inflate_drained( z );
+    }
 
     //elog( NOTICE, "data buffer -> ncols: %d, len: %d, cur: %d - %hhd", ncols, data_len, data_cur, data_buf[data_cur] );
 
     if( data_cur == data_len ) {
+        if( z && json_read_inflate( user_ctx ) )
+            goto window;
+
         MemoryContextSwitchTo( omc );
+        if( z && saw_eof )
+            json_inflate_finish( z );
+
+        JSON_STATS_COUNT( user_ctx->stats, need_more, 1 );
+        if( saw_eof )
+            json_read_end( user_ctx );
         FORMATTER_RETURN_NOTIFICATION( fcinfo, FMT_NEED_MORE_DATA );
     }
 
     /**
-     * Scan to beginning of JSON object
+     * Hand out queued rows while the data buffer is exactly as it was when
+     * they were split from it.  Otherwise, split and convert every complete
+     * object now in the buffer.  The scanner state lives in user_ctx, so an
+     * object still incomplete when we run out of data is resumed from where
+     * it stopped rather than rescanned.
      */
-    while( user_ctx->j_counter == 0 ) {
-        if( data_cur == data_len ) {
-            FORMATTER_SET_DATACURSOR( fcinfo, data_cur );
-            MemoryContextSwitchTo( omc );
-            FORMATTER_RETURN_NOTIFICATION( fcinfo, FMT_NEED_MORE_DATA );
-        }
-
-        if( data_buf[data_cur] == ' '
-            || data_buf[data_cur] == ','
-            || data_buf[data_cur] == '\n'
-            || data_buf[data_cur] == '\r'
-        ) {
-            FORMATTER_SET_DATACURSOR( fcinfo, ++data_cur );
-            continue;
-        }
+    if( q->next >= q->nrows || q->data_buf != data_buf || q->data_len != data_len || q->cursor != data_cur ) {
+        switch( json_read_fill( user_ctx, data_buf, data_len, &data_cur, at_eof ) ) {
+            case JSON_SCAN_FOUND:
+                break;
+            case JSON_SCAN_INVALID:
+                json_read_cursor( fcinfo, user_ctx, data_cur );
+                MemoryContextSwitchTo( omc );
+                if( user_ctx->scan.array == JSON_SCAN_ARRAY_CLOSED )
+                    elog( ERROR, "Invalid JSON Format, found '%c' after the top level array", data_buf[data_cur] );
+                elog( ERROR, "Invalid JSON Format, expected '{' found '%c'", data_buf[data_cur] );
+                break;
+            case JSON_SCAN_MORE:
+                json_read_cursor( fcinfo, user_ctx, data_cur );
+                if( z ) {
+                    if( json_read_inflate( user_ctx ) )
+                        goto window;
+
+                    /* the window was compacted even though nothing was added */
+                    data_buf = z->buf;
+                    data_len = z->len;
+                    data_cur = z->cur;
+                }
 
-        if( data_buf[data_cur] != '{' ) {
-            elog( ERROR, "Invalid JSON Format, expected '{' found '%c'", data_buf[data_cur] );
-        }
+                MemoryContextSwitchTo( omc );
 
-        user_ctx->j_counter++;
-        length++;
-    }
+                /* input cut short is reported as such, not as a bad object */
+                if( z && saw_eof )
+                    json_inflate_finish( z );
 
-    /**
-     * Scan to end of JSON object, match closing bracket
-     */
-    while( user_ctx->j_counter > 0 ) {
-        /**
-         * Make sure we have more data to scan
-         */
-        if( data_cur + length == data_len ) {
-            MemoryContextSwitchTo( omc );
+                if( user_ctx->scan.pos > 0 && saw_eof ) {
+                    FORMATTER_SET_BAD_ROW_NUM( fcinfo, user_ctx->rownum );
+                    FORMATTER_SET_BAD_ROW_DATA( fcinfo, data_buf+data_cur, data_len-data_cur );
+                    if( z )
+                        z->skip = data_len - data_cur;
+                    JSON_STATS_COUNT( user_ctx->stats, rejected, 1 );
+                    ereport( ERROR, (
+                        errcode( ERRCODE_DATA_EXCEPTION ),
+                        errmsg( "Invalid JSON object depth: %d data_cur: %d, user_ctx->rownum: %d data_len: %d data_buf+data_cur: %s", user_ctx->scan.depth, data_cur, user_ctx->rownum, data_len, data_buf+data_cur )
+                    ) );
+                }
 
-            if( FORMATTER_GET_SAW_EOF( fcinfo ) ) {
-                FORMATTER_SET_BAD_ROW_NUM( fcinfo, user_ctx->rownum );
-                FORMATTER_SET_BAD_ROW_DATA( fcinfo, data_buf+data_cur, length );
-                ereport( ERROR, (
-                    errcode( ERRCODE_DATA_EXCEPTION ),
-                    errmsg( "Invalid JSON object user_ctx->j_counter: %d data_cur: %d, length: %d, user_ctx->rownum: %d data_len: %d data_buf+data_cur: %s", user_ctx->j_counter, data_cur, length, user_ctx->rownum,  data_len , data_buf+data_cur)
-                ) );
-            } else {
+                JSON_STATS_COUNT( user_ctx->stats, need_more, 1 );
+                if( saw_eof )
+                    json_read_end( user_ctx );
                 FORMATTER_RETURN_NOTIFICATION( fcinfo, FMT_NEED_MORE_DATA );
-            }
         }
+    }
 
-        c = data_buf[data_cur + length];
-        pc = data_buf[data_cur + length - 1];
+    row = &q->rows[q->next];
+    user_ctx->values = &q->values[q->next * ncols];
+    user_ctx->nulls = &q->nulls[q->next * ncols];
+    deferred = &q->deferred[q->next * ncols];
+    user_ctx->j_buf = data_buf+row->start;
+    user_ctx->j_len = row->len;
+    q->next++;
+    JSON_STATS_SET( user_ctx->stats, handed_out, true );
 
-        if(c == '"' && pc != '\\') {
-          user_ctx->j_quotation_opened = !user_ctx->j_quotation_opened;
-        }
-        if (!user_ctx->j_quotation_opened) {
-          if( c == '{') {
-            user_ctx->j_counter++;
-          } else if( c == '}' ) {
-            user_ctx->j_counter--;
-          }
-        }
-        length++;
-    }
+    /**
+     * The cursor sits on the object's opening brace while an error for it is
+     * raised, so a rejected row is skipped as a whole
+     */
+    json_read_cursor( fcinfo, user_ctx, row->start );
+    if( z )
+        z->skip = row->len;
+    MemoryContextSwitchTo( omc );
 
-    user_ctx->j_len = length;
-    memcpy( user_ctx->j_buf, data_buf+data_cur, user_ctx->j_len );
+    if( row->error.status != JSON_READ_OK ) {
+        q->nrows = 0;
 
-    //elog( NOTICE, "Complete str: %d:%s", user_ctx->j_len, user_ctx->j_buf+4600 );
+        /**
+         * A line that is not valid JSON ends where the next one starts, so
+         * it is rejected like any other bad row instead of ending the load
+         */
+        if( user_ctx->framing == JSON_FRAMING_NDJSON &&
+            (row->error.status == JSON_READ_PARSE_ERROR || row->error.status == JSON_READ_NOT_OBJECT) ) {
+            FORMATTER_SET_BAD_ROW_NUM( fcinfo, user_ctx->rownum );
+            FORMATTER_SET_BAD_ROW_DATA( fcinfo, user_ctx->j_buf, user_ctx->j_len );
+        }
 
-    user_ctx->j_root = json_loadb( user_ctx->j_buf, user_ctx->j_len, 0, user_ctx->j_error );
-    if( !user_ctx->j_root ) {
-        elog( ERROR, "Could not parse JSON string" );
-    }
-    if( !json_is_object(user_ctx->j_root) ) {
-        elog( ERROR, "Could not parse JSON object" );
+        json_read_raise( fcinfo, tupdesc, user_ctx->rownum, user_ctx->j_buf, user_ctx->j_len, &row->error );
     }
 
-    data_cur += user_ctx->j_len;
-    user_ctx->j_counter = 0;
-
     /**
-     * Pull each database column from the JSON object
+     * Values the converters left to the column's input function.  They are
+     * converted in the per row context with the row marked bad, so an
+     * input function error rejects just this row.
      */
+    JSON_STATS_BEGIN( user_ctx->stats );
     for( i=0; i < ncols; i++ ) {
-        Oid         type    = tupdesc->attrs[i]->atttypid;
-        json_t      *val;
-        char        *dbcolname, *tofree;
-        char        *jobjname;
-
-        /**
-         * copy the name of the current database column, to be passed to strsep(3)
-         */
-        tofree = dbcolname = strdup( tupdesc->attrs[i]->attname.data );
-
-        /**
-         * Initially set to the root of the current JSON object
-         */
-        val = palloc( sizeof(json_t) );
-        val = user_ctx->j_root;
+        if( deferred[i].type == JSON_TOK_NONE )
+            continue;
 
-        /**
-         * If the db col name contains periods, traverse the JSON object to find the correct sub-element
-         */
-        bool this_obj_is_null = false;
+        FORMATTER_SET_BAD_ROW_NUM( fcinfo, user_ctx->rownum );
+        FORMATTER_SET_BAD_ROW_DATA( fcinfo, user_ctx->j_buf, user_ctx->j_len );
+        omc = MemoryContextSwitchTo( mc );
+        user_ctx->values[i] = json_convert_input( &user_ctx->columns[i], &deferred[i] );
+        MemoryContextSwitchTo( omc );
+    }
+    JSON_STATS_END( user_ctx->stats, JSON_PHASE_CONVERT );
 
-        while( (jobjname = strsep( &dbcolname, "." )) != NULL ) {
-            val = json_object_get( val, jobjname );
-            if( !val ) {
-              val = json_object();
-              this_obj_is_null = true;
-            }
-        }
-        if ( this_obj_is_null ) {
-          val = json_null();
-        }
-        free( tofree );
+    /**
+     * The last row of a batch also consumes the filtered objects after it.
+     * The cursor stays on an unnested object until its last element is
+     * handed out, so a refill resumes at the next element.
+     */
+    if( q->next < q->nrows && q->rows[q->next].start == row->start ) {
+        data_cur = row->start;
+        q->resume = row->element + 1;
+    } else {
+        data_cur = q->next == q->nrows ? q->end : row->start + row->len;
+        q->resume = 0;
+    }
+    /* a refill from inside the batch rescans what follows this row */
+    user_ctx->scan.array = data_cur == q->end ? q->array : row->array;
+    q->cursor = data_cur;
+    json_read_cursor( fcinfo, user_ctx, data_cur );
+    if( z )
+        z->skip = 0;
+
+    JSON_STATS_BEGIN( user_ctx->stats );
+    tuple = heap_form_tuple( tupdesc, user_ctx->values, user_ctx->nulls );
+    JSON_STATS_END( user_ctx->stats, JSON_PHASE_FORM );
 
-        /**
-         * We have the correct JSON object, now extract the expected database type
-         */
-        switch( type ) {
-            case INT2OID:
-            case INT4OID:
-            case INT8OID:
-            {
-                if( json_is_null(val) ){
-                  user_ctx->nulls[i] = true;
-                } else if( !json_is_integer( val ) ) {
-                    MemoryContextSwitchTo( omc );
-                    FORMATTER_SET_BAD_ROW_NUM( fcinfo, user_ctx->rownum );
-                    FORMATTER_SET_BAD_ROW_DATA( fcinfo, user_ctx->j_buf, user_ctx->j_len );
-                    ereport( ERROR, (
-                        errcode( ERRCODE_DATA_EXCEPTION ),
-                        errmsg( "Wrong data type for column '%s', expected number", tupdesc->attrs[i]->attname.data )
-                    ) );
-                } else {
-                  user_ctx->values[i] = (Datum)json_integer_value( val );
-                  user_ctx->nulls[i] = false;
-                }
-                break;
-            }
-            case FLOAT4OID:
-                if( json_is_null(val) ) {
-                  user_ctx->nulls[i] = true;
-                } else if( !json_is_real( val ) ) {
-                    MemoryContextSwitchTo( omc );
-                    FORMATTER_SET_BAD_ROW_NUM( fcinfo, user_ctx->rownum );
-                    FORMATTER_SET_BAD_ROW_DATA( fcinfo, user_ctx->j_buf, user_ctx->j_len );
-                    ereport( ERROR, (
-                        errcode( ERRCODE_DATA_EXCEPTION ),
-                        errmsg( "Wrong data type for column '%s', expected float4", tupdesc->attrs[i]->attname.data )
-                    ) );
-                } else {
-                  user_ctx->values[i] = Float4GetDatum( json_real_value( val ) );
-                  user_ctx->nulls[i] = false;
-                }
+    JSON_STATS_COUNT( user_ctx->stats, rows, 1 );
+    JSON_STATS_SET( user_ctx->stats, handed_out, false );
 
-                break;
-            case FLOAT8OID:
-            {
-                if( json_is_null(val) ) {
-                  user_ctx->nulls[i] = true;
-                } else if( !json_is_real( val ) ) {
-                    MemoryContextSwitchTo( omc );
-                    FORMATTER_SET_BAD_ROW_NUM( fcinfo, user_ctx->rownum );
-                    FORMATTER_SET_BAD_ROW_DATA( fcinfo, user_ctx->j_buf, user_ctx->j_len );
-                    ereport( ERROR, (
-                        errcode( ERRCODE_DATA_EXCEPTION ),
-                        errmsg( "Wrong data type for column '%s', expected float8", tupdesc->attrs[i]->attname.data )
-                    ) );
-                } else {
-                  user_ctx->values[i] = Float8GetDatum( json_real_value( val ) );
-                  user_ctx->nulls[i] = false;
-                }
+    FORMATTER_SET_TUPLE( fcinfo, tuple );
+    FORMATTER_RETURN_TUPLE( tuple );
+}
 
-                break;
-            }
-            case TEXTOID:
-            case VARCHAROID:
-            {
-                const char  *strval;
-                text        *txtval;
-                if( json_is_null(val) ) {
-                  user_ctx->nulls[i] = true;
-                } else {
-
-                  switch (json_typeof(val)) {
-                    case JSON_STRING:
-                      strval = json_string_value( val );
-                    break;
-
-                    default:
-                      strval = json_dumps( val , 0);
-                    break;
-                  }
-
-
-                  txtval = palloc( strlen( strval ) + VARHDRSZ );
-                  SET_VARSIZE( txtval, strlen(strval) + VARHDRSZ );
-                  memcpy( VARDATA(txtval), strval, strlen(strval) );
-
-                  user_ctx->values[i] = PointerGetDatum( txtval );
-                  user_ctx->nulls[i] = false;
-                }
-                break;
-            }
-            case BOOLOID:
-            {
-              if( json_is_null(val) ){
-                user_ctx->nulls[i] = true;
-              } else if( !json_is_boolean( val ) ) {
-                  MemoryContextSwitchTo( omc );
-                  FORMATTER_SET_BAD_ROW_NUM( fcinfo, user_ctx->rownum );
-                  FORMATTER_SET_BAD_ROW_DATA( fcinfo, user_ctx->j_buf, user_ctx->j_len );
-                  ereport( ERROR, (
-                      errcode( ERRCODE_DATA_EXCEPTION ),
-                      errmsg( "Wrong data type for column '%s', expected boolean", tupdesc->attrs[i]->attname.data )
-                  ) );
-              } else {
-                user_ctx->values[i] = json_is_true( val );
-                user_ctx->nulls[i] = false;
-              }
-              break;
+/**
+ * Parse the writable table's formatter options
+ */
+static void
+json_write_options( FunctionCallInfo fcinfo, user_write_ctx_t *user_ctx ) {
+    int     nargs = FORMATTER_GET_NUM_ARGS( fcinfo );
+    int     i;
+
+    user_ctx->null_mode = JSON_NULL_DEFAULT;
+
+    for( i=1; i <= nargs; i++ ) {
+        char    *key = FORMATTER_GET_NTH_ARG_KEY( fcinfo, i );
+        char    *val = FORMATTER_GET_NTH_ARG_VAL( fcinfo, i );
+
+        if( strcmp( key, "null_mode" ) == 0 ) {
+            if( strcmp( val, "null" ) == 0 ) {
+                user_ctx->null_mode = JSON_NULL_NULL;
+            } else if( strcmp( val, "omit" ) == 0 ) {
+                user_ctx->null_mode = JSON_NULL_OMIT;
+            } else {
+                ereport( ERROR, (
+                    errcode( ERRCODE_INVALID_PARAMETER_VALUE ),
+                    errmsg( "Invalid null_mode '%s', expected 'null' or 'omit'", val )
+                ) );
             }
-            default:
-            {
-                MemoryContextSwitchTo( omc );
-                FORMATTER_SET_BAD_ROW_NUM( fcinfo, user_ctx->rownum );
-                FORMATTER_SET_BAD_ROW_DATA( fcinfo, user_ctx->j_buf, user_ctx->j_len );
+        } else if( strcmp( key, "compression" ) == 0 ) {
+            /**
+             * A row compressed on its own barely shrinks, and a stream
+             * shared by the rows could never be finished: the formatter is
+             * not called after the last row, and gpfdist interleaves the
+             * output of several segments
+             */
+            if( json_compress_parse( val ) != JSON_COMPRESS_NONE ) {
                 ereport( ERROR, (
-                    errcode( ERRCODE_DATA_EXCEPTION ),
-                    errmsg( "Unsupported data type '%d' for column '%s'", type, tupdesc->attrs[i]->attname.data )
+                    errcode( ERRCODE_INVALID_PARAMETER_VALUE ),
+                    errmsg( "Invalid compression '%s', only readable tables can be compressed", val )
                 ) );
             }
         }
     }
-
-    MemoryContextSwitchTo( omc );
-    FORMATTER_SET_DATACURSOR( fcinfo, data_cur );
-
-    tuple = heap_form_tuple( tupdesc, user_ctx->values, user_ctx->nulls );
-
-    FORMATTER_SET_TUPLE( fcinfo, tuple );
-    FORMATTER_RETURN_TUPLE( tuple );
 }
 
 Datum
@@ -375,8 +1107,6 @@ json_formatter_write( PG_FUNCTION_ARGS ) {
     HeapTupleData       tuple;
     MemoryContext       mc, omc;
     user_write_ctx_t    *user_ctx;
-    char                *jbuf;
-    int                 jbufn;
     int                 ncolumns = 0;
     int                 i = 0;
 
@@ -398,14 +1128,14 @@ json_formatter_write( PG_FUNCTION_ARGS ) {
         user_ctx = palloc( sizeof(user_write_ctx_t) );
 
         user_ctx->ncolumns = ncolumns;
+        json_write_options( fcinfo, user_ctx );
         user_ctx->j_root = json_object();
         user_ctx->j_vals = palloc( sizeof(json_t*) * ncolumns );
-        user_ctx->buf = palloc( VARHDRSZ );
+        initStringInfo( &user_ctx->buf );
         user_ctx->dbvalues = palloc( sizeof(Datum) * ncolumns );
         user_ctx->dbnulls = palloc( sizeof(bool) * ncolumns );
 
         for( i=0; i < ncolumns; i++ ) {
-            Oid         type = tupdesc->attrs[i]->atttypid;
             char        *dbcolname, *tofree;
             char        *jobjname, *pjobjname;
             int         ret=0;
@@ -427,7 +1157,7 @@ json_formatter_write( PG_FUNCTION_ARGS ) {
                 if( !user_ctx->j_vals[i] ) {
                     //generic objects will be replaced later if necessary
                     user_ctx->j_vals[i] = json_object();
-                    ret = json_object_set( j_parent, jobjname, user_ctx->j_vals[i] );
+                    ret = json_object_set_new( j_parent, jobjname, user_ctx->j_vals[i] );
                     if( ret < 0 ) {
                         elog( ERROR, "Failed to append nested JSON object" );
                     }
@@ -437,68 +1167,38 @@ json_formatter_write( PG_FUNCTION_ARGS ) {
                 pjobjname = jobjname;
             }
 
-            switch( type ) {
-                case INT2OID:
-                case INT4OID:
-                case INT8OID:
-                {
-                    user_ctx->j_vals[i] = json_integer(0);
-                    if( user_ctx->j_vals[i] == NULL ) {
-                        elog( ERROR, "Could not initialize json integer" );
-                    }
-
-                    break;
-                }
-                case FLOAT4OID:
-                case FLOAT8OID:
-                {
-                    user_ctx->j_vals[i] = json_real(0.0);
-                    if( user_ctx->j_vals[i] == NULL ) {
-                        elog( ERROR, "Could not initialize json real" );
-                    }
-
-                    break;
-                }
-                case TEXTOID:
-                case VARCHAROID:
-                {
-                    user_ctx->j_vals[i] = json_string( "" );
-                    if( user_ctx->j_vals[i] == NULL ) {
-                        elog( ERROR, "Could not initialize json string" );
-                    }
-
-                    break;
-                }
-                case BOOLOID:
-                {
-                  user_ctx->j_vals[i] = json_boolean(0);
-                  if( user_ctx->j_vals[i] == NULL ) {
-                      elog( ERROR, "Could not initialize json boolean" );
-                  }
-
-                  break;
-                }
-                default:
-                {
-                    elog( ERROR, "Type not supported" );
-                }
+            /**
+             * The leaf only marks where the column's value goes; the
+             * writer picks how to write it from the column type
+             */
+            user_ctx->j_vals[i] = json_integer(0);
+            if( user_ctx->j_vals[i] == NULL ) {
+                elog( ERROR, "Could not initialize json integer" );
             }
 
-            ret = json_object_set( j_parent, pjobjname, user_ctx->j_vals[i] );
+            ret = json_object_set_new( j_parent, pjobjname, user_ctx->j_vals[i] );
             if( ret < 0 ) {
                 elog( ERROR, "Failed to append to JSON object" );
             }
+
+            free( tofree );
         }
 
+        /**
+         * The template only fixes the layout of the output; rows are
+         * written from the compiled program.  The tree holds the only
+         * reference to each of its nodes, so one decref frees it all.
+         */
+        user_ctx->plan = json_write_compile( tupdesc, user_ctx->j_root, user_ctx->j_vals, user_ctx->null_mode );
+        json_decref( user_ctx->j_root );
+        user_ctx->j_root = NULL;
+
+#ifdef JSON_STATS
+        user_ctx->stats = json_stats_create( true );
+#endif
         FORMATTER_SET_USER_CTX( fcinfo, user_ctx );
     }
 
-    /**
-     * Clear column buffers
-     */
-    MemSet( user_ctx->dbvalues, 0, ncolumns * sizeof(Datum) );
-    MemSet( user_ctx->dbnulls, false, ncolumns * sizeof(bool) );
-
     /**
      * Switch memory context
      */
@@ -511,114 +1211,27 @@ json_formatter_write( PG_FUNCTION_ARGS ) {
     tuple.t_len = HeapTupleHeaderGetDatumLength( rec );
     ItemPointerSetInvalid( &(tuple.t_self) );
     tuple.t_data = rec;
+    JSON_STATS_BEGIN( user_ctx->stats );
     heap_deform_tuple( &tuple, tupdesc, user_ctx->dbvalues, user_ctx->dbnulls );
+    JSON_STATS_END( user_ctx->stats, JSON_PHASE_FORM );
 
     /**
-     * Iterate over columns from database
-     */
-    for( i=0; i < ncolumns; i++ ) {
-        Oid     type = tupdesc->attrs[i]->atttypid;
-        int     ret = 0;
-
-        switch( type ) {
-            case INT2OID:
-            case INT4OID:
-            case INT8OID:
-            {
-                int64 value;
-
-                if( user_ctx->dbnulls[i] )
-                    value = 0;
-                else
-                    value = DatumGetInt64( user_ctx->dbvalues[i] );
-
-                ret = json_integer_set( user_ctx->j_vals[i], value );
-                if( ret < 0 ) {
-                    MemoryContextSwitchTo( omc );
-                    elog( ERROR, "Unable to set int value for column '%s'", tupdesc->attrs[i]->attname.data );
-                }
-                break;
-            }
-            case FLOAT4OID:
-            {
-                float4 value;
-
-                if( user_ctx->dbnulls[i] )
-                    value = 0;
-                else
-                    value = DatumGetFloat4( user_ctx->dbvalues[i] );
-
-                ret = json_real_set( user_ctx->j_vals[i], value );
-                if( ret < 0 ) {
-                    MemoryContextSwitchTo( omc );
-                    elog( ERROR, "Unable to set float value for column '%s'", tupdesc->attrs[i]->attname.data );
-                }
-                break;
-            }
-            case FLOAT8OID:
-            {
-                float8 value;
-
-                if( user_ctx->dbnulls[i] )
-                    value = 0;
-                else
-                    value = DatumGetFloat8( user_ctx->dbvalues[i] );
-
-                ret = json_real_set( user_ctx->j_vals[i], value );
-                if( ret < 0 ) {
-                    MemoryContextSwitchTo( omc );
-                    elog( ERROR, "Unable to set float value for column '%s'", tupdesc->attrs[i]->attname.data );
-                }
-                break;
-            }
-            case TEXTOID:
-            case VARCHAROID:
-            {
-                char *value;
-
-                if( user_ctx->dbnulls[i] ) {
-                    value = "";
-                } else {
-                    value = DatumGetCString( DirectFunctionCall1( textout, user_ctx->dbvalues[i] ) );
-                }
-
-                ret = json_string_set( user_ctx->j_vals[i], value );
-                if( ret < 0 ) {
-                    MemoryContextSwitchTo( omc );
-                    elog( ERROR, "Unable to set string value for column '%s'", tupdesc->attrs[i]->attname.data );
-                }
-
-                break;
-            }
-            default:
-            {
-                MemoryContextSwitchTo( omc );
-                elog( ERROR, "Type of column '%s' not supported", tupdesc->attrs[i]->attname.data );
-            }
-        }
-    }
-
-    /**
-     * Dump out JSON object as a string
+     * Write the row straight into the output buffer, behind the bytea header
      */
-    jbuf = json_dumps( user_ctx->j_root, 0 );
-    jbufn = strlen( jbuf );
+    resetStringInfo( &user_ctx->buf );
+    enlargeStringInfo( &user_ctx->buf, VARHDRSZ );
+    user_ctx->buf.len = VARHDRSZ;
+    JSON_STATS_BEGIN( user_ctx->stats );
+    json_write_row( user_ctx->plan, user_ctx->dbvalues, user_ctx->dbnulls, &user_ctx->buf );
+    JSON_STATS_END( user_ctx->stats, JSON_PHASE_WRITE );
+    SET_VARSIZE( user_ctx->buf.data, user_ctx->buf.len );
 
-    /**
-     * Copy the resulting string into our bytea buffer with a trailing newline
-     */
     MemoryContextSwitchTo( omc );
 
-    if( user_ctx->buf )
-        pfree( user_ctx->buf );
-
-    user_ctx->buf = palloc( jbufn + VARHDRSZ + 1 );
-    char *data = VARDATA(user_ctx->buf);
-
-    SET_VARSIZE( user_ctx->buf, jbufn + VARHDRSZ + 1 );
-    memcpy( VARDATA(user_ctx->buf), jbuf, jbufn );
-    memcpy( &data[jbufn], "\n", 1 );
-    free( jbuf );
+    JSON_STATS_COUNT( user_ctx->stats, calls, 1 );
+    JSON_STATS_COUNT( user_ctx->stats, rows, 1 );
+    JSON_STATS_MAX( user_ctx->stats, max_object, user_ctx->buf.len - VARHDRSZ );
 
-    PG_RETURN_BYTEA_P( user_ctx->buf );
+    JSON_STATS_COUNT( user_ctx->stats, bytes, user_ctx->buf.len - VARHDRSZ );
+    PG_RETURN_BYTEA_P( user_ctx->buf.data );
 }
@@ -0,0 +1,661 @@
+/*
+ * Copyright (c) 2013 Dillon Woods <dewoods@gmail.com>
+ *
+ * greenplum-json-formatter is free software; you can redistribute it and/or modify
+ * it under the terms of the MIT license. See LICENSE for details.
+ */
+
+#ifndef JSON_FORMATTER_H
+#define JSON_FORMATTER_H
+
+#include <pthread.h>
+
+#include "jansson.h"
+
+#include "postgres.h"
+#include "access/tupdesc.h"
+#include "fmgr.h"
+#include "lib/stringinfo.h"
+
+#include "json_scan.h"
+
+/**
+ * Column extraction plan
+ *
+ * Built once per scan from the tuple descriptor.  Dotted column names are
+ * split into a prefix trie so that columns sharing a parent object
+ * ("user.name", "user.id") descend into that object once per row.
+ */
+typedef struct json_plan_node_t {
+    char                    *key;
+    int                     keylen;
+    int                     attnum;     /* column ending here, -1 if none */
+    struct json_plan_node_t *children;
+    int                     nchildren;
+    struct json_plan_node_t *next;
+    struct json_plan_node_t *element;   /* plan for each element when unnested here */
+    struct json_shape_t     *shape;     /* keys of the last object seen here, NULL until one is */
+} json_plan_node_t;
+
+/**
+ * Object shape
+ *
+ * Machine generated input repeats its key order row after row.  Each plan
+ * node with children remembers the keys of the last object the single pass
+ * extractor walked there, in order, with the child each one matched.  The
+ * key at the same position of the next object is compared against it with
+ * a memcmp before the children are searched, and replaces it when it
+ * differs.  Nodes with fewer than JSON_SHAPE_MIN_CHILDREN children are
+ * searched directly, which costs about as much as the comparison.  Keys
+ * longer than JSON_SHAPE_KEY_LEN are never predicted and keys past the
+ * first JSON_SHAPE_MAX_KEYS are not remembered.
+ */
+#define JSON_SHAPE_KEY_LEN 32
+#define JSON_SHAPE_MAX_KEYS 1024
+#define JSON_SHAPE_MIN_CHILDREN 8
+#define JSON_SHAPE_WORKER_KEYS 128  /* room in a worker's plan copy, which can not grow */
+
+typedef struct {
+    int                     keylen;     /* -1 if too long to remember */
+    json_plan_node_t        *child;     /* NULL for keys not in the plan */
+    char                    key[JSON_SHAPE_KEY_LEN];
+} json_shape_key_t;
+
+typedef struct json_shape_t {
+    int                 nkeys;
+    int                 max;
+    json_shape_key_t    *keys;
+} json_shape_t;
+
+typedef struct {
+    int                 ncols;
+    json_plan_node_t    root;
+    MemoryContext       ctx;            /* lives as long as the plan, for shapes; NULL in a worker's copy */
+#ifdef JSON_STATS
+    int64               shape_hits;     /* keys found where the last object had them */
+    int64               shape_misses;
+#endif
+} json_plan_t;
+
+/**
+ * Raw value located by the single pass extractor.  Strings span the bytes
+ * between the quotes, still escaped; every other type spans its full input
+ * text.
+ */
+typedef enum {
+    JSON_TOK_NONE = 0,
+    JSON_TOK_OBJECT,
+    JSON_TOK_ARRAY,
+    JSON_TOK_STRING,
+    JSON_TOK_INTEGER,
+    JSON_TOK_REAL,
+    JSON_TOK_TRUE,
+    JSON_TOK_FALSE,
+    JSON_TOK_NULL
+} json_tok_type_t;
+
+typedef struct {
+    json_tok_type_t type;
+    bool            escaped;
+    bool            prepared;   /* text already checked and unescaped or minified by a worker */
+    int             len;
+    const char      *start;
+} json_token_t;
+
+/**
+ * Elements of an unnested array, each with one token per column
+ */
+typedef struct {
+    int             count;
+    int             max;
+    json_token_t    *toks;      /* max * ncols */
+} json_elems_t;
+
+/**
+ * Read engine, selected with the 'engine' formatter option
+ */
+typedef enum {
+    JSON_ENGINE_JANSSON = 0,
+    JSON_ENGINE_SAX
+} json_engine_t;
+
+/**
+ * How objects are delimited in the input, selected with the 'framing'
+ * option
+ */
+typedef enum {
+    JSON_FRAMING_OBJECT = 0,    /* objects found by matching braces */
+    JSON_FRAMING_NDJSON         /* one object per line */
+} json_framing_t;
+
+/**
+ * Why a row could not be converted
+ */
+typedef enum {
+    JSON_READ_OK = 0,
+    JSON_READ_PARSE_ERROR,
+    JSON_READ_NOT_OBJECT,
+    JSON_READ_TYPE_ERROR,
+    JSON_READ_RANGE_ERROR,
+    JSON_READ_UNSUPPORTED
+} json_read_status_t;
+
+typedef struct {
+    json_read_status_t  status;
+    int                 attnum;     /* offending column, -1 if none */
+    const char          *detail;    /* expected type or parser message */
+} json_read_error_t;
+
+/**
+ * Fractional seconds are integer microseconds, rather than a double,
+ * when timestamps are stored as integers
+ */
+#if defined(HAVE_INT64_TIMESTAMP) || PG_VERSION_NUM >= 100000
+#define JSON_FSEC_SCALE 1000000
+#endif
+
+/**
+ * Per column converter, chosen from the column type once per scan
+ */
+typedef enum {
+    JSON_CONVERT_OK = 0,
+    JSON_CONVERT_ERROR,     /* err describes the failure */
+    JSON_CONVERT_DEFER      /* convert later with the type's input function */
+} json_convert_result_t;
+
+struct json_column_t;
+
+typedef json_convert_result_t (*json_convert_fn)( struct json_column_t *col, json_token_t *tok, Datum *value, json_read_error_t *err );
+
+typedef struct json_column_t {
+    int                 attnum;
+    Oid                 typid;
+    int32               typmod;
+    int                 maxlen;     /* varchar(n) limit in characters, -1 if none */
+    bool                raw;        /* takes the value's JSON text, quotes included */
+    bool                minify;     /* strip whitespace from object and array text */
+    json_convert_fn     convert;
+    PGFunction          infunc;     /* input function for deferred values */
+    const char          *expected;  /* type name used in error messages */
+    struct json_column_t    *element;   /* converter for the elements of an array column, NULL otherwise */
+    int16               elmlen;
+    bool                elmbyval;
+    char                elmalign;
+    json_elems_t        elems;      /* members of the array being converted */
+} json_column_t;
+
+/**
+ * Row filter given with the 'filter' option
+ */
+typedef enum {
+    JSON_FILTER_EQ,
+    JSON_FILTER_NE,
+    JSON_FILTER_LT,
+    JSON_FILTER_LE,
+    JSON_FILTER_GT,
+    JSON_FILTER_GE
+} json_filter_op_t;
+
+typedef struct {
+    json_filter_op_t    op;
+    int                 slot;       /* token of the condition's path */
+    char                *value;
+    int                 len;
+    bool                numeric;    /* value is a number */
+    double              number;
+    bool                integral;   /* value is a number that fits an int64 */
+    int64               integer;
+} json_filter_cond_t;
+
+typedef struct {
+    int                 nconds;
+    json_filter_cond_t  *conds;
+    json_plan_t         *plan;      /* one token per distinct path */
+    json_token_t        *toks;
+} json_filter_t;
+
+/**
+ * Bump arena for jansson allocations, reset after every row.  Rows that
+ * fit the first block never allocate.
+ */
+#define JSON_ARENA_BLOCK_SIZE (64 * 1024)
+
+typedef struct {
+    char            *block;         /* first block, kept across resets */
+    Size            block_size;
+    char            *ptr;
+    char            *end;
+    MemoryContext   overflow;       /* blocks beyond the first */
+    bool            overflowed;
+} json_arena_t;
+
+/**
+ * Compressed input
+ *
+ * Compressed bytes are taken from the formatter's data buffer as they
+ * arrive and decoded into a window that objects are split from instead.
+ * The decoder's state is kept as void * so zlib and zstd stay out of
+ * this header.
+ */
+typedef enum {
+    JSON_COMPRESS_NONE,
+    JSON_COMPRESS_GZIP,
+    JSON_COMPRESS_ZSTD
+} json_compress_t;
+
+#define JSON_INFLATE_WINDOW_SIZE (256 * 1024)
+
+typedef struct {
+    json_compress_t method;
+    MemoryContext   ctx;        /* everything the decoder allocates */
+    void            *stream;    /* z_stream or ZSTD_DCtx */
+    char            *in;        /* compressed bytes not yet decoded */
+    int             in_cur;
+    int             in_len;
+    int             in_size;
+    char            *buf;       /* decoded window */
+    int             cur;
+    int             len;
+    int             size;
+    int             skip;       /* bad row stepped over by the next call */
+    bool            pending;    /* decoder may hold output the window had no room for */
+    bool            partial;    /* inside a gzip member or zstd frame */
+} json_inflate_t;
+
+/**
+ * Instrumentation
+ *
+ * Built in with make STATS=yes, which defines JSON_STATS; otherwise the
+ * counters and every JSON_STATS_ macro compile to nothing.  A scan's
+ * counters are kept in the backend after the scan ends, for the log line
+ * and json_formatter_stats().  Phase times are in ticks of the cheapest
+ * clock: TSC cycles on x86, nanoseconds elsewhere.
+ */
+#ifdef JSON_STATS
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#else
+#include <time.h>
+#endif
+
+typedef enum {
+    JSON_PHASE_INFLATE,     /* decompressing input */
+    JSON_PHASE_SCAN,        /* finding object boundaries */
+    JSON_PHASE_FILTER,
+    JSON_PHASE_PARSE,       /* json_loadb, or the sax engine's single pass */
+    JSON_PHASE_LOOKUP,      /* resolving column paths in the jansson tree */
+    JSON_PHASE_CONVERT,
+    JSON_PHASE_FORM,        /* heap_form_tuple, or heap_deform_tuple for writes */
+    JSON_PHASE_WRITE,       /* writing a row as JSON text */
+    JSON_PHASES
+} json_phase_t;
+
+typedef struct json_stats_t {
+    bool            write;
+    bool            reported;   /* log line written */
+    bool            handed_out; /* a row was handed out and not returned, so it was rejected */
+    int64           calls;
+    int64           rows;
+    int64           rejected;
+    int64           objects;    /* split from the input, filtered ones included */
+    int64           filtered;
+    int64           bytes;      /* split from the input, or written */
+    int64           max_object;
+    int64           need_more;  /* FMT_NEED_MORE_DATA returned */
+    int64           rescans;    /* incomplete objects scanned again from their start */
+    int64           shape_hits; /* keys predicted by the previous object's shape */
+    int64           shape_misses;
+    uint64          started;
+    uint64          ticks[JSON_PHASES];
+    struct json_stats_t *next;
+} json_stats_t;
+
+static inline uint64
+json_stats_now( void ) {
+#if defined(__x86_64__) || defined(__i386__)
+    return __rdtsc();
+#else
+    struct timespec ts;
+
+    clock_gettime( CLOCK_MONOTONIC, &ts );
+    return (uint64)ts.tv_sec * 1000000000 + ts.tv_nsec;
+#endif
+}
+
+#define JSON_STATS_COUNT(s, field, n)   ((s)->field += (n))
+#define JSON_STATS_MAX(s, field, n)     ((s)->field = Max( (s)->field, (n) ))
+#define JSON_STATS_SET(s, field, v)     ((s)->field = (v))
+#define JSON_STATS_BEGIN(s)             ((s)->started = json_stats_now())
+#define JSON_STATS_END(s, phase)        ((s)->ticks[phase] += json_stats_now() - (s)->started)
+#define JSON_STATS_REPORT(s)            json_stats_report( s )
+
+#else
+
+#define JSON_STATS_COUNT(s, field, n)   ((void)0)
+#define JSON_STATS_MAX(s, field, n)     ((void)0)
+#define JSON_STATS_SET(s, field, v)     ((void)0)
+#define JSON_STATS_BEGIN(s)             ((void)0)
+#define JSON_STATS_END(s, phase)        ((void)0)
+#define JSON_STATS_REPORT(s)            ((void)0)
+
+#endif
+
+/**
+ * Row queue
+ *
+ * Every complete object in the data buffer is split and converted in one
+ * pass, then handed out one tuple per call.  Converted values live in ctx
+ * until the next batch is filled.
+ */
+#define JSON_READ_BATCH_ROWS 256
+
+typedef struct {
+    int                 start;      /* offset of the object in the data buffer */
+    int                 len;
+    int                 element;    /* element of an unnested array, 0 otherwise */
+    json_scan_array_t   array;      /* scanner's top level array state past the object */
+    json_read_error_t   error;
+} json_read_row_t;
+
+typedef struct {
+    MemoryContext       ctx;
+    char                *data_buf;  /* buffer the batch was split from */
+    int                 data_len;
+    int                 cursor;     /* data cursor expected by the next row */
+    int                 end;        /* where splitting stopped, past any filtered objects */
+    json_scan_array_t   array;      /* scanner's top level array state at end */
+    int                 resume;     /* elements of the object at the cursor already handed out */
+    int                 nrows;
+    int                 maxrows;
+    int                 next;
+    json_read_row_t     *rows;
+    Datum               *values;    /* nrows * ncols */
+    bool                *nulls;
+    json_token_t        *deferred;  /* nrows * ncols, JSON_TOK_NONE unless deferred */
+} json_read_queue_t;
+
+/**
+ * Worker threads
+ *
+ * With the 'threads' option, each object split from the data buffer is
+ * queued as a job, and a pool of threads extracts its columns with the
+ * single pass extractor and checks and unescapes its text values while
+ * the backend goes on splitting.  The backend then converts the jobs in
+ * input order, so rows and rejected rows come out as they would without
+ * threads.  Workers only read the data buffer and write the job the
+ * backend allocated for them; they never call palloc, elog or anything
+ * else of the server's.  The pool itself lives in TopMemoryContext so its
+ * threads can be stopped at the end of the transaction, after the scan's
+ * memory is gone.
+ */
+#define JSON_WORKERS_MAX 16
+
+typedef struct {
+    const char      *buf;       /* the object, in the data buffer */
+    int             len;
+    json_token_t    *toks;      /* one per column */
+    char            *text;      /* unescaped and minified text values */
+    int             textsize;
+    bool            ok;
+    const char      *errmsg;    /* why extraction failed */
+    bool            done;
+} json_job_t;
+
+typedef struct json_workers_t {
+    int             nthreads;
+    int             started;
+    pthread_t       *threads;
+    json_plan_t     **plans;    /* a copy per thread, for its own shapes */
+    json_column_t   *columns;
+    int             ncols;
+    pthread_mutex_t lock;
+    pthread_cond_t  queued;     /* a job was queued, or stop was set */
+    pthread_cond_t  finished;   /* a job is done */
+    json_job_t      *jobs;      /* JSON_READ_BATCH_ROWS */
+    int             njobs;
+    int             taken;      /* jobs handed to a thread */
+    int             running;
+    bool            stop;
+    struct json_workers_t *next;
+} json_workers_t;
+
+typedef struct {
+    int             ncols;
+    json_engine_t   engine;
+    json_framing_t  framing;
+    bool            minify;
+    bool            *needed;    /* columns to read, NULL for all */
+    char            *unnest;    /* array path read one row per element, NULL if none */
+    json_elems_t    elems;
+    json_filter_t   *filter;    /* NULL unless rows are filtered */
+    json_inflate_t  *inflate;   /* NULL unless the input is compressed */
+    int             nthreads;
+    json_workers_t  *workers;   /* NULL unless objects are extracted by worker threads */
+    Datum           *values;
+    bool            *nulls;
+    char            *j_buf;
+    json_t          *j_root;
+    json_t          **j_vals;
+    json_token_t    *j_toks;
+    json_error_t    *j_error;
+    json_arena_t    *j_arena;
+    json_plan_t     *plan;
+    json_column_t   *columns;
+    int             j_len;
+    json_scan_state_t   scan;
+    json_read_queue_t   queue;
+    int             j_cursor;
+    int             rownum;
+#ifdef JSON_STATS
+    json_stats_t    *stats;
+#endif
+} user_read_ctx_t;
+
+/**
+ * MessagePack value as read from a record.  Strings, binaries and
+ * extensions span their payload; arrays and maps hold their member count
+ * in len, with their members between start and end.
+ */
+typedef enum {
+    JSON_MP_NONE = 0,
+    JSON_MP_NIL,
+    JSON_MP_BOOL,
+    JSON_MP_INT,
+    JSON_MP_UINT,       /* above the int64 range */
+    JSON_MP_FLOAT,
+    JSON_MP_STR,
+    JSON_MP_BIN,
+    JSON_MP_EXT,
+    JSON_MP_ARRAY,
+    JSON_MP_MAP
+} json_mp_type_t;
+
+typedef struct {
+    json_mp_type_t  type;
+    bool            boolean;
+    int64           i;
+    uint64          u;
+    double          d;
+    const char      *start;
+    const char      *end;
+    int             len;
+} json_mp_value_t;
+
+typedef struct {
+    int             ncols;
+    json_plan_t     *plan;
+    json_column_t   *columns;
+    json_mp_value_t *vals;
+    Datum           *values;
+    bool            *nulls;
+    int             rownum;
+} user_msgpack_read_ctx_t;
+
+/**
+ * How the writer treats SQL NULLs, selected with the 'null_mode' option.
+ * By default integers, floats and text are written as 0, 0.0 and "".
+ */
+typedef enum {
+    JSON_NULL_DEFAULT = 0,
+    JSON_NULL_NULL,         /* write null */
+    JSON_NULL_OMIT          /* leave the key out */
+} json_null_mode_t;
+
+/**
+ * Writer program: each op writes a run of literal text, then the value of
+ * column attnum unless it is -1
+ */
+typedef struct {
+    int             litoff;
+    int             litlen;
+    int             attnum;
+} json_write_op_t;
+
+struct json_write_column_t;
+
+typedef void (*json_emit_fn)( struct json_write_column_t *col, StringInfo out, Datum value );
+
+typedef struct json_write_column_t {
+    int             attnum;
+    Oid             typid;
+    const char      *name;
+    json_emit_fn    emit;
+    const char      *null;      /* written for a NULL value */
+    int             nulllen;
+    bool            validate;   /* check text is valid UTF-8 */
+    PGFunction      outfunc;    /* for values with no JSON form of their own */
+    struct json_write_column_t  *element;   /* writer for the elements of an array column, NULL otherwise */
+    Oid             elmtype;
+    int16           elmlen;
+    bool            elmbyval;
+    char            elmalign;
+} json_write_column_t;
+
+/**
+ * Steps used instead of ops when null columns are omitted, since whether
+ * a member needs a separator is then only known per row
+ */
+typedef enum {
+    JSON_WRITE_OPEN,        /* key, if any, and '{' */
+    JSON_WRITE_CLOSE,
+    JSON_WRITE_VALUE        /* key and the value of column attnum */
+} json_write_step_kind_t;
+
+typedef struct {
+    json_write_step_kind_t  kind;
+    int             keyoff;
+    int             keylen;
+    int             attnum;
+} json_write_step_t;
+
+typedef struct {
+    int             start;          /* output length before the object */
+    bool            empty;          /* no member written yet */
+    bool            parent_empty;   /* parent's state before the object */
+} json_write_frame_t;
+
+typedef struct {
+    int             ncols;
+    json_null_mode_t    null_mode;
+    json_write_column_t *columns;
+    int             nops;
+    int             maxops;
+    json_write_op_t *ops;
+    int             nsteps;
+    int             maxsteps;
+    json_write_step_t   *steps;
+    int             depth;          /* deepest nested object */
+    json_write_frame_t  *frames;    /* depth + 1 */
+    StringInfoData  lits;
+} json_write_plan_t;
+
+typedef struct {
+    int             ncolumns;
+    json_null_mode_t    null_mode;
+    json_t          *j_root;
+    json_t          **j_vals;
+    json_write_plan_t   *plan;
+    StringInfoData  buf;        /* bytea returned for each row, reused */
+    Datum           *dbvalues;
+    bool            *dbnulls;
+#ifdef JSON_STATS
+    json_stats_t    *stats;
+#endif
+} user_write_ctx_t;
+
+typedef struct {
+    int             ncolumns;
+    json_plan_t     *plan;
+    json_write_column_t *columns;
+    StringInfoData  buf;        /* bytea returned for each row, reused */
+    StringInfoData  scratch;    /* JSON text of values written as strings */
+    Datum           *dbvalues;
+    bool            *dbnulls;
+} user_msgpack_write_ctx_t;
+
+/* json_formatter.c */
+extern void json_read_raise( FunctionCallInfo fcinfo, TupleDesc tupdesc, int rownum, char *buf, int len, json_read_error_t *err );
+
+/* json_plan.c */
+extern json_plan_t *json_plan_build( TupleDesc tupdesc, const bool *needed, const char *unnest );
+extern json_plan_t *json_plan_paths( char **paths, int npaths, int *slots );
+extern json_plan_t *json_plan_copy( json_plan_t *plan );
+extern void json_plan_resolve( json_plan_t *plan, json_t *j_root, json_t **j_vals );
+
+/* json_filter.c */
+extern json_filter_t *json_filter_parse( const char *spec );
+extern bool json_filter_match( json_filter_t *filter, const char *buf, int len );
+
+/* json_arena.c */
+extern void json_arena_install( void );
+extern void json_arena_free( void *ptr );
+extern json_arena_t *json_arena_create( MemoryContext parent, Size block_size );
+extern void json_arena_begin( json_arena_t *arena );
+extern void json_arena_end( void );
+extern void json_arena_reset( json_arena_t *arena );
+
+/* json_convert.c */
+extern json_column_t *json_convert_setup( TupleDesc tupdesc );
+extern Datum json_convert_input( json_column_t *col, json_token_t *tok );
+extern int json_convert_prepare( json_column_t *col, json_token_t *tok, char *buf );
+
+/* json_compress.c */
+extern json_compress_t json_compress_parse( const char *val );
+extern json_inflate_t *json_inflate_create( json_compress_t method );
+extern void json_inflate_input( json_inflate_t *z, const char *buf, int len );
+extern bool json_inflate_fill( json_inflate_t *z );
+extern bool json_inflate_drained( json_inflate_t *z );
+extern void json_inflate_finish( json_inflate_t *z );
+
+/* json_stats.c */
+#ifdef JSON_STATS
+extern void json_stats_install( void );
+extern json_stats_t *json_stats_create( bool write );
+extern void json_stats_report( json_stats_t *stats );
+#endif
+
+/* json_workers.c */
+extern void json_workers_install( void );
+extern json_workers_t *json_workers_start( json_plan_t *plan, json_column_t *columns, int ncols, int nthreads );
+extern void json_workers_add( json_workers_t *w, const char *buf, int len );
+extern json_job_t *json_workers_wait( json_workers_t *w, int i );
+extern void json_workers_finish( json_workers_t *w );
+extern void json_workers_stop( json_workers_t *w );
+
+/* json_write.c */
+extern json_write_plan_t *json_write_compile( TupleDesc tupdesc, json_t *j_root, json_t **j_vals, json_null_mode_t null_mode );
+extern void json_write_row( json_write_plan_t *plan, Datum *values, bool *nulls, StringInfo out );
+extern void json_write_columns( json_write_plan_t *plan, TupleDesc tupdesc, json_null_mode_t null_mode );
+extern void json_write_escaped( StringInfo out, const char *str, int len );
+
+/* json_sax.c */
+extern bool json_sax_extract( json_plan_t *plan, const char *buf, int len, json_token_t *toks, const char **errmsg );
+extern bool json_sax_extract_unnest( json_plan_t *plan, const char *buf, int len, json_token_t *toks, json_elems_t *elems, const char **errmsg );
+extern bool json_sax_find( json_plan_t *plan, const char *buf, int len, json_token_t *toks );
+extern bool json_sax_elements( const char *buf, int len, json_elems_t *elems );
+extern int json_sax_unescape( const char *src, int len, char *dst );
+extern int json_sax_minify( const char *src, int len, char *dst );
+extern bool json_sax_valid_utf8( const char *str, int len );
+
+#endif
@@ -0,0 +1,966 @@
+/*
+ * Copyright (c) 2013 Dillon Woods <dewoods@gmail.com>
+ *
+ * greenplum-json-formatter is free software; you can redistribute it and/or modify
+ * it under the terms of the MIT license. See LICENSE for details.
+ */
+
+#include <float.h>
+#include <limits.h>
+#include <math.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "json_formatter.h"
+
+#include "fmgr.h"
+#include "access/formatter.h"
+#include "catalog/pg_type.h"
+#include "utils/array.h"
+#include "utils/builtins.h"
+#include "utils/memutils.h"
+
+/**
+ * MessagePack records
+ *
+ * json_formatter_msgpack_read and json_formatter_msgpack_write move rows as
+ * MessagePack maps rather than JSON text.  Every record is a four byte big
+ * endian length followed by one map.  Dotted column names nest maps the
+ * same way they nest JSON objects, through the same column plan, and
+ * numbers are read and written in their binary form.  Values with no
+ * MessagePack type of their own (numerics, dates, timestamps) are strings
+ * in the form the JSON writer gives them.
+ */
+
+PG_FUNCTION_INFO_V1( json_formatter_msgpack_read );
+PG_FUNCTION_INFO_V1( json_formatter_msgpack_write );
+
+Datum json_formatter_msgpack_read( PG_FUNCTION_ARGS );
+Datum json_formatter_msgpack_write( PG_FUNCTION_ARGS );
+
+#define JSON_MP_MAX_DEPTH 1024
+#define JSON_MP_PREFIX 4
+
+typedef struct {
+    const char      *p;
+    const char      *end;
+    int             depth;
+    const char      *errmsg;
+} json_mp_t;
+
+static bool
+mp_error( json_mp_t *m, const char *msg ) {
+    if( !m->errmsg )
+        m->errmsg = msg;
+    return false;
+}
+
+static inline uint64
+mp_be( const char *p, int n ) {
+    const unsigned char *u = (const unsigned char *)p;
+    uint64              val = 0;
+    int                 i;
+
+    for( i=0; i < n; i++ )
+        val = (val << 8) | u[i];
+
+    return val;
+}
+
+/**
+ * Take n bytes of payload, or a length or value of n bytes
+ */
+static bool
+mp_take( json_mp_t *m, int64 n, const char **start ) {
+    if( n < 0 || m->end - m->p < n )
+        return mp_error( m, "unexpected end of record" );
+
+    *start = m->p;
+    m->p += n;
+    return true;
+}
+
+static bool
+mp_uint( json_mp_t *m, int n, uint64 *val ) {
+    const char *start;
+
+    if( !mp_take( m, n, &start ) )
+        return false;
+
+    *val = mp_be( start, n );
+    return true;
+}
+
+/**
+ * Read the header of the next value.  Scalars, strings, binaries and
+ * extensions are consumed whole; the members of arrays and maps are left
+ * for the caller.
+ */
+static bool
+mp_read( json_mp_t *m, json_mp_value_t *v ) {
+    unsigned char   c;
+    uint64          n;
+    int             width;
+
+    if( m->p >= m->end )
+        return mp_error( m, "unexpected end of record" );
+
+    c = (unsigned char)*m->p++;
+
+    if( c <= 0x7f ) {
+        v->type = JSON_MP_INT;
+        v->i = c;
+        return true;
+    }
+    if( c >= 0xe0 ) {
+        v->type = JSON_MP_INT;
+        v->i = (int8)c;
+        return true;
+    }
+    if( c >= 0x80 && c <= 0x8f ) {
+        v->type = JSON_MP_MAP;
+        v->len = c & 0x0f;
+        v->start = m->p;
+        return true;
+    }
+    if( c >= 0x90 && c <= 0x9f ) {
+        v->type = JSON_MP_ARRAY;
+        v->len = c & 0x0f;
+        v->start = m->p;
+        return true;
+    }
+    if( c >= 0xa0 && c <= 0xbf ) {
+        v->type = JSON_MP_STR;
+        v->len = c & 0x1f;
+        return mp_take( m, v->len, &v->start );
+    }
+
+    switch( c ) {
+        case 0xc0:
+            v->type = JSON_MP_NIL;
+            return true;
+        case 0xc2:
+        case 0xc3:
+            v->type = JSON_MP_BOOL;
+            v->boolean = (c == 0xc3);
+            return true;
+        case 0xc4:
+        case 0xc5:
+        case 0xc6:
+            width = 1 << (c - 0xc4);
+            if( !mp_uint( m, width, &n ) )
+                return false;
+            v->type = JSON_MP_BIN;
+            v->len = n;
+            return mp_take( m, n, &v->start );
+        case 0xc7:
+        case 0xc8:
+        case 0xc9:
+            width = 1 << (c - 0xc7);
+            if( !mp_uint( m, width, &n ) )
+                return false;
+            v->type = JSON_MP_EXT;
+            v->len = n;
+            return mp_take( m, n + 1, &v->start );
+        case 0xca:
+        {
+            uint32  bits;
+            float4  f;
+
+            if( !mp_uint( m, 4, &n ) )
+                return false;
+            bits = (uint32)n;
+            memcpy( &f, &bits, sizeof(f) );
+            v->type = JSON_MP_FLOAT;
+            v->d = f;
+            return true;
+        }
+        case 0xcb:
+        {
+            float8  d;
+
+            if( !mp_uint( m, 8, &n ) )
+                return false;
+            memcpy( &d, &n, sizeof(d) );
+            v->type = JSON_MP_FLOAT;
+            v->d = d;
+            return true;
+        }
+        case 0xcc:
+        case 0xcd:
+        case 0xce:
+        case 0xcf:
+            if( !mp_uint( m, 1 << (c - 0xcc), &n ) )
+                return false;
+            if( n > (uint64)INT64CONST(0x7FFFFFFFFFFFFFFF) ) {
+                v->type = JSON_MP_UINT;
+                v->u = n;
+            } else {
+                v->type = JSON_MP_INT;
+                v->i = (int64)n;
+            }
+            return true;
+        case 0xd0:
+        case 0xd1:
+        case 0xd2:
+        case 0xd3:
+            width = 1 << (c - 0xd0);
+            if( !mp_uint( m, width, &n ) )
+                return false;
+            /* sign extend from the encoded width */
+            if( width < 8 && (n & ((uint64)1 << (width * 8 - 1))) )
+                n |= ~(uint64)0 << (width * 8);
+            v->type = JSON_MP_INT;
+            v->i = (int64)n;
+            return true;
+        case 0xd4:
+        case 0xd5:
+        case 0xd6:
+        case 0xd7:
+        case 0xd8:
+            v->type = JSON_MP_EXT;
+            v->len = 1 << (c - 0xd4);
+            return mp_take( m, v->len + 1, &v->start );
+        case 0xd9:
+        case 0xda:
+        case 0xdb:
+            if( !mp_uint( m, 1 << (c - 0xd9), &n ) )
+                return false;
+            v->type = JSON_MP_STR;
+            v->len = n;
+            return mp_take( m, n, &v->start );
+        case 0xdc:
+        case 0xdd:
+            if( !mp_uint( m, c == 0xdc ? 2 : 4, &n ) )
+                return false;
+            v->type = JSON_MP_ARRAY;
+            v->len = n;
+            v->start = m->p;
+            return true;
+        case 0xde:
+        case 0xdf:
+            if( !mp_uint( m, c == 0xde ? 2 : 4, &n ) )
+                return false;
+            v->type = JSON_MP_MAP;
+            v->len = n;
+            v->start = m->p;
+            return true;
+        default:
+            return mp_error( m, "invalid type byte" );
+    }
+}
+
+/**
+ * Step over the members of an array or map whose header was just read
+ */
+static bool
+mp_skip( json_mp_t *m, json_mp_value_t *v ) {
+    json_mp_value_t member;
+    int64           n;
+
+    if( v->type != JSON_MP_ARRAY && v->type != JSON_MP_MAP )
+        return true;
+
+    if( ++m->depth > JSON_MP_MAX_DEPTH )
+        return mp_error( m, "maximum nesting depth exceeded" );
+
+    for( n = v->type == JSON_MP_MAP ? (int64)v->len * 2 : v->len; n > 0; n-- ) {
+        if( !mp_read( m, &member ) || !mp_skip( m, &member ) )
+            return false;
+    }
+
+    m->depth--;
+    return true;
+}
+
+static json_plan_node_t *
+mp_match( json_plan_node_t *node, const char *key, int keylen ) {
+    json_plan_node_t *child;
+
+    for( child = node->children; child; child = child->next ) {
+        if( child->keylen == keylen && memcmp( child->key, key, keylen ) == 0 )
+            return child;
+    }
+
+    return NULL;
+}
+
+/**
+ * Walk the members of a map, recording the values of planned columns
+ */
+static bool
+mp_map( json_mp_t *m, json_plan_node_t *node, int count, json_mp_value_t *vals ) {
+    int i;
+
+    if( ++m->depth > JSON_MP_MAX_DEPTH )
+        return mp_error( m, "maximum nesting depth exceeded" );
+
+    for( i=0; i < count; i++ ) {
+        json_mp_value_t     key;
+        json_mp_value_t     val;
+        json_plan_node_t    *child = NULL;
+
+        if( !mp_read( m, &key ) || !mp_skip( m, &key ) )
+            return false;
+        if( key.type == JSON_MP_STR )
+            child = mp_match( node, key.start, key.len );
+
+        if( !mp_read( m, &val ) )
+            return false;
+
+        if( child && child->children && val.type == JSON_MP_MAP ) {
+            if( !mp_map( m, child, val.len, vals ) )
+                return false;
+        } else if( !mp_skip( m, &val ) ) {
+            return false;
+        }
+
+        val.end = m->p;
+        if( child && child->attnum >= 0 )
+            vals[child->attnum] = val;
+    }
+
+    m->depth--;
+    return true;
+}
+
+/**
+ * Find the planned columns in a record, which must be a single map
+ */
+static bool
+mp_extract( json_plan_t *plan, const char *buf, int len, json_mp_value_t *vals, const char **reason ) {
+    json_mp_t       m;
+    json_mp_value_t root;
+
+    memset( vals, 0, sizeof(json_mp_value_t) * plan->ncols );
+
+    m.p = buf;
+    m.end = buf + len;
+    m.depth = 0;
+    m.errmsg = NULL;
+
+    if( !mp_read( &m, &root ) ) {
+        *reason = m.errmsg;
+        return false;
+    }
+    if( root.type != JSON_MP_MAP ) {
+        *reason = "expected a map";
+        return false;
+    }
+    if( !mp_map( &m, &plan->root, root.len, vals ) ) {
+        *reason = m.errmsg;
+        return false;
+    }
+    if( m.p != m.end ) {
+        *reason = "trailing data after map";
+        return false;
+    }
+
+    return true;
+}
+
+static json_convert_result_t
+mp_fail( json_column_t *col, json_read_error_t *err, json_read_status_t status ) {
+    err->status = status;
+    err->attnum = col->attnum;
+    err->detail = col->expected;
+    return JSON_CONVERT_ERROR;
+}
+
+static json_convert_result_t mp_convert( json_column_t *col, json_mp_value_t *v, Datum *value, json_read_error_t *err );
+
+/**
+ * Build an array column from a MessagePack array, converting each member
+ * as the element type
+ */
+static json_convert_result_t
+mp_convert_array( json_column_t *col, json_mp_value_t *v, Datum *value, json_read_error_t *err ) {
+    json_mp_t       m;
+    Datum           *values;
+    bool            *nulls;
+    int             dims[1];
+    int             lbs[1];
+    int             i;
+
+    if( v->type != JSON_MP_ARRAY )
+        return mp_fail( col, err, JSON_READ_TYPE_ERROR );
+
+    if( v->len == 0 ) {
+        *value = PointerGetDatum( construct_empty_array( col->element->typid ) );
+        return JSON_CONVERT_OK;
+    }
+
+    m.p = v->start;
+    m.end = v->end;
+    m.depth = 0;
+    m.errmsg = NULL;
+
+    values = palloc( sizeof(Datum) * v->len );
+    nulls = palloc( sizeof(bool) * v->len );
+
+    for( i=0; i < v->len; i++ ) {
+        json_mp_value_t member;
+
+        /* the record was walked whole before conversion, so this cannot fail */
+        if( !mp_read( &m, &member ) || !mp_skip( &m, &member ) )
+            return mp_fail( col, err, JSON_READ_TYPE_ERROR );
+        member.end = m.p;
+
+        nulls[i] = (member.type == JSON_MP_NIL);
+        if( nulls[i] )
+            continue;
+
+        if( mp_convert( col->element, &member, &values[i], err ) != JSON_CONVERT_OK )
+            return JSON_CONVERT_ERROR;
+    }
+
+    dims[0] = v->len;
+    lbs[0] = 1;
+    *value = PointerGetDatum( construct_md_array( values, nulls, 1, dims, lbs, col->element->typid,
+                                                  col->elmlen, col->elmbyval, col->elmalign ) );
+
+    return JSON_CONVERT_OK;
+}
+
+/**
+ * Convert one value.  Numbers and booleans are taken as they are;
+ * strings, and scalars bound for text columns, go through the JSON
+ * column converter as a token, and through the type's input function if
+ * it leaves them.
+ */
+static json_convert_result_t
+mp_convert( json_column_t *col, json_mp_value_t *v, Datum *value, json_read_error_t *err ) {
+    json_token_t    tok;
+    StringInfoData  buf;
+    int64           lo, hi;
+    double          d;
+
+    if( col->element )
+        return mp_convert_array( col, v, value, err );
+
+    switch( col->typid ) {
+        case INT2OID:
+        case INT4OID:
+        case INT8OID:
+            if( v->type == JSON_MP_UINT )
+                return mp_fail( col, err, JSON_READ_RANGE_ERROR );
+            if( v->type != JSON_MP_INT )
+                return mp_fail( col, err, JSON_READ_TYPE_ERROR );
+
+            lo = col->typid == INT2OID ? SHRT_MIN : col->typid == INT4OID ? INT_MIN : INT64CONST(-0x7FFFFFFFFFFFFFFF) - 1;
+            hi = col->typid == INT2OID ? SHRT_MAX : col->typid == INT4OID ? INT_MAX : INT64CONST(0x7FFFFFFFFFFFFFFF);
+            if( v->i < lo || v->i > hi )
+                return mp_fail( col, err, JSON_READ_RANGE_ERROR );
+
+            if( col->typid == INT2OID )
+                *value = Int16GetDatum( (int16)v->i );
+            else if( col->typid == INT4OID )
+                *value = Int32GetDatum( (int32)v->i );
+            else
+                *value = Int64GetDatum( v->i );
+            return JSON_CONVERT_OK;
+        case FLOAT4OID:
+        case FLOAT8OID:
+            if( v->type == JSON_MP_INT )
+                d = (double)v->i;
+            else if( v->type == JSON_MP_UINT )
+                d = (double)v->u;
+            else if( v->type == JSON_MP_FLOAT )
+                d = v->d;
+            else
+                return mp_fail( col, err, JSON_READ_TYPE_ERROR );
+
+            if( col->typid == FLOAT8OID ) {
+                *value = Float8GetDatum( d );
+                return JSON_CONVERT_OK;
+            }
+
+            if( (isinf( (float4)d ) && !isinf( d )) || ((float4)d == 0.0 && d != 0.0) )
+                return mp_fail( col, err, JSON_READ_RANGE_ERROR );
+            *value = Float4GetDatum( (float4)d );
+            return JSON_CONVERT_OK;
+        case NUMERICOID:
+            if( v->type == JSON_MP_INT ) {
+                *value = DirectFunctionCall1( int8_numeric, Int64GetDatum( v->i ) );
+                return JSON_CONVERT_OK;
+            }
+            if( v->type == JSON_MP_FLOAT ) {
+                *value = DirectFunctionCall1( float8_numeric, Float8GetDatum( v->d ) );
+                return JSON_CONVERT_OK;
+            }
+            if( v->type == JSON_MP_STR ) {
+                tok.type = JSON_TOK_STRING;
+                tok.escaped = false;
+                tok.prepared = false;
+                tok.start = v->start;
+                tok.len = v->len;
+                *value = json_convert_input( col, &tok );
+                return JSON_CONVERT_OK;
+            }
+            if( v->type != JSON_MP_UINT )
+                return mp_fail( col, err, JSON_READ_TYPE_ERROR );
+            break;
+        case BOOLOID:
+            if( v->type != JSON_MP_BOOL )
+                return mp_fail( col, err, JSON_READ_TYPE_ERROR );
+            *value = BoolGetDatum( v->boolean );
+            return JSON_CONVERT_OK;
+        default:
+            break;
+    }
+
+    /**
+     * Present the value as the JSON extractor would.  json columns take
+     * JSON text, so their strings are quoted and escaped.
+     */
+    tok.escaped = false;
+    tok.prepared = false;
+    switch( v->type ) {
+        case JSON_MP_STR:
+            tok.type = JSON_TOK_STRING;
+            if( col->raw ) {
+                initStringInfo( &buf );
+                json_write_escaped( &buf, v->start, v->len );
+                tok.start = buf.data;
+                tok.len = buf.len;
+            } else {
+                tok.start = v->start;
+                tok.len = v->len;
+            }
+            break;
+        case JSON_MP_INT:
+        case JSON_MP_UINT:
+        case JSON_MP_FLOAT:
+            initStringInfo( &buf );
+            if( v->type == JSON_MP_INT ) {
+                appendStringInfo( &buf, INT64_FORMAT, v->i );
+                tok.type = JSON_TOK_INTEGER;
+            } else if( v->type == JSON_MP_UINT ) {
+                appendStringInfo( &buf, UINT64_FORMAT, v->u );
+                tok.type = JSON_TOK_INTEGER;
+            } else {
+                if( isnan( v->d ) || isinf( v->d ) )
+                    return mp_fail( col, err, JSON_READ_TYPE_ERROR );
+                appendStringInfo( &buf, "%.17g", v->d );
+                if( !strpbrk( buf.data, ".eE" ) )
+                    appendStringInfoString( &buf, ".0" );
+                tok.type = JSON_TOK_REAL;
+            }
+            tok.start = buf.data;
+            tok.len = buf.len;
+            break;
+        case JSON_MP_BOOL:
+            tok.type = v->boolean ? JSON_TOK_TRUE : JSON_TOK_FALSE;
+            tok.start = v->boolean ? "true" : "false";
+            tok.len = strlen( tok.start );
+            break;
+        default:
+            return mp_fail( col, err, JSON_READ_TYPE_ERROR );
+    }
+
+    switch( col->convert( col, &tok, value, err ) ) {
+        case JSON_CONVERT_OK:
+            return JSON_CONVERT_OK;
+        case JSON_CONVERT_DEFER:
+            /* the row is being handed out, so this error belongs to it */
+            *value = json_convert_input( col, &tok );
+            return JSON_CONVERT_OK;
+        default:
+            return JSON_CONVERT_ERROR;
+    }
+}
+
+/**
+ * Records that cannot be read are rejected like rows with bad values,
+ * since their length prefix still says where the next record starts
+ */
+static void
+mp_reject( FunctionCallInfo fcinfo, int rownum, char *buf, int len, const char *reason ) {
+    FORMATTER_SET_BAD_ROW_NUM( fcinfo, rownum );
+    FORMATTER_SET_BAD_ROW_DATA( fcinfo, buf, len );
+    ereport( ERROR, (
+        errcode( ERRCODE_DATA_EXCEPTION ),
+        errmsg( "Invalid MessagePack record: %s", reason ? reason : "unknown error" )
+    ) );
+}
+
+Datum
+json_formatter_msgpack_read( PG_FUNCTION_ARGS ) {
+    HeapTuple               tuple;
+    TupleDesc               tupdesc;
+    MemoryContext           mc, omc;
+    user_msgpack_read_ctx_t *user_ctx;
+    json_read_error_t       err;
+    const char              *reason = NULL;
+    char                    *data_buf;
+    char                    *rec;
+    int                     data_cur;
+    int                     data_len;
+    int                     reclen;
+    int                     ncols;
+    int                     i;
+
+    if( !CALLED_AS_FORMATTER( fcinfo ) )
+        elog( ERROR, "json_formatter_msgpack_read: not called by format manager" );
+
+    tupdesc = FORMATTER_GET_TUPDESC( fcinfo );
+    ncols = tupdesc->natts;
+    user_ctx = (user_msgpack_read_ctx_t *)FORMATTER_GET_USER_CTX( fcinfo );
+
+    data_buf = FORMATTER_GET_DATABUF( fcinfo );
+    data_len = FORMATTER_GET_DATALEN( fcinfo );
+    data_cur = FORMATTER_GET_DATACURSOR( fcinfo );
+
+    /**
+     * First call to formatter, setup context
+     */
+    if( user_ctx == NULL ) {
+        user_ctx = palloc( sizeof(user_msgpack_read_ctx_t) );
+        user_ctx->ncols = ncols;
+        user_ctx->plan = json_plan_build( tupdesc, NULL, NULL );
+        user_ctx->columns = json_convert_setup( tupdesc );
+        user_ctx->vals = palloc( sizeof(json_mp_value_t) * ncols );
+        user_ctx->values = palloc( sizeof(Datum) * ncols );
+        user_ctx->nulls = palloc( sizeof(bool) * ncols );
+        user_ctx->rownum = 0;
+
+        FORMATTER_SET_USER_CTX( fcinfo, user_ctx );
+    } else {
+        user_ctx->rownum++;
+    }
+
+    if( data_cur == data_len )
+        FORMATTER_RETURN_NOTIFICATION( fcinfo, FMT_NEED_MORE_DATA );
+
+    /**
+     * Wait for the whole record, length prefix included
+     */
+    reclen = -1;
+    if( data_len - data_cur >= JSON_MP_PREFIX )
+        reclen = (int)mp_be( data_buf + data_cur, JSON_MP_PREFIX );
+
+    if( reclen < 0 || reclen > data_len - data_cur - JSON_MP_PREFIX ) {
+        if( FORMATTER_GET_SAW_EOF( fcinfo ) ) {
+            FORMATTER_SET_BAD_ROW_NUM( fcinfo, user_ctx->rownum );
+            FORMATTER_SET_BAD_ROW_DATA( fcinfo, data_buf+data_cur, data_len-data_cur );
+            ereport( ERROR, (
+                errcode( ERRCODE_DATA_EXCEPTION ),
+                errmsg( "Incomplete MessagePack record: %d bytes left at end of input", data_len-data_cur )
+            ) );
+        }
+
+        FORMATTER_RETURN_NOTIFICATION( fcinfo, FMT_NEED_MORE_DATA );
+    }
+
+    rec = data_buf + data_cur;
+
+    mc = FORMATTER_GET_PER_ROW_MEM_CTX( fcinfo );
+    omc = MemoryContextSwitchTo( mc );
+
+    /**
+     * The cursor stays on the record until it is converted, so a rejected
+     * record is skipped as a whole
+     */
+    if( !mp_extract( user_ctx->plan, rec + JSON_MP_PREFIX, reclen, user_ctx->vals, &reason ) ) {
+        MemoryContextSwitchTo( omc );
+        mp_reject( fcinfo, user_ctx->rownum, rec, reclen + JSON_MP_PREFIX, reason );
+    }
+
+    FORMATTER_SET_BAD_ROW_NUM( fcinfo, user_ctx->rownum );
+    FORMATTER_SET_BAD_ROW_DATA( fcinfo, rec, reclen + JSON_MP_PREFIX );
+
+    for( i=0; i < ncols; i++ ) {
+        json_mp_value_t *v = &user_ctx->vals[i];
+
+        user_ctx->nulls[i] = (v->type == JSON_MP_NONE || v->type == JSON_MP_NIL);
+        if( user_ctx->nulls[i] ) {
+            user_ctx->values[i] = (Datum)0;
+            continue;
+        }
+
+        if( mp_convert( &user_ctx->columns[i], v, &user_ctx->values[i], &err ) != JSON_CONVERT_OK ) {
+            MemoryContextSwitchTo( omc );
+            if( err.status == JSON_READ_PARSE_ERROR )
+                mp_reject( fcinfo, user_ctx->rownum, rec, reclen + JSON_MP_PREFIX, err.detail );
+            json_read_raise( fcinfo, tupdesc, user_ctx->rownum, rec, reclen + JSON_MP_PREFIX, &err );
+        }
+    }
+
+    FORMATTER_SET_DATACURSOR( fcinfo, data_cur + JSON_MP_PREFIX + reclen );
+    MemoryContextSwitchTo( omc );
+
+    tuple = heap_form_tuple( tupdesc, user_ctx->values, user_ctx->nulls );
+
+    FORMATTER_SET_TUPLE( fcinfo, tuple );
+    FORMATTER_RETURN_TUPLE( tuple );
+}
+
+static void
+mp_put( StringInfo out, unsigned char type, uint64 val, int width ) {
+    char    buf[9];
+    int     i;
+
+    buf[0] = type;
+    for( i=width; i > 0; i-- ) {
+        buf[i] = (char)(val & 0xff);
+        val >>= 8;
+    }
+
+    appendBinaryStringInfo( out, buf, width + 1 );
+}
+
+/**
+ * Integers take the smallest encoding that holds them
+ */
+static void
+mp_write_int( StringInfo out, int64 v ) {
+    if( v >= 0 ) {
+        if( v <= 0x7f )
+            appendStringInfoChar( out, (char)v );
+        else if( v <= 0xff )
+            mp_put( out, 0xcc, v, 1 );
+        else if( v <= 0xffff )
+            mp_put( out, 0xcd, v, 2 );
+        else if( v <= INT64CONST(0xffffffff) )
+            mp_put( out, 0xce, v, 4 );
+        else
+            mp_put( out, 0xcf, v, 8 );
+    } else {
+        if( v >= -32 )
+            appendStringInfoChar( out, (char)v );
+        else if( v >= -128 )
+            mp_put( out, 0xd0, (uint8)v, 1 );
+        else if( v >= -32768 )
+            mp_put( out, 0xd1, (uint16)v, 2 );
+        else if( v >= INT_MIN )
+            mp_put( out, 0xd2, (uint32)v, 4 );
+        else
+            mp_put( out, 0xd3, (uint64)v, 8 );
+    }
+}
+
+static void
+mp_write_header( StringInfo out, int fix, int fixmax, unsigned char type16, uint32 n ) {
+    if( n <= (uint32)fixmax )
+        appendStringInfoChar( out, (char)(fix | n) );
+    else if( n <= 0xffff )
+        mp_put( out, type16, n, 2 );
+    else
+        mp_put( out, type16 + 1, n, 4 );
+}
+
+static void
+mp_write_str( StringInfo out, const char *str, int len ) {
+    if( len < 32 )
+        appendStringInfoChar( out, (char)(0xa0 | len) );
+    else if( len <= 0xff )
+        mp_put( out, 0xd9, len, 1 );
+    else if( len <= 0xffff )
+        mp_put( out, 0xda, len, 2 );
+    else
+        mp_put( out, 0xdb, len, 4 );
+
+    appendBinaryStringInfo( out, str, len );
+}
+
+static void mp_write_value( user_msgpack_write_ctx_t *user_ctx, json_write_column_t *col, Datum value, StringInfo out );
+
+static void
+mp_write_array( user_msgpack_write_ctx_t *user_ctx, json_write_column_t *elem, int ndim, int *dims, Datum *values, bool *nulls, int *next, StringInfo out ) {
+    int i;
+
+    mp_write_header( out, 0x90, 15, 0xdc, dims[0] );
+
+    for( i=0; i < dims[0]; i++ ) {
+        if( ndim > 1 ) {
+            mp_write_array( user_ctx, elem, ndim - 1, dims + 1, values, nulls, next, out );
+        } else {
+            if( nulls[*next] )
+                appendStringInfoChar( out, (char)0xc0 );
+            else
+                mp_write_value( user_ctx, elem, values[*next], out );
+            (*next)++;
+        }
+    }
+}
+
+/**
+ * Write one value.  Types the JSON writer gives as strings or numeric
+ * text are written as strings holding that text.
+ */
+static void
+mp_write_value( user_msgpack_write_ctx_t *user_ctx, json_write_column_t *col, Datum value, StringInfo out ) {
+    StringInfo  scratch = &user_ctx->scratch;
+
+    switch( col->typid ) {
+        case INT2OID:
+            mp_write_int( out, DatumGetInt16( value ) );
+            return;
+        case INT4OID:
+            mp_write_int( out, DatumGetInt32( value ) );
+            return;
+        case INT8OID:
+            mp_write_int( out, DatumGetInt64( value ) );
+            return;
+        case FLOAT4OID:
+        {
+            float4  f = DatumGetFloat4( value );
+            uint32  bits;
+
+            memcpy( &bits, &f, sizeof(bits) );
+            mp_put( out, 0xca, bits, 4 );
+            return;
+        }
+        case FLOAT8OID:
+        {
+            float8  d = DatumGetFloat8( value );
+            uint64  bits;
+
+            memcpy( &bits, &d, sizeof(bits) );
+            mp_put( out, 0xcb, bits, 8 );
+            return;
+        }
+        case BOOLOID:
+            appendStringInfoChar( out, (char)(DatumGetBool( value ) ? 0xc3 : 0xc2) );
+            return;
+        case TEXTOID:
+        case VARCHAROID:
+        {
+            text    *txt = DatumGetTextPP( value );
+            char    *str = VARDATA_ANY( txt );
+            int     len = VARSIZE_ANY_EXHDR( txt );
+
+            if( col->validate && !json_sax_valid_utf8( str, len ) )
+                elog( ERROR, "Unable to set string value for column '%s'", col->name );
+
+            mp_write_str( out, str, len );
+            return;
+        }
+        default:
+            break;
+    }
+
+    if( col->element ) {
+        ArrayType   *array = DatumGetArrayTypeP( value );
+        Datum       *values;
+        bool        *nulls;
+        int         nelems;
+        int         next = 0;
+
+        if( ARR_NDIM( array ) == 0 ) {
+            appendStringInfoChar( out, (char)0x90 );
+            return;
+        }
+
+        deconstruct_array( array, col->elmtype, col->elmlen, col->elmbyval, col->elmalign,
+                           &values, &nulls, &nelems );
+        mp_write_array( user_ctx, col->element, ARR_NDIM( array ), ARR_DIMS( array ), values, nulls, &next, out );
+        return;
+    }
+
+    resetStringInfo( scratch );
+    col->emit( col, scratch, value );
+
+    if( scratch->len >= 2 && scratch->data[0] == '"' ) {
+        char    *str = palloc( scratch->len );
+        int     len = json_sax_unescape( scratch->data + 1, scratch->len - 2, str );
+
+        mp_write_str( out, str, len );
+        pfree( str );
+    } else {
+        mp_write_str( out, scratch->data, scratch->len );
+    }
+}
+
+/**
+ * Write the map for a plan node: one member per child, nested maps for
+ * children with columns below them
+ */
+static void
+mp_write_map( user_msgpack_write_ctx_t *user_ctx, json_plan_node_t *node, StringInfo out ) {
+    json_plan_node_t    *child;
+    int                 n = 0;
+
+    for( child = node->children; child; child = child->next )
+        n++;
+
+    mp_write_header( out, 0x80, 15, 0xde, n );
+
+    for( child = node->children; child; child = child->next ) {
+        mp_write_str( out, child->key, child->keylen );
+
+        if( child->children )
+            mp_write_map( user_ctx, child, out );
+        else if( user_ctx->dbnulls[child->attnum] )
+            appendStringInfoChar( out, (char)0xc0 );
+        else
+            mp_write_value( user_ctx, &user_ctx->columns[child->attnum], user_ctx->dbvalues[child->attnum], out );
+    }
+}
+
+Datum
+json_formatter_msgpack_write( PG_FUNCTION_ARGS ) {
+    HeapTupleHeader             rec = PG_GETARG_HEAPTUPLEHEADER(0);
+    TupleDesc                   tupdesc;
+    HeapTupleData               tuple;
+    MemoryContext               mc, omc;
+    user_msgpack_write_ctx_t    *user_ctx;
+    int                         ncolumns;
+    uint32                      len;
+    int                         i;
+
+    if( !CALLED_AS_FORMATTER(fcinfo) )
+        elog( ERROR, "json_formatter_msgpack_write: not called by format manager" );
+
+    tupdesc = FORMATTER_GET_TUPDESC( fcinfo );
+    ncolumns = tupdesc->natts;
+
+    user_ctx = (user_msgpack_write_ctx_t *)FORMATTER_GET_USER_CTX( fcinfo );
+
+    /**
+     * First call to formatter, setup context
+     */
+    if( user_ctx == NULL ) {
+        json_write_plan_t plan;
+
+        user_ctx = palloc( sizeof(user_msgpack_write_ctx_t) );
+        user_ctx->ncolumns = ncolumns;
+        user_ctx->plan = json_plan_build( tupdesc, NULL, NULL );
+
+        json_write_columns( &plan, tupdesc, JSON_NULL_NULL );
+        user_ctx->columns = plan.columns;
+
+        initStringInfo( &user_ctx->buf );
+        initStringInfo( &user_ctx->scratch );
+        user_ctx->dbvalues = palloc( sizeof(Datum) * ncolumns );
+        user_ctx->dbnulls = palloc( sizeof(bool) * ncolumns );
+
+        FORMATTER_SET_USER_CTX( fcinfo, user_ctx );
+    }
+
+    mc = FORMATTER_GET_PER_ROW_MEM_CTX( fcinfo );
+    omc = MemoryContextSwitchTo( mc );
+
+    tuple.t_len = HeapTupleHeaderGetDatumLength( rec );
+    ItemPointerSetInvalid( &(tuple.t_self) );
+    tuple.t_data = rec;
+    heap_deform_tuple( &tuple, tupdesc, user_ctx->dbvalues, user_ctx->dbnulls );
+
+    /**
+     * Write the map behind the bytea header and the record's length prefix,
+     * then fill the prefix in
+     */
+    resetStringInfo( &user_ctx->buf );
+    enlargeStringInfo( &user_ctx->buf, VARHDRSZ + JSON_MP_PREFIX );
+    user_ctx->buf.len = VARHDRSZ + JSON_MP_PREFIX;
+    mp_write_map( user_ctx, &user_ctx->plan->root, &user_ctx->buf );
+
+    len = user_ctx->buf.len - VARHDRSZ - JSON_MP_PREFIX;
+    for( i=0; i < JSON_MP_PREFIX; i++ )
+        user_ctx->buf.data[VARHDRSZ + i] = (char)(len >> (8 * (JSON_MP_PREFIX - 1 - i)));
+    SET_VARSIZE( user_ctx->buf.data, user_ctx->buf.len );
+
+    MemoryContextSwitchTo( omc );
+
+    PG_RETURN_BYTEA_P( user_ctx->buf.data );
+}
@@ -0,0 +1,210 @@
+/*
+ * Copyright (c) 2013 Dillon Woods <dewoods@gmail.com>
+ *
+ * greenplum-json-formatter is free software; you can redistribute it and/or modify
+ * it under the terms of the MIT license. See LICENSE for details.
+ */
+
+#include <string.h>
+
+#include "json_formatter.h"
+
+/**
+ * Find the child of node matching key, adding it if it does not exist yet.
+ * Children are kept in column order so resolution order is deterministic.
+ */
+static json_plan_node_t *
+json_plan_child( json_plan_node_t *node, const char *key, int keylen ) {
+    json_plan_node_t    *child;
+    json_plan_node_t    **tail = &node->children;
+
+    for( child = node->children; child; child = child->next ) {
+        if( child->keylen == keylen && memcmp( child->key, key, keylen ) == 0 )
+            return child;
+
+        tail = &child->next;
+    }
+
+    child = palloc0( sizeof(json_plan_node_t) );
+    child->key = palloc( keylen + 1 );
+    memcpy( child->key, key, keylen );
+    child->key[keylen] = '\0';
+    child->keylen = keylen;
+    child->attnum = -1;
+
+    *tail = child;
+    node->nchildren++;
+
+    return child;
+}
+
+/**
+ * Find the node for a dotted path below node, adding it and its parents as
+ * needed
+ */
+static json_plan_node_t *
+json_plan_descend( json_plan_node_t *node, const char *name ) {
+    const char *sep;
+
+    while( (sep = strchr( name, '.' )) != NULL ) {
+        node = json_plan_child( node, name, sep - name );
+        name = sep + 1;
+    }
+
+    return json_plan_child( node, name, strlen( name ) );
+}
+
+static json_plan_node_t *
+json_plan_path( json_plan_t *plan, const char *name ) {
+    return json_plan_descend( &plan->root, name );
+}
+
+static json_plan_t *
+json_plan_create( int ncols ) {
+    json_plan_t *plan = palloc0( sizeof(json_plan_t) );
+
+    plan->ncols = ncols;
+    plan->root.attnum = -1;
+    plan->ctx = CurrentMemoryContext;
+
+    return plan;
+}
+
+/**
+ * Split every column name on the nested separator once, up front, instead
+ * of once per row.  When needed is given, only the columns it marks are
+ * planned; the others are never looked up.
+ *
+ * When unnest names an array, columns below it ("items.sku") are planned
+ * relative to each element, and a column named for the array itself
+ * takes the whole element.
+ */
+json_plan_t *
+json_plan_build( TupleDesc tupdesc, const bool *needed, const char *unnest ) {
+    json_plan_t         *plan = json_plan_create( tupdesc->natts );
+    json_plan_node_t    *element = NULL;
+    int                 prefix = unnest ? strlen( unnest ) : 0;
+    int                 i;
+
+    if( unnest ) {
+        json_plan_node_t *node = json_plan_path( plan, unnest );
+
+        element = palloc0( sizeof(json_plan_node_t) );
+        element->attnum = -1;
+        node->element = element;
+    }
+
+    for( i=0; i < tupdesc->natts; i++ ) {
+        const char *name = tupdesc->attrs[i]->attname.data;
+
+        if( needed && !needed[i] )
+            continue;
+
+        if( unnest && strncmp( name, unnest, prefix ) == 0 ) {
+            if( name[prefix] == '\0' ) {
+                element->attnum = i;
+                continue;
+            }
+            if( name[prefix] == '.' ) {
+                json_plan_descend( element, name + prefix + 1 )->attnum = i;
+                continue;
+            }
+        }
+
+        json_plan_path( plan, name )->attnum = i;
+    }
+
+    return plan;
+}
+
+/**
+ * Plan arbitrary paths rather than columns.  Each distinct path gets the
+ * next token slot; slots[i] receives the slot of paths[i].
+ */
+json_plan_t *
+json_plan_paths( char **paths, int npaths, int *slots ) {
+    json_plan_t     *plan = json_plan_create( 0 );
+    int             i;
+
+    for( i=0; i < npaths; i++ ) {
+        json_plan_node_t *node = json_plan_path( plan, paths[i] );
+
+        if( node->attnum < 0 )
+            node->attnum = plan->ncols++;
+        slots[i] = node->attnum;
+    }
+
+    return plan;
+}
+
+static void
+json_plan_copy_node( json_plan_node_t *node, json_plan_node_t *copy ) {
+    json_plan_node_t    *child;
+    json_plan_node_t    **tail = &copy->children;
+
+    *copy = *node;
+    copy->children = NULL;
+    copy->next = NULL;
+    copy->element = NULL;
+    copy->shape = NULL;
+
+    for( child = node->children; child; child = child->next ) {
+        *tail = palloc( sizeof(json_plan_node_t) );
+        json_plan_copy_node( child, *tail );
+        tail = &(*tail)->next;
+    }
+
+    if( node->element ) {
+        copy->element = palloc( sizeof(json_plan_node_t) );
+        json_plan_copy_node( node->element, copy->element );
+    }
+
+    if( node->nchildren >= JSON_SHAPE_MIN_CHILDREN ) {
+        copy->shape = palloc( sizeof(json_shape_t) );
+        copy->shape->nkeys = 0;
+        copy->shape->max = JSON_SHAPE_WORKER_KEYS;
+        copy->shape->keys = palloc( sizeof(json_shape_key_t) * JSON_SHAPE_WORKER_KEYS );
+    }
+}
+
+/**
+ * Copy a plan for a worker thread.  Its shapes are allocated here, since
+ * the thread can not allocate, and are not shared with other threads.
+ */
+json_plan_t *
+json_plan_copy( json_plan_t *plan ) {
+    json_plan_t *copy = palloc0( sizeof(json_plan_t) );
+
+    copy->ncols = plan->ncols;
+    copy->ctx = NULL;
+    json_plan_copy_node( &plan->root, &copy->root );
+
+    return copy;
+}
+
+static void
+json_plan_resolve_node( json_plan_node_t *node, json_t *j_obj, json_t **j_vals ) {
+    json_plan_node_t    *child;
+
+    for( child = node->children; child; child = child->next ) {
+        json_t  *val = j_obj ? json_object_get( j_obj, child->key ) : NULL;
+
+        if( child->attnum >= 0 )
+            j_vals[child->attnum] = val;
+
+        /**
+         * Columns below a missing or non-object value are left NULL
+         */
+        if( child->children )
+            json_plan_resolve_node( child, json_is_object( val ) ? val : NULL, j_vals );
+    }
+}
+
+/**
+ * Look up the value for every column in a parsed JSON object.  Columns with
+ * no matching value are set to NULL.
+ */
+void
+json_plan_resolve( json_plan_t *plan, json_t *j_root, json_t **j_vals ) {
+    json_plan_resolve_node( &plan->root, j_root, j_vals );
+}
@@ -0,0 +1,815 @@
+/*
+ * Copyright (c) 2013 Dillon Woods <dewoods@gmail.com>
+ *
+ * greenplum-json-formatter is free software; you can redistribute it and/or modify
+ * it under the terms of the MIT license. See LICENSE for details.
+ */
+
+#include <string.h>
+
+#include "json_formatter.h"
+
+/**
+ * Single pass extractor
+ *
+ * Walks one JSON object, validating it as it goes, and matches keys
+ * against the column plan.  Values for planned columns are recorded as
+ * raw spans of the input; everything else is skipped without allocating.
+ */
+
+#define JSON_SAX_MAX_DEPTH 1024
+
+typedef struct {
+    const char      *p;
+    const char      *end;
+    json_token_t    *toks;
+    int             depth;
+    const char      *errmsg;
+    int             remaining;  /* planned values still to find, -1 to walk everything */
+    bool            done;
+    json_elems_t    *elems;     /* receives unnested elements, NULL if none */
+    int             ncols;
+    json_plan_t     *plan;
+} json_sax_t;
+
+static bool sax_value( json_sax_t *s, json_plan_node_t *node, json_token_t *tok );
+static bool sax_unnest( json_sax_t *s, json_plan_node_t *element );
+
+static inline void
+sax_skip_ws( json_sax_t *s ) {
+    while( s->p < s->end && (*s->p == ' ' || *s->p == '\n' || *s->p == '\r' || *s->p == '\t') )
+        s->p++;
+}
+
+static bool
+sax_error( json_sax_t *s, const char *msg ) {
+    if( !s->errmsg )
+        s->errmsg = msg;
+    return false;
+}
+
+static inline bool
+sax_is_hex( char c ) {
+    return (c >= '0' && c <= '9') || (c >= 'a' && c <= 'f') || (c >= 'A' && c <= 'F');
+}
+
+/**
+ * Scan a string starting at the opening quote.  start/len receive the
+ * contents between the quotes, still escaped.
+ */
+static bool
+sax_string( json_sax_t *s, const char **start, int *len, bool *escaped ) {
+    const char  *p = s->p + 1;
+    bool        esc = false;
+
+    while( p < s->end ) {
+        unsigned char c = (unsigned char)*p;
+
+        if( c == '"' ) {
+            *start = s->p + 1;
+            *len = p - *start;
+            *escaped = esc;
+            s->p = p + 1;
+            return true;
+        }
+
+        if( c < 0x20 )
+            return sax_error( s, "control character in string" );
+
+        if( c == '\\' ) {
+            esc = true;
+            if( ++p >= s->end )
+                break;
+
+            switch( *p ) {
+                case '"': case '\\': case '/':
+                case 'b': case 'f': case 'n': case 'r': case 't':
+                    break;
+                case 'u':
+                    if( s->end - p < 5 || !sax_is_hex( p[1] ) || !sax_is_hex( p[2] )
+                        || !sax_is_hex( p[3] ) || !sax_is_hex( p[4] ) )
+                        return sax_error( s, "invalid \\u escape" );
+                    p += 4;
+                    break;
+                default:
+                    return sax_error( s, "invalid escape" );
+            }
+        }
+
+        p++;
+    }
+
+    return sax_error( s, "unterminated string" );
+}
+
+static bool
+sax_number( json_sax_t *s, json_token_t *tok ) {
+    const char      *p = s->p;
+    json_tok_type_t type = JSON_TOK_INTEGER;
+
+    if( p < s->end && *p == '-' )
+        p++;
+
+    if( p < s->end && *p == '0' ) {
+        p++;
+    } else if( p < s->end && *p >= '1' && *p <= '9' ) {
+        while( p < s->end && *p >= '0' && *p <= '9' )
+            p++;
+    } else {
+        return sax_error( s, "invalid number" );
+    }
+
+    if( p < s->end && *p == '.' ) {
+        type = JSON_TOK_REAL;
+        p++;
+        if( p >= s->end || *p < '0' || *p > '9' )
+            return sax_error( s, "invalid number" );
+        while( p < s->end && *p >= '0' && *p <= '9' )
+            p++;
+    }
+
+    if( p < s->end && (*p == 'e' || *p == 'E') ) {
+        type = JSON_TOK_REAL;
+        p++;
+        if( p < s->end && (*p == '+' || *p == '-') )
+            p++;
+        if( p >= s->end || *p < '0' || *p > '9' )
+            return sax_error( s, "invalid number" );
+        while( p < s->end && *p >= '0' && *p <= '9' )
+            p++;
+    }
+
+    if( tok ) {
+        tok->type = type;
+        tok->start = s->p;
+        tok->len = p - s->p;
+    }
+    s->p = p;
+
+    return true;
+}
+
+static bool
+sax_literal( json_sax_t *s, const char *word, int len, json_tok_type_t type, json_token_t *tok ) {
+    if( s->end - s->p < len || memcmp( s->p, word, len ) != 0 )
+        return sax_error( s, "invalid literal" );
+
+    if( tok ) {
+        tok->type = type;
+        tok->start = s->p;
+        tok->len = len;
+    }
+    s->p += len;
+
+    return true;
+}
+
+/**
+ * Find the plan child for a key.  Keys containing escapes are compared in
+ * their unescaped form.
+ */
+static json_plan_node_t *
+sax_match( json_plan_node_t *node, const char *key, int keylen, bool escaped ) {
+    json_plan_node_t    *child;
+    char                buf[NAMEDATALEN * 4];
+
+    if( escaped ) {
+        if( keylen > (int)sizeof(buf) )
+            return NULL;
+        keylen = json_sax_unescape( key, keylen, buf );
+        if( keylen < 0 )
+            return NULL;
+        key = buf;
+    }
+
+    for( child = node->children; child; child = child->next ) {
+        if( child->keylen == keylen && memcmp( child->key, key, keylen ) == 0 )
+            return child;
+    }
+
+    return NULL;
+}
+
+/**
+ * Remember key n of the object at node and the child it matched
+ */
+static void
+sax_shape_learn( json_sax_t *s, json_plan_node_t *node, int n, const char *key, int keylen, json_plan_node_t *child ) {
+    json_shape_t        *shape = node->shape;
+    json_shape_key_t    *entry;
+
+    if( n >= JSON_SHAPE_MAX_KEYS )
+        return;
+
+    /* a worker's copy of the plan has its shapes allocated up front */
+    if( !s->plan->ctx && (!shape || n >= shape->max) )
+        return;
+
+    if( !shape ) {
+        shape = MemoryContextAlloc( s->plan->ctx, sizeof(json_shape_t) );
+        shape->nkeys = 0;
+        shape->max = 16;
+        shape->keys = MemoryContextAlloc( s->plan->ctx, sizeof(json_shape_key_t) * shape->max );
+        node->shape = shape;
+    } else if( n == shape->max ) {
+        shape->max = Min( shape->max * 2, JSON_SHAPE_MAX_KEYS );
+        shape->keys = repalloc( shape->keys, sizeof(json_shape_key_t) * shape->max );
+    }
+
+    entry = &shape->keys[n];
+    entry->child = child;
+    if( keylen <= JSON_SHAPE_KEY_LEN ) {
+        entry->keylen = keylen;
+        memcpy( entry->key, key, keylen );
+    } else {
+        entry->keylen = -1;
+    }
+
+    if( n >= shape->nkeys )
+        shape->nkeys = n + 1;
+}
+
+/**
+ * Find the plan child for key n of the object at node, trying the key the
+ * last object had in that position first.  Keys are compared as they
+ * appear in the input, so an escaped key is predicted as well.
+ */
+static inline json_plan_node_t *
+sax_shape_match( json_sax_t *s, json_plan_node_t *node, int n, const char *key, int keylen, bool escaped ) {
+    json_shape_t        *shape = node->shape;
+    json_plan_node_t    *child;
+
+    if( node->nchildren < JSON_SHAPE_MIN_CHILDREN )
+        return sax_match( node, key, keylen, escaped );
+
+    if( shape && n < shape->nkeys ) {
+        json_shape_key_t *entry = &shape->keys[n];
+
+        if( entry->keylen == keylen && memcmp( entry->key, key, keylen ) == 0 ) {
+            JSON_STATS_COUNT( s->plan, shape_hits, 1 );
+            return entry->child;
+        }
+    }
+
+    JSON_STATS_COUNT( s->plan, shape_misses, 1 );
+    child = sax_match( node, key, keylen, escaped );
+    sax_shape_learn( s, node, n, key, keylen, child );
+
+    return child;
+}
+
+static bool
+sax_object( json_sax_t *s, json_plan_node_t *node ) {
+    int n = 0;
+
+    if( ++s->depth > JSON_SAX_MAX_DEPTH )
+        return sax_error( s, "maximum nesting depth exceeded" );
+
+    s->p++;
+    sax_skip_ws( s );
+
+    if( s->p < s->end && *s->p == '}' ) {
+        s->p++;
+        s->depth--;
+        return true;
+    }
+
+    for( ;; ) {
+        const char          *key;
+        int                 keylen;
+        bool                escaped;
+        bool                fresh;
+        json_plan_node_t    *child = NULL;
+        json_token_t        *tok;
+
+        if( s->p >= s->end || *s->p != '"' )
+            return sax_error( s, "expected object key" );
+
+        if( !sax_string( s, &key, &keylen, &escaped ) )
+            return false;
+
+        if( node && node->children )
+            child = sax_shape_match( s, node, n++, key, keylen, escaped );
+
+        sax_skip_ws( s );
+        if( s->p >= s->end || *s->p != ':' )
+            return sax_error( s, "expected ':'" );
+        s->p++;
+
+        tok = (child && child->attnum >= 0) ? &s->toks[child->attnum] : NULL;
+        fresh = tok && tok->type == JSON_TOK_NONE;
+
+        if( !sax_value( s, child, tok ) )
+            return false;
+
+        /* stop once every planned value has been seen */
+        if( fresh && --s->remaining == 0 )
+            s->done = true;
+        if( s->done )
+            return true;
+
+        sax_skip_ws( s );
+        if( s->p < s->end && *s->p == ',' ) {
+            s->p++;
+            sax_skip_ws( s );
+            continue;
+        }
+        if( s->p < s->end && *s->p == '}' ) {
+            s->p++;
+            s->depth--;
+            return true;
+        }
+
+        return sax_error( s, "expected ',' or '}'" );
+    }
+}
+
+static bool
+sax_array( json_sax_t *s ) {
+    if( ++s->depth > JSON_SAX_MAX_DEPTH )
+        return sax_error( s, "maximum nesting depth exceeded" );
+
+    s->p++;
+    sax_skip_ws( s );
+
+    if( s->p < s->end && *s->p == ']' ) {
+        s->p++;
+        s->depth--;
+        return true;
+    }
+
+    for( ;; ) {
+        if( !sax_value( s, NULL, NULL ) )
+            return false;
+
+        sax_skip_ws( s );
+        if( s->p < s->end && *s->p == ',' ) {
+            s->p++;
+            continue;
+        }
+        if( s->p < s->end && *s->p == ']' ) {
+            s->p++;
+            s->depth--;
+            return true;
+        }
+
+        return sax_error( s, "expected ',' or ']'" );
+    }
+}
+
+/**
+ * Take the next element's tokens from elems, growing it as needed
+ */
+static json_token_t *
+sax_element( json_sax_t *s ) {
+    json_elems_t *elems = s->elems;
+
+    if( elems->count == elems->max ) {
+        elems->max *= 2;
+        elems->toks = repalloc( elems->toks, sizeof(json_token_t) * s->ncols * elems->max );
+    }
+
+    return memset( &elems->toks[elems->count++ * s->ncols], 0, sizeof(json_token_t) * s->ncols );
+}
+
+/**
+ * Parse one element of the unnested array against the element plan.  Its
+ * values go to the element's own tokens.
+ */
+static bool
+sax_unnest_value( json_sax_t *s, json_plan_node_t *element ) {
+    json_token_t    *saved = s->toks;
+    json_token_t    *toks = sax_element( s );
+    bool            ok;
+
+    s->toks = toks;
+    ok = sax_value( s, element->children ? element : NULL, element->attnum >= 0 ? &toks[element->attnum] : NULL );
+    s->toks = saved;
+
+    return ok;
+}
+
+/**
+ * Split the value at the unnest path into elements.  An array gives one
+ * element per member, null gives none and any other value is a single
+ * element.
+ */
+static bool
+sax_unnest( json_sax_t *s, json_plan_node_t *element ) {
+    if( *s->p == 'n' )
+        return sax_literal( s, "null", 4, JSON_TOK_NULL, NULL );
+
+    if( *s->p != '[' )
+        return sax_unnest_value( s, element );
+
+    if( ++s->depth > JSON_SAX_MAX_DEPTH )
+        return sax_error( s, "maximum nesting depth exceeded" );
+
+    s->p++;
+    sax_skip_ws( s );
+
+    if( s->p < s->end && *s->p == ']' ) {
+        s->p++;
+        s->depth--;
+        return true;
+    }
+
+    for( ;; ) {
+        if( !sax_unnest_value( s, element ) )
+            return false;
+
+        sax_skip_ws( s );
+        if( s->p < s->end && *s->p == ',' ) {
+            s->p++;
+            continue;
+        }
+        if( s->p < s->end && *s->p == ']' ) {
+            s->p++;
+            s->depth--;
+            return true;
+        }
+
+        return sax_error( s, "expected ',' or ']'" );
+    }
+}
+
+/**
+ * Parse one value.  node is the plan position of the value (NULL when no
+ * column lives at or below it) and tok receives the value's span when a
+ * column ends here.
+ */
+static bool
+sax_value( json_sax_t *s, json_plan_node_t *node, json_token_t *tok ) {
+    const char  *start;
+
+    sax_skip_ws( s );
+    if( s->p >= s->end )
+        return sax_error( s, "unexpected end of input" );
+
+    if( node && node->element && s->elems )
+        return sax_unnest( s, node->element );
+
+    start = s->p;
+
+    switch( *s->p ) {
+        case '{':
+            if( !sax_object( s, node ) )
+                return false;
+            if( tok ) {
+                tok->type = JSON_TOK_OBJECT;
+                tok->start = start;
+                tok->len = s->p - start;
+            }
+            return true;
+        case '[':
+            if( !sax_array( s ) )
+                return false;
+            if( tok ) {
+                tok->type = JSON_TOK_ARRAY;
+                tok->start = start;
+                tok->len = s->p - start;
+            }
+            return true;
+        case '"':
+        {
+            const char  *str;
+            int         len;
+            bool        escaped;
+
+            if( !sax_string( s, &str, &len, &escaped ) )
+                return false;
+            if( tok ) {
+                tok->type = JSON_TOK_STRING;
+                tok->start = str;
+                tok->len = len;
+                tok->escaped = escaped;
+            }
+            return true;
+        }
+        case 't':
+            return sax_literal( s, "true", 4, JSON_TOK_TRUE, tok );
+        case 'f':
+            return sax_literal( s, "false", 5, JSON_TOK_FALSE, tok );
+        case 'n':
+            return sax_literal( s, "null", 4, JSON_TOK_NULL, tok );
+        default:
+            return sax_number( s, tok );
+    }
+}
+
+static bool
+sax_extract( json_plan_t *plan, const char *buf, int len, json_token_t *toks, json_elems_t *elems, const char **errmsg ) {
+    json_sax_t  s;
+
+    memset( toks, 0, sizeof(json_token_t) * plan->ncols );
+
+    s.p = buf;
+    s.end = buf + len;
+    s.toks = toks;
+    s.depth = 0;
+    s.errmsg = NULL;
+    s.remaining = -1;
+    s.done = false;
+    s.elems = elems;
+    s.ncols = plan->ncols;
+    s.plan = plan;
+
+    sax_skip_ws( &s );
+    if( s.p >= s.end || *s.p != '{' ) {
+        *errmsg = "expected '{'";
+        return false;
+    }
+
+    if( !sax_object( &s, &plan->root ) ) {
+        *errmsg = s.errmsg;
+        return false;
+    }
+
+    sax_skip_ws( &s );
+    if( s.p != s.end ) {
+        *errmsg = "trailing data after object";
+        return false;
+    }
+
+    return true;
+}
+
+/**
+ * Extract the planned columns from the object in buf.  toks must hold one
+ * token per column; columns not present in the object are left as
+ * JSON_TOK_NONE.  Returns false and sets errmsg if buf is not a single
+ * valid JSON object.
+ */
+bool
+json_sax_extract( json_plan_t *plan, const char *buf, int len, json_token_t *toks, const char **errmsg ) {
+    return sax_extract( plan, buf, len, toks, NULL, errmsg );
+}
+
+/**
+ * Extract as json_sax_extract, also splitting the array at the plan's
+ * unnest path into elems, each with its own tokens for the columns
+ * planned below it
+ */
+bool
+json_sax_extract_unnest( json_plan_t *plan, const char *buf, int len, json_token_t *toks, json_elems_t *elems, const char **errmsg ) {
+    elems->count = 0;
+
+    return sax_extract( plan, buf, len, toks, elems, errmsg );
+}
+
+/**
+ * Like json_sax_extract, but stops walking the object as soon as every
+ * planned value has been found.  The rest of the object is not validated.
+ */
+bool
+json_sax_find( json_plan_t *plan, const char *buf, int len, json_token_t *toks ) {
+    json_sax_t  s;
+
+    memset( toks, 0, sizeof(json_token_t) * plan->ncols );
+
+    s.p = buf;
+    s.end = buf + len;
+    s.toks = toks;
+    s.depth = 0;
+    s.errmsg = NULL;
+    s.remaining = plan->ncols;
+    s.done = false;
+    s.elems = NULL;
+    s.ncols = plan->ncols;
+    s.plan = plan;
+
+    sax_skip_ws( &s );
+    if( s.p >= s.end || *s.p != '{' )
+        return false;
+
+    return sax_object( &s, &plan->root );
+}
+
+/**
+ * Split the array in buf into one token per member, for array columns.
+ * Each element of elems holds a single token.
+ */
+bool
+json_sax_elements( const char *buf, int len, json_elems_t *elems ) {
+    json_sax_t  s;
+
+    elems->count = 0;
+
+    s.p = buf;
+    s.end = buf + len;
+    s.toks = NULL;
+    s.depth = 1;
+    s.errmsg = NULL;
+    s.remaining = -1;
+    s.done = false;
+    s.elems = elems;
+    s.ncols = 1;
+    s.plan = NULL;
+
+    if( len < 2 || *s.p != '[' )
+        return false;
+
+    s.p++;
+    sax_skip_ws( &s );
+
+    if( s.p < s.end && *s.p == ']' )
+        return true;
+
+    for( ;; ) {
+        if( !sax_value( &s, NULL, sax_element( &s ) ) )
+            return false;
+
+        sax_skip_ws( &s );
+        if( s.p < s.end && *s.p == ',' ) {
+            s.p++;
+            continue;
+        }
+
+        return s.p < s.end && *s.p == ']';
+    }
+}
+
+static inline int
+sax_hex( char c ) {
+    if( c >= '0' && c <= '9' )
+        return c - '0';
+    if( c >= 'a' && c <= 'f' )
+        return c - 'a' + 10;
+    return c - 'A' + 10;
+}
+
+static inline int
+sax_utf8_encode( unsigned int cp, char *dst ) {
+    if( cp < 0x80 ) {
+        dst[0] = cp;
+        return 1;
+    }
+    if( cp < 0x800 ) {
+        dst[0] = 0xC0 | (cp >> 6);
+        dst[1] = 0x80 | (cp & 0x3F);
+        return 2;
+    }
+    if( cp < 0x10000 ) {
+        dst[0] = 0xE0 | (cp >> 12);
+        dst[1] = 0x80 | ((cp >> 6) & 0x3F);
+        dst[2] = 0x80 | (cp & 0x3F);
+        return 3;
+    }
+    dst[0] = 0xF0 | (cp >> 18);
+    dst[1] = 0x80 | ((cp >> 12) & 0x3F);
+    dst[2] = 0x80 | ((cp >> 6) & 0x3F);
+    dst[3] = 0x80 | (cp & 0x3F);
+    return 4;
+}
+
+/**
+ * Decode the escapes of a string token already validated by the extractor.
+ * dst must have room for len bytes; the decoded form is never longer.
+ * Returns the decoded length, or -1 for \u0000 and unpaired surrogates.
+ */
+int
+json_sax_unescape( const char *src, int len, char *dst ) {
+    const char  *end = src + len;
+    char        *out = dst;
+
+    while( src < end ) {
+        const char *bs = memchr( src, '\\', end - src );
+
+        if( !bs ) {
+            memcpy( out, src, end - src );
+            out += end - src;
+            break;
+        }
+
+        memcpy( out, src, bs - src );
+        out += bs - src;
+        src = bs + 1;
+
+        switch( *src++ ) {
+            case '"':   *out++ = '"'; break;
+            case '\\':  *out++ = '\\'; break;
+            case '/':   *out++ = '/'; break;
+            case 'b':   *out++ = '\b'; break;
+            case 'f':   *out++ = '\f'; break;
+            case 'n':   *out++ = '\n'; break;
+            case 'r':   *out++ = '\r'; break;
+            case 't':   *out++ = '\t'; break;
+            case 'u':
+            {
+                unsigned int cp = (sax_hex( src[0] ) << 12) | (sax_hex( src[1] ) << 8)
+                                | (sax_hex( src[2] ) << 4) | sax_hex( src[3] );
+                src += 4;
+
+                if( cp == 0 )
+                    return -1;
+
+                if( cp >= 0xD800 && cp <= 0xDBFF ) {
+                    unsigned int lo;
+
+                    if( end - src < 6 || src[0] != '\\' || src[1] != 'u' )
+                        return -1;
+
+                    lo = (sax_hex( src[2] ) << 12) | (sax_hex( src[3] ) << 8)
+                       | (sax_hex( src[4] ) << 4) | sax_hex( src[5] );
+                    if( lo < 0xDC00 || lo > 0xDFFF )
+                        return -1;
+
+                    cp = 0x10000 + ((cp - 0xD800) << 10) + (lo - 0xDC00);
+                    src += 6;
+                } else if( cp >= 0xDC00 && cp <= 0xDFFF ) {
+                    return -1;
+                }
+
+                out += sax_utf8_encode( cp, out );
+                break;
+            }
+            default:
+                return -1;
+        }
+    }
+
+    return out - dst;
+}
+
+/**
+ * Copy an object or array span validated by the extractor, dropping the
+ * whitespace between tokens.  dst must have room for len bytes.  Returns
+ * the minified length.
+ */
+int
+json_sax_minify( const char *src, int len, char *dst ) {
+    const char  *end = src + len;
+    char        *out = dst;
+
+    while( src < end ) {
+        char c = *src++;
+
+        if( c == ' ' || c == '\t' || c == '\n' || c == '\r' )
+            continue;
+
+        *out++ = c;
+
+        if( c == '"' ) {
+            while( src < end ) {
+                c = *src++;
+                *out++ = c;
+
+                if( c == '\\' && src < end )
+                    *out++ = *src++;
+                else if( c == '"' )
+                    break;
+            }
+        }
+    }
+
+    return out - dst;
+}
+
+/**
+ * Check that a span of input is valid UTF-8, as jansson does for every
+ * string it decodes.
+ */
+bool
+json_sax_valid_utf8( const char *str, int len ) {
+    const unsigned char *p = (const unsigned char *)str;
+    const unsigned char *end = p + len;
+
+    while( p < end ) {
+        unsigned int    c = *p;
+        int             n, i;
+        unsigned int    cp;
+
+        if( c < 0x80 ) {
+            p++;
+            continue;
+        }
+
+        if( c >= 0xC2 && c <= 0xDF ) {
+            n = 1; cp = c & 0x1F;
+        } else if( c >= 0xE0 && c <= 0xEF ) {
+            n = 2; cp = c & 0x0F;
+        } else if( c >= 0xF0 && c <= 0xF4 ) {
+            n = 3; cp = c & 0x07;
+        } else {
+            return false;
+        }
+
+        if( end - p <= n )
+            return false;
+
+        for( i=1; i <= n; i++ ) {
+            if( (p[i] & 0xC0) != 0x80 )
+                return false;
+            cp = (cp << 6) | (p[i] & 0x3F);
+        }
+
+        /* overlong forms, surrogates and values above U+10FFFF */
+        if( (n == 2 && cp < 0x800) || (n == 3 && cp < 0x10000)
+            || (cp >= 0xD800 && cp <= 0xDFFF) || cp > 0x10FFFF )
+            return false;
+
+        p += n + 1;
+    }
+
+    return true;
+}
@@ -0,0 +1,335 @@
+/*
+ * Copyright (c) 2013 Dillon Woods <dewoods@gmail.com>
+ *
+ * greenplum-json-formatter is free software; you can redistribute it and/or modify
+ * it under the terms of the MIT license. See LICENSE for details.
+ */
+
+#include <stdint.h>
+#include <stddef.h>
+#include <string.h>
+
+#include "json_scan.h"
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <emmintrin.h>
+#define JSON_SCAN_SSE2 1
+#if defined(__clang__) || (defined(__GNUC__) && (__GNUC__ > 4 || (__GNUC__ == 4 && __GNUC_MINOR__ >= 9)))
+#include <immintrin.h>
+#define JSON_SCAN_AVX2 1
+#endif
+#endif
+
+typedef int (*json_scan_fn)( json_scan_state_t *st, const char *buf, int len );
+
+static json_scan_fn json_scan_impl = NULL;
+static const char *json_scan_name = NULL;
+
+/**
+ * Prepare to scan a new input
+ */
+void
+json_scan_init( json_scan_state_t *st ) {
+    json_scan_reset( st );
+    st->array = JSON_SCAN_ARRAY_NONE;
+}
+
+/**
+ * Prepare to scan the next object of the same input
+ */
+void
+json_scan_reset( json_scan_state_t *st ) {
+    st->pos = 0;
+    st->depth = 0;
+    st->in_string = 0;
+    st->escape_at = -1;
+}
+
+/**
+ * Apply one structural byte to the scanner state.  Returns 1 when it
+ * closes the outermost object.
+ *
+ * A backslash inside a string escapes the byte that follows it, whatever
+ * it is, so runs of backslashes are handled by skipping the escaped
+ * position rather than by looking at the previous byte.
+ */
+static inline int
+scan_byte( json_scan_state_t *st, char c, int i ) {
+    if( st->in_string ) {
+        if( i == st->escape_at )
+            return 0;
+
+        if( c == '\\' )
+            st->escape_at = i + 1;
+        else if( c == '"' )
+            st->in_string = 0;
+
+        return 0;
+    }
+
+    if( c == '"' ) {
+        st->in_string = 1;
+    } else if( c == '{' ) {
+        st->depth++;
+    } else if( c == '}' ) {
+        if( --st->depth == 0 )
+            return 1;
+    }
+
+    return 0;
+}
+
+static int
+scan_scalar( json_scan_state_t *st, const char *buf, int len ) {
+    int i;
+
+    for( i = st->pos; i < len; i++ ) {
+        char c = buf[i];
+
+        if( c != '"' && c != '\\' && c != '{' && c != '}' )
+            continue;
+
+        if( scan_byte( st, c, i ) ) {
+            st->pos = i + 1;
+            return i + 1;
+        }
+    }
+
+    st->pos = len;
+    return -1;
+}
+
+#ifdef JSON_SCAN_SSE2
+static int
+scan_sse2( json_scan_state_t *st, const char *buf, int len ) {
+    const __m128i   quote = _mm_set1_epi8( '"' );
+    const __m128i   bslash = _mm_set1_epi8( '\\' );
+    const __m128i   lbrace = _mm_set1_epi8( '{' );
+    const __m128i   rbrace = _mm_set1_epi8( '}' );
+    int             i = st->pos;
+
+    for( ; i + 16 <= len; i += 16 ) {
+        __m128i     v = _mm_loadu_si128( (const __m128i *)(buf + i) );
+        uint32_t    mask;
+
+        mask = _mm_movemask_epi8( _mm_or_si128(
+            _mm_or_si128( _mm_cmpeq_epi8( v, quote ), _mm_cmpeq_epi8( v, bslash ) ),
+            _mm_or_si128( _mm_cmpeq_epi8( v, lbrace ), _mm_cmpeq_epi8( v, rbrace ) ) ) );
+
+        while( mask ) {
+            int j = i + __builtin_ctz( mask );
+
+            if( scan_byte( st, buf[j], j ) ) {
+                st->pos = j + 1;
+                return j + 1;
+            }
+            mask &= mask - 1;
+        }
+    }
+
+    st->pos = i;
+    return scan_scalar( st, buf, len );
+}
+#endif
+
+#ifdef JSON_SCAN_AVX2
+__attribute__((target("avx2")))
+static inline uint32_t
+scan_mask_avx2( const char *p ) {
+    const __m256i   quote = _mm256_set1_epi8( '"' );
+    const __m256i   bslash = _mm256_set1_epi8( '\\' );
+    const __m256i   lbrace = _mm256_set1_epi8( '{' );
+    const __m256i   rbrace = _mm256_set1_epi8( '}' );
+    __m256i         v = _mm256_loadu_si256( (const __m256i *)p );
+
+    return (uint32_t)_mm256_movemask_epi8( _mm256_or_si256(
+        _mm256_or_si256( _mm256_cmpeq_epi8( v, quote ), _mm256_cmpeq_epi8( v, bslash ) ),
+        _mm256_or_si256( _mm256_cmpeq_epi8( v, lbrace ), _mm256_cmpeq_epi8( v, rbrace ) ) ) );
+}
+
+/**
+ * 64 bytes per iteration: two 32 byte compares merged into one mask
+ */
+__attribute__((target("avx2")))
+static int
+scan_avx2( json_scan_state_t *st, const char *buf, int len ) {
+    int i = st->pos;
+
+    for( ; i + 64 <= len; i += 64 ) {
+        uint64_t mask = (uint64_t)scan_mask_avx2( buf + i )
+                      | ((uint64_t)scan_mask_avx2( buf + i + 32 ) << 32);
+
+        while( mask ) {
+            int j = i + __builtin_ctzll( mask );
+
+            if( scan_byte( st, buf[j], j ) ) {
+                st->pos = j + 1;
+                return j + 1;
+            }
+            mask &= mask - 1;
+        }
+    }
+
+    st->pos = i;
+    return scan_sse2( st, buf, len );
+}
+#endif
+
+static void
+json_scan_select( void ) {
+    json_scan_impl = scan_scalar;
+    json_scan_name = "scalar";
+
+#ifdef JSON_SCAN_SSE2
+    json_scan_impl = scan_sse2;
+    json_scan_name = "sse2";
+#endif
+
+#ifdef JSON_SCAN_AVX2
+    __builtin_cpu_init();
+    if( __builtin_cpu_supports( "avx2" ) ) {
+        json_scan_impl = scan_avx2;
+        json_scan_name = "avx2";
+    }
+#endif
+}
+
+/**
+ * Scan buf, which starts with the object's opening brace, from st->pos
+ * onwards.  Returns the length of the object once its closing brace is
+ * found, or -1 if buf ends first; st then holds everything needed to
+ * continue once more data is appended.
+ */
+int
+json_scan_object( json_scan_state_t *st, const char *buf, int len ) {
+    if( !json_scan_impl )
+        json_scan_select();
+
+    return json_scan_impl( st, buf, len );
+}
+
+/**
+ * Find the next object in buf, skipping the separators allowed between
+ * objects.  The brackets of a top level array of objects count as
+ * separators too, so such an array is read one element at a time rather
+ * than as a whole; only one such array is accepted, and only when it holds
+ * every object of the input.  *skip receives the number of separator bytes consumed
+ * before the object, which the caller should step over whatever the
+ * result.  On JSON_SCAN_FOUND the object is the *objlen bytes at
+ * buf + *skip.
+ *
+ * On JSON_SCAN_MORE the caller must keep the bytes from buf + *skip and
+ * call again with the same state once more data has been appended after
+ * them; only the new bytes are scanned.
+ */
+json_scan_result_t
+json_scan_next( json_scan_state_t *st, const char *buf, int len, int *skip, int *objlen ) {
+    int i = 0;
+    int n;
+
+    if( st->pos == 0 ) {
+        for( ; i < len; i++ ) {
+            char c = buf[i];
+
+            if( c == ' ' || c == '\n' || c == '\r' || c == '\t' )
+                continue;
+
+            /* nothing but whitespace may follow the array */
+            if( st->array == JSON_SCAN_ARRAY_CLOSED )
+                break;
+
+            if( c == ',' )
+                continue;
+
+            if( c == '[' && st->array == JSON_SCAN_ARRAY_NONE )
+                st->array = JSON_SCAN_ARRAY_OPEN;
+            else if( c == ']' && st->array == JSON_SCAN_ARRAY_OPEN )
+                st->array = JSON_SCAN_ARRAY_CLOSED;
+            else
+                break;
+        }
+
+        if( i == len ) {
+            *skip = i;
+            return JSON_SCAN_MORE;
+        }
+
+        if( buf[i] != '{' || st->array == JSON_SCAN_ARRAY_CLOSED ) {
+            *skip = i;
+            return JSON_SCAN_INVALID;
+        }
+
+        if( st->array == JSON_SCAN_ARRAY_NONE )
+            st->array = JSON_SCAN_ARRAY_STREAM;
+    }
+
+    *skip = i;
+
+    n = json_scan_object( st, buf + i, len - i );
+    if( n < 0 )
+        return JSON_SCAN_MORE;
+
+    *objlen = n;
+    json_scan_reset( st );
+
+    return JSON_SCAN_FOUND;
+}
+
+/**
+ * Find the next record of newline delimited JSON.  A record is one line;
+ * nothing in it is checked here, braces are not matched, and the newline
+ * is found with memchr.  A line that is not an object is left for the
+ * parser to reject as a bad row.  Blank lines are skipped.  *skip and
+ * *objlen are as for json_scan_next; the record excludes its newline and
+ * any trailing whitespace.
+ *
+ * When at_eof is set, buf holds the rest of the input and a final line
+ * with no newline is returned as a record.
+ */
+json_scan_result_t
+json_scan_line( json_scan_state_t *st, const char *buf, int len, int at_eof, int *skip, int *objlen ) {
+    const char  *nl;
+    int         i = 0;
+    int         n;
+
+    if( st->pos == 0 ) {
+        while( i < len && (buf[i] == ' ' || buf[i] == '\t' || buf[i] == '\n' || buf[i] == '\r') )
+            i++;
+
+        if( i == len ) {
+            *skip = i;
+            return JSON_SCAN_MORE;
+        }
+
+        st->pos = 1;
+    }
+
+    *skip = i;
+
+    /* bytes before pos have already been searched */
+    nl = memchr( buf + i + st->pos, '\n', len - i - st->pos );
+    if( nl ) {
+        n = nl - (buf + i);
+    } else if( at_eof ) {
+        n = len - i;
+    } else {
+        st->pos = len - i;
+        return JSON_SCAN_MORE;
+    }
+
+    while( n > 1 && (buf[i + n - 1] == ' ' || buf[i + n - 1] == '\t' || buf[i + n - 1] == '\r') )
+        n--;
+
+    *objlen = n;
+    json_scan_reset( st );
+
+    return JSON_SCAN_FOUND;
+}
+
+const char *
+json_scan_impl_name( void ) {
+    if( !json_scan_impl )
+        json_scan_select();
+
+    return json_scan_name;
+}
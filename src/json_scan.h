@@ -0,0 +1,57 @@
+/*
+ * Copyright (c) 2013 Dillon Woods <dewoods@gmail.com>
+ *
+ * greenplum-json-formatter is free software; you can redistribute it and/or modify
+ * it under the terms of the MIT license. See LICENSE for details.
+ */
+
+#ifndef JSON_SCAN_H
+#define JSON_SCAN_H
+
+/**
+ * Object boundary scanner
+ *
+ * Finds the closing brace of a JSON object by looking only at quotes,
+ * backslashes and braces.  Uses SSE2 or AVX2 when the CPU supports it.
+ * Newline delimited input can instead be split on newlines alone.
+ * Does not depend on PostgreSQL so it can be driven from standalone tests.
+ */
+typedef enum {
+    JSON_SCAN_FOUND = 0,    /* a complete object was found */
+    JSON_SCAN_MORE,         /* the buffer ends before the object does */
+    JSON_SCAN_INVALID       /* something other than an object was found */
+} json_scan_result_t;
+
+/**
+ * Where the input stands with respect to a top level array.  The input is
+ * either a stream of objects or a single array of them.
+ */
+typedef enum {
+    JSON_SCAN_ARRAY_NONE = 0,   /* nothing read yet */
+    JSON_SCAN_ARRAY_STREAM,     /* objects outside any array */
+    JSON_SCAN_ARRAY_OPEN,       /* inside the array */
+    JSON_SCAN_ARRAY_CLOSED      /* past its closing bracket */
+} json_scan_array_t;
+
+/**
+ * pos is zero between objects.  Once an opening brace has been found it
+ * stays non-zero until the matching closing brace, so a scan interrupted by
+ * the end of the buffer picks up where it stopped.  array describes the
+ * whole input and is kept across objects; json_scan_reset leaves it alone.
+ */
+typedef struct {
+    int                 pos;            /* next byte to scan, relative to object start */
+    int                 depth;          /* brace nesting depth */
+    int                 in_string;      /* inside a string literal */
+    int                 escape_at;      /* offset of the byte escaped by a backslash, -1 if none */
+    json_scan_array_t   array;
+} json_scan_state_t;
+
+extern void json_scan_init( json_scan_state_t *st );
+extern void json_scan_reset( json_scan_state_t *st );
+extern int json_scan_object( json_scan_state_t *st, const char *buf, int len );
+extern json_scan_result_t json_scan_next( json_scan_state_t *st, const char *buf, int len, int *skip, int *objlen );
+extern json_scan_result_t json_scan_line( json_scan_state_t *st, const char *buf, int len, int at_eof, int *skip, int *objlen );
+extern const char *json_scan_impl_name( void );
+
+#endif
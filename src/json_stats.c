@@ -0,0 +1,174 @@
+/*
+ * Copyright (c) 2013 Dillon Woods <dewoods@gmail.com>
+ *
+ * greenplum-json-formatter is free software; you can redistribute it and/or modify
+ * it under the terms of the MIT license. See LICENSE for details.
+ */
+
+#include "json_formatter.h"
+
+#include "fmgr.h"
+#include "funcapi.h"
+
+#include "access/xact.h"
+#include "utils/builtins.h"
+#include "utils/memutils.h"
+
+PG_FUNCTION_INFO_V1( json_formatter_stats );
+
+Datum json_formatter_stats( PG_FUNCTION_ARGS );
+
+/**
+ * Scan counters
+ *
+ * Each scan's counters are allocated in TopMemoryContext and linked into
+ * a list, most recent first, so they outlive the scan.  Reads are logged
+ * when the input ends; writes are not told when the last row has been
+ * written and are logged at the end of the transaction, along with any
+ * read that stopped early.
+ */
+#ifdef JSON_STATS
+
+#define JSON_STATS_KEEP 16
+
+static json_stats_t *json_stats_list = NULL;
+
+static const char *json_phase_names[JSON_PHASES] = {
+    "inflate", "scan", "filter", "parse", "lookup", "convert", "form", "write"
+};
+
+static void
+json_stats_xact( XactEvent event, void *arg ) {
+    json_stats_t *stats;
+
+    for( stats = json_stats_list; stats; stats = stats->next )
+        json_stats_report( stats );
+}
+
+void
+json_stats_install( void ) {
+    RegisterXactCallback( json_stats_xact, NULL );
+}
+
+json_stats_t *
+json_stats_create( bool write ) {
+    json_stats_t    *stats = MemoryContextAllocZero( TopMemoryContext, sizeof(json_stats_t) );
+    json_stats_t    *prev;
+    int             n;
+
+    stats->write = write;
+    stats->next = json_stats_list;
+    json_stats_list = stats;
+
+    /* drop the oldest */
+    for( prev = stats, n = 1; prev->next && n < JSON_STATS_KEEP; prev = prev->next, n++ )
+        ;
+    while( prev->next ) {
+        json_stats_t *old = prev->next;
+
+        json_stats_report( old );
+        prev->next = old->next;
+        pfree( old );
+    }
+
+    return stats;
+}
+
+/**
+ * Log a scan's counters once
+ */
+void
+json_stats_report( json_stats_t *stats ) {
+    StringInfoData  buf;
+    int             i;
+
+    if( stats->reported )
+        return;
+    stats->reported = true;
+
+    initStringInfo( &buf );
+    for( i=0; i < JSON_PHASES; i++ ) {
+        if( stats->ticks[i] > 0 )
+            appendStringInfo( &buf, " %s " UINT64_FORMAT, json_phase_names[i], stats->ticks[i] );
+    }
+
+    if( stats->write ) {
+        elog( LOG, "json_formatter write: " INT64_FORMAT " rows, " INT64_FORMAT " bytes, largest row " INT64_FORMAT " bytes; ticks:%s",
+              stats->rows, stats->bytes, stats->max_object, buf.data );
+    } else {
+        elog( LOG, "json_formatter read: " INT64_FORMAT " rows, " INT64_FORMAT " rejected, " INT64_FORMAT " objects, "
+              INT64_FORMAT " filtered, " INT64_FORMAT " bytes, largest object " INT64_FORMAT " bytes, "
+              INT64_FORMAT " calls, " INT64_FORMAT " need more data, " INT64_FORMAT " rescans, "
+              INT64_FORMAT " shape hits, " INT64_FORMAT " shape misses; ticks:%s",
+              stats->rows, stats->rejected, stats->objects, stats->filtered, stats->bytes, stats->max_object,
+              stats->calls, stats->need_more, stats->rescans, stats->shape_hits, stats->shape_misses, buf.data );
+    }
+
+    pfree( buf.data );
+}
+
+#endif
+
+/**
+ * The counters of this backend's last scans, most recent first.  Segments
+ * keep their own; query them with gp_dist_random('gp_id').
+ */
+Datum
+json_formatter_stats( PG_FUNCTION_ARGS ) {
+#ifdef JSON_STATS
+    FuncCallContext *funcctx;
+    json_stats_t    *stats;
+    Datum           values[12 + JSON_PHASES];
+    bool            nulls[12 + JSON_PHASES];
+    HeapTuple       tuple;
+    int             i;
+
+    if( SRF_IS_FIRSTCALL() ) {
+        MemoryContext   omc;
+        TupleDesc       tupdesc;
+
+        funcctx = SRF_FIRSTCALL_INIT();
+        omc = MemoryContextSwitchTo( funcctx->multi_call_memory_ctx );
+
+        if( get_call_result_type( fcinfo, NULL, &tupdesc ) != TYPEFUNC_COMPOSITE )
+            elog( ERROR, "json_formatter_stats: return type must be a row type" );
+        if( tupdesc->natts != 12 + JSON_PHASES )
+            elog( ERROR, "json_formatter_stats: expected %d columns, reinstall sql/install.sql", 12 + JSON_PHASES );
+
+        funcctx->tuple_desc = BlessTupleDesc( tupdesc );
+        funcctx->user_fctx = json_stats_list;
+        MemoryContextSwitchTo( omc );
+    }
+
+    funcctx = SRF_PERCALL_SETUP();
+    stats = funcctx->user_fctx;
+    if( !stats )
+        SRF_RETURN_DONE( funcctx );
+    funcctx->user_fctx = stats->next;
+
+    MemSet( nulls, false, sizeof(nulls) );
+    values[0] = DirectFunctionCall1( textin, CStringGetDatum( stats->write ? "write" : "read" ) );
+    values[1] = Int64GetDatum( stats->calls );
+    values[2] = Int64GetDatum( stats->rows );
+    values[3] = Int64GetDatum( stats->rejected );
+    values[4] = Int64GetDatum( stats->objects );
+    values[5] = Int64GetDatum( stats->filtered );
+    values[6] = Int64GetDatum( stats->bytes );
+    values[7] = Int64GetDatum( stats->max_object );
+    values[8] = Int64GetDatum( stats->need_more );
+    values[9] = Int64GetDatum( stats->rescans );
+    values[10] = Int64GetDatum( stats->shape_hits );
+    values[11] = Int64GetDatum( stats->shape_misses );
+    for( i=0; i < JSON_PHASES; i++ )
+        values[12 + i] = Int64GetDatum( (int64)stats->ticks[i] );
+
+    tuple = heap_form_tuple( funcctx->tuple_desc, values, nulls );
+    SRF_RETURN_NEXT( funcctx, HeapTupleGetDatum( tuple ) );
+#else
+    ereport( ERROR, (
+        errcode( ERRCODE_FEATURE_NOT_SUPPORTED ),
+        errmsg( "json_formatter was built without statistics, rebuild it with make STATS=yes" )
+    ) );
+    PG_RETURN_NULL();
+#endif
+}
@@ -0,0 +1,232 @@
+/*
+ * Copyright (c) 2013 Dillon Woods <dewoods@gmail.com>
+ *
+ * greenplum-json-formatter is free software; you can redistribute it and/or modify
+ * it under the terms of the MIT license. See LICENSE for details.
+ */
+
+#include <signal.h>
+#include <string.h>
+
+#include "json_formatter.h"
+
+#include "access/xact.h"
+#include "utils/memutils.h"
+
+/**
+ * Worker thread pool
+ *
+ * The backend queues up to JSON_READ_BATCH_ROWS jobs per batch and waits
+ * for each in turn; threads take jobs in queue order.  Between batches the
+ * threads sleep on the queue.  Pools still running at the end of the
+ * transaction, because their scan stopped before the end of its input or
+ * raised an error, are stopped then.
+ */
+
+static json_workers_t *json_workers_list = NULL;
+
+static void
+json_workers_run( json_workers_t *w, json_plan_t *plan, json_job_t *job ) {
+    char    *text = job->text;
+    char    *end = job->text + job->textsize;
+    int     i;
+
+    job->ok = json_sax_extract( plan, job->buf, job->len, job->toks, &job->errmsg );
+    if( !job->ok )
+        return;
+
+    /**
+     * A column nested in another column's object can leave too little
+     * room, and is then left to the converter
+     */
+    for( i=0; i < w->ncols; i++ ) {
+        if( job->toks[i].len <= end - text )
+            text += json_convert_prepare( &w->columns[i], &job->toks[i], text );
+    }
+}
+
+static void *
+json_workers_main( void *arg ) {
+    json_workers_t  *w = arg;
+    json_plan_t     *plan;
+    int             id;
+
+    pthread_mutex_lock( &w->lock );
+    id = w->started++;
+    plan = w->plans[id];
+
+    for( ;; ) {
+        json_job_t *job;
+
+        while( !w->stop && w->taken == w->njobs )
+            pthread_cond_wait( &w->queued, &w->lock );
+        if( w->stop )
+            break;
+
+        job = &w->jobs[w->taken++];
+        w->running++;
+        pthread_mutex_unlock( &w->lock );
+
+        json_workers_run( w, plan, job );
+
+        pthread_mutex_lock( &w->lock );
+        job->done = true;
+        w->running--;
+        pthread_cond_broadcast( &w->finished );
+    }
+
+    pthread_mutex_unlock( &w->lock );
+    return NULL;
+}
+
+static void
+json_workers_xact( XactEvent event, void *arg ) {
+    while( json_workers_list )
+        json_workers_stop( json_workers_list );
+}
+
+void
+json_workers_install( void ) {
+    RegisterXactCallback( json_workers_xact, NULL );
+}
+
+/**
+ * Start nthreads threads extracting the columns of plan.  Jobs, plan
+ * copies and columns are allocated in the current memory context and
+ * must outlive every batch.
+ */
+json_workers_t *
+json_workers_start( json_plan_t *plan, json_column_t *columns, int ncols, int nthreads ) {
+    json_workers_t  *w = MemoryContextAllocZero( TopMemoryContext, sizeof(json_workers_t) );
+    sigset_t        all, old;
+    int             i, ret = 0;
+
+    w->columns = columns;
+    w->ncols = ncols;
+    w->threads = MemoryContextAlloc( TopMemoryContext, sizeof(pthread_t) * nthreads );
+    w->plans = palloc( sizeof(json_plan_t *) * nthreads );
+    w->jobs = palloc( sizeof(json_job_t) * JSON_READ_BATCH_ROWS );
+
+    for( i=0; i < nthreads; i++ )
+        w->plans[i] = json_plan_copy( plan );
+
+    for( i=0; i < JSON_READ_BATCH_ROWS; i++ ) {
+        w->jobs[i].toks = palloc( sizeof(json_token_t) * ncols );
+        w->jobs[i].textsize = 1024;
+        w->jobs[i].text = palloc( w->jobs[i].textsize );
+    }
+
+    pthread_mutex_init( &w->lock, NULL );
+    pthread_cond_init( &w->queued, NULL );
+    pthread_cond_init( &w->finished, NULL );
+
+    w->next = json_workers_list;
+    json_workers_list = w;
+
+    /* signals are for the backend; threads start with every one blocked */
+    sigfillset( &all );
+    pthread_sigmask( SIG_SETMASK, &all, &old );
+    for( i=0; i < nthreads; i++ ) {
+        ret = pthread_create( &w->threads[i], NULL, json_workers_main, w );
+        if( ret != 0 )
+            break;
+        w->nthreads++;
+    }
+    pthread_sigmask( SIG_SETMASK, &old, NULL );
+
+    if( ret != 0 ) {
+        json_workers_stop( w );
+        ereport( ERROR, (
+            errcode( ERRCODE_INSUFFICIENT_RESOURCES ),
+            errmsg( "Could not start json_formatter worker thread: %s", strerror( ret ) )
+        ) );
+    }
+
+    return w;
+}
+
+/**
+ * Queue the object in buf for the threads
+ */
+void
+json_workers_add( json_workers_t *w, const char *buf, int len ) {
+    json_job_t *job = &w->jobs[w->njobs];
+
+    /* text values shrink when unescaped or minified, never grow */
+    if( job->textsize < len ) {
+        job->textsize = Max( len, job->textsize * 2 );
+        job->text = repalloc( job->text, job->textsize );
+    }
+
+    job->buf = buf;
+    job->len = len;
+    job->ok = false;
+    job->errmsg = NULL;
+
+    pthread_mutex_lock( &w->lock );
+    job->done = false;
+    w->njobs++;
+    pthread_cond_signal( &w->queued );
+    pthread_mutex_unlock( &w->lock );
+}
+
+/**
+ * Wait for job i of the batch to be done
+ */
+json_job_t *
+json_workers_wait( json_workers_t *w, int i ) {
+    json_job_t *job = &w->jobs[i];
+
+    pthread_mutex_lock( &w->lock );
+    while( !job->done )
+        pthread_cond_wait( &w->finished, &w->lock );
+    pthread_mutex_unlock( &w->lock );
+
+    return job;
+}
+
+/**
+ * End the batch: drop the jobs no thread has taken and wait for the
+ * others, so that no thread reads the data buffer once this returns
+ */
+void
+json_workers_finish( json_workers_t *w ) {
+    pthread_mutex_lock( &w->lock );
+    w->njobs = w->taken;
+    while( w->running > 0 )
+        pthread_cond_wait( &w->finished, &w->lock );
+    w->njobs = 0;
+    w->taken = 0;
+    pthread_mutex_unlock( &w->lock );
+}
+
+/**
+ * Stop and join the threads, waiting for any job they are running
+ */
+void
+json_workers_stop( json_workers_t *w ) {
+    json_workers_t  **prev;
+    int             i;
+
+    pthread_mutex_lock( &w->lock );
+    w->stop = true;
+    pthread_cond_broadcast( &w->queued );
+    pthread_mutex_unlock( &w->lock );
+
+    for( i=0; i < w->nthreads; i++ )
+        pthread_join( w->threads[i], NULL );
+
+    pthread_cond_destroy( &w->finished );
+    pthread_cond_destroy( &w->queued );
+    pthread_mutex_destroy( &w->lock );
+
+    for( prev = &json_workers_list; *prev; prev = &(*prev)->next ) {
+        if( *prev == w ) {
+            *prev = w->next;
+            break;
+        }
+    }
+
+    pfree( w->threads );
+    pfree( w );
+}
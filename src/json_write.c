@@ -0,0 +1,693 @@
+/*
+ * Copyright (c) 2013 Dillon Woods <dewoods@gmail.com>
+ *
+ * greenplum-json-formatter is free software; you can redistribute it and/or modify
+ * it under the terms of the MIT license. See LICENSE for details.
+ */
+
+#include <float.h>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "json_formatter.h"
+
+#include "catalog/pg_type.h"
+#include "mb/pg_wchar.h"
+#include "utils/array.h"
+#include "utils/builtins.h"
+#include "utils/date.h"
+#include "utils/datetime.h"
+#include "utils/lsyscache.h"
+#include "utils/timestamp.h"
+
+/**
+ * Streaming writer
+ *
+ * The template tree built from the column names is walked once at setup
+ * and turned into a program: a run of literal text (braces, separators
+ * and escaped keys) followed by the column whose value comes next.  Rows
+ * are written by replaying the program into the output buffer, so no
+ * tree is touched per row.  Keys keep the order json_dumps gives the
+ * template, so the output is the same as dumping the tree.
+ */
+
+/**
+ * Escape a string the way json_dumps does with no flags
+ */
+void
+json_write_escaped( StringInfo out, const char *str, int len ) {
+    const char  *end = str + len;
+    const char  *run = str;
+
+    appendStringInfoChar( out, '"' );
+
+    for( ; str < end; str++ ) {
+        unsigned char   c = (unsigned char)*str;
+        const char      *esc;
+        char            seq[8];
+
+        if( c >= 0x20 && c != '"' && c != '\\' )
+            continue;
+
+        if( str > run )
+            appendBinaryStringInfo( out, run, str - run );
+        run = str + 1;
+
+        switch( c ) {
+            case '"':   esc = "\\\""; break;
+            case '\\':  esc = "\\\\"; break;
+            case '\b':  esc = "\\b"; break;
+            case '\f':  esc = "\\f"; break;
+            case '\n':  esc = "\\n"; break;
+            case '\r':  esc = "\\r"; break;
+            case '\t':  esc = "\\t"; break;
+            default:
+                snprintf( seq, sizeof(seq), "\\u%04X", c );
+                esc = seq;
+                break;
+        }
+        appendStringInfoString( out, esc );
+    }
+
+    if( str > run )
+        appendBinaryStringInfo( out, run, str - run );
+
+    appendStringInfoChar( out, '"' );
+}
+
+/**
+ * Column writers, chosen from the column type when the program is
+ * compiled
+ */
+static void
+json_write_int64( StringInfo out, int64 value ) {
+    char    buf[24];
+    char    *p = buf + sizeof(buf);
+    uint64  u = value < 0 ? (uint64)0 - (uint64)value : (uint64)value;
+
+    do {
+        *--p = '0' + u % 10;
+        u /= 10;
+    } while( u );
+
+    if( value < 0 )
+        *--p = '-';
+
+    appendBinaryStringInfo( out, p, buf + sizeof(buf) - p );
+}
+
+static void
+emit_int2( json_write_column_t *col, StringInfo out, Datum value ) {
+    json_write_int64( out, DatumGetInt16( value ) );
+}
+
+static void
+emit_int4( json_write_column_t *col, StringInfo out, Datum value ) {
+    json_write_int64( out, DatumGetInt32( value ) );
+}
+
+static void
+emit_int8( json_write_column_t *col, StringInfo out, Datum value ) {
+    json_write_int64( out, DatumGetInt64( value ) );
+}
+
+/**
+ * Reals are written with the fewest digits that read back as the same
+ * value, keeping a ".0" on integral values so they stay reals
+ */
+static void
+json_write_real( json_write_column_t *col, StringInfo out, char *buf, int len ) {
+    appendBinaryStringInfo( out, buf, len );
+    if( !strpbrk( buf, ".eE" ) )
+        appendBinaryStringInfo( out, ".0", 2 );
+}
+
+static void
+emit_float4( json_write_column_t *col, StringInfo out, Datum value ) {
+    float4  f = DatumGetFloat4( value );
+    char    buf[32];
+    int     len = 0;
+    int     digits;
+
+    if( isinf( f ) || isnan( f ) )
+        elog( ERROR, "Unable to set float value for column '%s'", col->name );
+
+    for( digits = FLT_DIG; digits <= FLT_DIG + 3; digits++ ) {
+        len = snprintf( buf, sizeof(buf), "%.*g", digits, f );
+        if( strtof( buf, NULL ) == f )
+            break;
+    }
+
+    json_write_real( col, out, buf, len );
+}
+
+static void
+emit_float8( json_write_column_t *col, StringInfo out, Datum value ) {
+    float8  f = DatumGetFloat8( value );
+    char    buf[32];
+    int     len = 0;
+    int     digits;
+
+    if( isinf( f ) || isnan( f ) )
+        elog( ERROR, "Unable to set float value for column '%s'", col->name );
+
+    for( digits = DBL_DIG; digits <= DBL_DIG + 2; digits++ ) {
+        len = snprintf( buf, sizeof(buf), "%.*g", digits, f );
+        if( strtod( buf, NULL ) == f )
+            break;
+    }
+
+    json_write_real( col, out, buf, len );
+}
+
+/**
+ * numeric_out already gives a valid JSON number for everything but NaN
+ */
+static void
+emit_numeric( json_write_column_t *col, StringInfo out, Datum value ) {
+    char *str = DatumGetCString( DirectFunctionCall1( numeric_out, value ) );
+
+    if( strcmp( str, "NaN" ) == 0 )
+        elog( ERROR, "Unable to set numeric value for column '%s'", col->name );
+
+    appendStringInfoString( out, str );
+}
+
+static void
+emit_bool( json_write_column_t *col, StringInfo out, Datum value ) {
+    if( DatumGetBool( value ) )
+        appendBinaryStringInfo( out, "true", 4 );
+    else
+        appendBinaryStringInfo( out, "false", 5 );
+}
+
+/**
+ * Text is escaped straight from the datum.  The server already guarantees
+ * valid UTF-8 in a UTF-8 database; any other encoding is checked as
+ * jansson did.
+ */
+static void
+emit_text( json_write_column_t *col, StringInfo out, Datum value ) {
+    text    *txt = DatumGetTextPP( value );
+    char    *str = VARDATA_ANY( txt );
+    int     len = VARSIZE_ANY_EXHDR( txt );
+
+    if( col->validate && !json_sax_valid_utf8( str, len ) )
+        elog( ERROR, "Unable to set string value for column '%s'", col->name );
+
+    json_write_escaped( out, str, len );
+}
+
+/**
+ * Values without an ISO 8601 form of their own (infinity, BC dates) are
+ * written as the type's output function gives them
+ */
+static void
+emit_output( json_write_column_t *col, StringInfo out, Datum value ) {
+    char *str = DatumGetCString( DirectFunctionCall1( col->outfunc, value ) );
+
+    json_write_escaped( out, str, strlen( str ) );
+}
+
+static void
+emit_date( json_write_column_t *col, StringInfo out, Datum value ) {
+    DateADT date = DatumGetDateADT( value );
+    int     year, month, day;
+
+    if( DATE_NOT_FINITE( date ) ) {
+        emit_output( col, out, value );
+        return;
+    }
+
+    j2date( date + POSTGRES_EPOCH_JDATE, &year, &month, &day );
+    if( year <= 0 ) {
+        emit_output( col, out, value );
+        return;
+    }
+
+    appendStringInfo( out, "\"%04d-%02d-%02d\"", year, month, day );
+}
+
+/**
+ * YYYY-MM-DDTHH:MM:SS[.ffffff], with the session's UTC offset for
+ * timestamptz
+ */
+static void
+json_write_timestamp( json_write_column_t *col, StringInfo out, Datum value, bool with_tz ) {
+#ifdef JSON_FSEC_SCALE
+    Timestamp       ts = DatumGetTimestamp( value );
+    struct pg_tm    tm;
+    fsec_t          fsec;
+    int             tz = 0;
+
+    if( TIMESTAMP_NOT_FINITE( ts )
+        || timestamp2tm( ts, with_tz ? &tz : NULL, &tm, &fsec, NULL, NULL ) != 0
+        || tm.tm_year <= 0 ) {
+        emit_output( col, out, value );
+        return;
+    }
+
+    appendStringInfo( out, "\"%04d-%02d-%02dT%02d:%02d:%02d",
+                      tm.tm_year, tm.tm_mon, tm.tm_mday, tm.tm_hour, tm.tm_min, tm.tm_sec );
+
+    if( fsec != 0 ) {
+        char    frac[8];
+        int     len = snprintf( frac, sizeof(frac), ".%06d", (int)fsec );
+
+        while( frac[len - 1] == '0' )
+            len--;
+        appendBinaryStringInfo( out, frac, len );
+    }
+
+    /* tz counts seconds west of UTC */
+    if( with_tz ) {
+        int offset = tz < 0 ? -tz : tz;
+
+        appendStringInfo( out, "%c%02d:%02d", tz <= 0 ? '+' : '-', offset / 3600, (offset / 60) % 60 );
+    }
+
+    appendStringInfoChar( out, '"' );
+#else
+    emit_output( col, out, value );
+#endif
+}
+
+static void
+emit_timestamp( json_write_column_t *col, StringInfo out, Datum value ) {
+    json_write_timestamp( col, out, value, false );
+}
+
+static void
+emit_timestamptz( json_write_column_t *col, StringInfo out, Datum value ) {
+    json_write_timestamp( col, out, value, true );
+}
+
+/**
+ * Write one dimension of an array, taking its elements from values in
+ * order.  Elements are separated as json_dumps separates array members.
+ */
+static void
+json_write_array( json_write_column_t *elem, StringInfo out, int ndim, int *dims, Datum *values, bool *nulls, int *next ) {
+    int i;
+
+    appendStringInfoChar( out, '[' );
+
+    for( i=0; i < dims[0]; i++ ) {
+        if( i > 0 )
+            appendBinaryStringInfo( out, ", ", 2 );
+
+        if( ndim > 1 ) {
+            json_write_array( elem, out, ndim - 1, dims + 1, values, nulls, next );
+        } else {
+            if( nulls[*next] )
+                appendBinaryStringInfo( out, "null", 4 );
+            else
+                elem->emit( elem, out, values[*next] );
+            (*next)++;
+        }
+    }
+
+    appendStringInfoChar( out, ']' );
+}
+
+/**
+ * Arrays are written as JSON arrays, nested once per dimension, with each
+ * element written by the element type's writer
+ */
+static void
+emit_array( json_write_column_t *col, StringInfo out, Datum value ) {
+    ArrayType   *array = DatumGetArrayTypeP( value );
+    Datum       *values;
+    bool        *nulls;
+    int         nelems;
+    int         next = 0;
+
+    if( ARR_NDIM( array ) == 0 ) {
+        appendBinaryStringInfo( out, "[]", 2 );
+        return;
+    }
+
+    deconstruct_array( array, col->elmtype, col->elmlen, col->elmbyval, col->elmalign,
+                       &values, &nulls, &nelems );
+
+    json_write_array( col->element, out, ARR_NDIM( array ), ARR_DIMS( array ), values, nulls, &next );
+
+    pfree( values );
+    pfree( nulls );
+}
+
+static bool json_write_type( json_write_column_t *col, Oid typid );
+
+static bool
+json_write_array_setup( json_write_column_t *col, Oid elmtype ) {
+    json_write_column_t *elem = palloc0( sizeof(json_write_column_t) );
+
+    elem->attnum = col->attnum;
+    elem->name = col->name;
+
+    if( !json_write_type( elem, elmtype ) ) {
+        pfree( elem );
+        return false;
+    }
+
+    get_typlenbyvalalign( elmtype, &col->elmlen, &col->elmbyval, &col->elmalign );
+
+    col->element = elem;
+    col->elmtype = elmtype;
+    col->emit = emit_array;
+
+    return true;
+}
+
+/**
+ * Choose the writer for a column's type, and the value its nulls are
+ * written as by default
+ */
+static bool
+json_write_type( json_write_column_t *col, Oid typid ) {
+    Oid elmtype;
+
+    col->typid = typid;
+    col->null = "null";
+    col->validate = false;
+    col->outfunc = NULL;
+    col->element = NULL;
+
+    switch( typid ) {
+        case INT2OID:
+            col->emit = emit_int2;
+            col->null = "0";
+            break;
+        case INT4OID:
+            col->emit = emit_int4;
+            col->null = "0";
+            break;
+        case INT8OID:
+            col->emit = emit_int8;
+            col->null = "0";
+            break;
+        case FLOAT4OID:
+            col->emit = emit_float4;
+            col->null = "0.0";
+            break;
+        case FLOAT8OID:
+            col->emit = emit_float8;
+            col->null = "0.0";
+            break;
+        case TEXTOID:
+        case VARCHAROID:
+            col->emit = emit_text;
+            col->null = "\"\"";
+            col->validate = GetDatabaseEncoding() != PG_UTF8;
+            break;
+        case NUMERICOID:
+            col->emit = emit_numeric;
+            break;
+        case BOOLOID:
+            col->emit = emit_bool;
+            break;
+        case DATEOID:
+            col->emit = emit_date;
+            col->outfunc = date_out;
+            break;
+        case TIMESTAMPOID:
+            col->emit = emit_timestamp;
+            col->outfunc = timestamp_out;
+            break;
+        case TIMESTAMPTZOID:
+            col->emit = emit_timestamptz;
+            col->outfunc = timestamptz_out;
+            break;
+        default:
+            elmtype = get_element_type( typid );
+            return elmtype != InvalidOid && json_write_array_setup( col, elmtype );
+    }
+
+    return true;
+}
+
+/**
+ * Choose a writer for every column.  Unless null_mode says otherwise,
+ * nulls of the types the writer has always supported keep their zero
+ * values and the rest are written as null.
+ */
+void
+json_write_columns( json_write_plan_t *plan, TupleDesc tupdesc, json_null_mode_t null_mode ) {
+    int i;
+
+    plan->columns = palloc0( sizeof(json_write_column_t) * tupdesc->natts );
+
+    for( i=0; i < tupdesc->natts; i++ ) {
+        json_write_column_t *col = &plan->columns[i];
+
+        col->attnum = i;
+        col->name = tupdesc->attrs[i]->attname.data;
+
+        if( !json_write_type( col, tupdesc->attrs[i]->atttypid ) )
+            elog( ERROR, "Type of column '%s' not supported", col->name );
+
+        if( null_mode != JSON_NULL_DEFAULT )
+            col->null = "null";
+        col->nulllen = strlen( col->null );
+    }
+}
+
+static void
+json_write_op( json_write_plan_t *plan, StringInfo pending, int attnum ) {
+    json_write_op_t *op;
+
+    if( plan->nops == plan->maxops ) {
+        plan->maxops *= 2;
+        plan->ops = repalloc( plan->ops, sizeof(json_write_op_t) * plan->maxops );
+    }
+
+    op = &plan->ops[plan->nops++];
+    op->litoff = plan->lits.len;
+    op->litlen = pending->len;
+    op->attnum = attnum;
+
+    appendBinaryStringInfo( &plan->lits, pending->data, pending->len );
+    resetStringInfo( pending );
+}
+
+static void
+json_write_walk( json_write_plan_t *plan, json_t *obj, json_t **j_vals, StringInfo pending ) {
+    void    *iter;
+    bool    first = true;
+
+    appendStringInfoChar( pending, '{' );
+
+    for( iter = json_object_iter( obj ); iter; iter = json_object_iter_next( obj, iter ) ) {
+        const char  *key = json_object_iter_key( iter );
+        json_t      *val = json_object_iter_value( iter );
+        int         i;
+
+        if( !first )
+            appendStringInfoString( pending, ", " );
+        first = false;
+
+        json_write_escaped( pending, key, strlen( key ) );
+        appendStringInfoString( pending, ": " );
+
+        for( i=0; i < plan->ncols; i++ ) {
+            if( j_vals[i] == val )
+                break;
+        }
+
+        if( i < plan->ncols )
+            json_write_op( plan, pending, i );
+        else
+            json_write_walk( plan, val, j_vals, pending );
+    }
+
+    appendStringInfoChar( pending, '}' );
+}
+
+/**
+ * With null_mode 'omit' the template is compiled into steps instead, so
+ * that separators can be decided per row.  Keys are kept escaped in lits.
+ */
+static void
+json_write_step( json_write_plan_t *plan, json_write_step_kind_t kind, const char *key, int attnum ) {
+    json_write_step_t *step;
+
+    if( plan->nsteps == plan->maxsteps ) {
+        plan->maxsteps *= 2;
+        plan->steps = repalloc( plan->steps, sizeof(json_write_step_t) * plan->maxsteps );
+    }
+
+    step = &plan->steps[plan->nsteps++];
+    step->kind = kind;
+    step->keyoff = plan->lits.len;
+    step->attnum = attnum;
+
+    if( key ) {
+        json_write_escaped( &plan->lits, key, strlen( key ) );
+        appendStringInfoString( &plan->lits, ": " );
+    }
+    step->keylen = plan->lits.len - step->keyoff;
+}
+
+static void
+json_write_walk_steps( json_write_plan_t *plan, json_t *obj, const char *key, json_t **j_vals, int depth ) {
+    void    *iter;
+
+    if( depth > plan->depth )
+        plan->depth = depth;
+
+    json_write_step( plan, JSON_WRITE_OPEN, key, -1 );
+
+    for( iter = json_object_iter( obj ); iter; iter = json_object_iter_next( obj, iter ) ) {
+        const char  *key = json_object_iter_key( iter );
+        json_t      *val = json_object_iter_value( iter );
+        int         i;
+
+        for( i=0; i < plan->ncols; i++ ) {
+            if( j_vals[i] == val )
+                break;
+        }
+
+        if( i < plan->ncols )
+            json_write_step( plan, JSON_WRITE_VALUE, key, i );
+        else
+            json_write_walk_steps( plan, val, key, j_vals, depth + 1 );
+    }
+
+    json_write_step( plan, JSON_WRITE_CLOSE, NULL, -1 );
+}
+
+/**
+ * Compile the template tree, whose leaf for column i is j_vals[i]
+ */
+json_write_plan_t *
+json_write_compile( TupleDesc tupdesc, json_t *j_root, json_t **j_vals, json_null_mode_t null_mode ) {
+    json_write_plan_t   *plan = palloc( sizeof(json_write_plan_t) );
+    StringInfoData      pending;
+
+    plan->ncols = tupdesc->natts;
+    plan->null_mode = null_mode;
+    json_write_columns( plan, tupdesc, null_mode );
+    plan->nops = 0;
+    plan->maxops = plan->ncols + 1;
+    plan->ops = palloc( sizeof(json_write_op_t) * plan->maxops );
+    plan->nsteps = 0;
+    plan->maxsteps = 0;
+    plan->steps = NULL;
+    plan->depth = 0;
+    plan->frames = NULL;
+    initStringInfo( &plan->lits );
+
+    if( null_mode == JSON_NULL_OMIT ) {
+        plan->maxsteps = 2 * plan->ncols + 2;
+        plan->steps = palloc( sizeof(json_write_step_t) * plan->maxsteps );
+        json_write_walk_steps( plan, j_root, NULL, j_vals, 0 );
+        plan->frames = palloc( sizeof(json_write_frame_t) * (plan->depth + 1) );
+        return plan;
+    }
+
+    initStringInfo( &pending );
+
+    json_write_walk( plan, j_root, j_vals, &pending );
+    appendStringInfoChar( &pending, '\n' );
+    json_write_op( plan, &pending, -1 );
+
+    pfree( pending.data );
+
+    return plan;
+}
+
+/**
+ * Write a row leaving out null columns.  A nested object left with no
+ * members is taken back out of the buffer, so it is omitted as well.
+ */
+static void
+json_write_row_omit( json_write_plan_t *plan, Datum *values, bool *nulls, StringInfo out ) {
+    json_write_frame_t  *frame = NULL;
+    int                 depth = 0;
+    int                 i;
+
+    for( i=0; i < plan->nsteps; i++ ) {
+        json_write_step_t   *step = &plan->steps[i];
+        json_write_column_t *col;
+
+        switch( step->kind ) {
+            case JSON_WRITE_OPEN:
+            {
+                json_write_frame_t *parent = frame;
+
+                frame = &plan->frames[depth++];
+                frame->start = out->len;
+                frame->parent_empty = parent ? parent->empty : true;
+                frame->empty = true;
+
+                if( parent ) {
+                    if( !parent->empty )
+                        appendBinaryStringInfo( out, ", ", 2 );
+                    parent->empty = false;
+                }
+                appendBinaryStringInfo( out, plan->lits.data + step->keyoff, step->keylen );
+                appendStringInfoChar( out, '{' );
+                break;
+            }
+            case JSON_WRITE_CLOSE:
+            {
+                depth--;
+                if( frame->empty && depth > 0 ) {
+                    out->len = frame->start;
+                    out->data[out->len] = '\0';
+                    plan->frames[depth - 1].empty = frame->parent_empty;
+                } else {
+                    appendStringInfoChar( out, '}' );
+                }
+                frame = depth > 0 ? &plan->frames[depth - 1] : NULL;
+                break;
+            }
+            case JSON_WRITE_VALUE:
+            {
+                if( nulls[step->attnum] )
+                    break;
+
+                if( !frame->empty )
+                    appendBinaryStringInfo( out, ", ", 2 );
+                frame->empty = false;
+
+                col = &plan->columns[step->attnum];
+                appendBinaryStringInfo( out, plan->lits.data + step->keyoff, step->keylen );
+                col->emit( col, out, values[step->attnum] );
+                break;
+            }
+        }
+    }
+
+    appendStringInfoChar( out, '\n' );
+}
+
+/**
+ * Append one row as a line of JSON
+ */
+void
+json_write_row( json_write_plan_t *plan, Datum *values, bool *nulls, StringInfo out ) {
+    int i;
+
+    if( plan->null_mode == JSON_NULL_OMIT ) {
+        json_write_row_omit( plan, values, nulls, out );
+        return;
+    }
+
+    for( i=0; i < plan->nops; i++ ) {
+        json_write_op_t     *op = &plan->ops[i];
+        json_write_column_t *col;
+
+        appendBinaryStringInfo( out, plan->lits.data + op->litoff, op->litlen );
+        if( op->attnum < 0 )
+            continue;
+
+        col = &plan->columns[op->attnum];
+        if( nulls[op->attnum] )
+            appendBinaryStringInfo( out, col->null, col->nulllen );
+        else
+            col->emit( col, out, values[op->attnum] );
+    }
+}
@@ -0,0 +1,75 @@
+DROP SCHEMA IF EXISTS __json_formatter_bench CASCADE;
+CREATE SCHEMA __json_formatter_bench;
+
+SET search_path TO __json_formatter_bench;
+
+CREATE EXTERNAL TABLE twitter_jansson (
+    id bigint,
+    created_at text,
+    "user.name" text,
+    "user.id" bigint,
+    "text" text
+) LOCATION (
+    'gpfdist://localhost:8081/data/twitter.json'
+) FORMAT 'custom' (
+    formatter=json_formatter_read,
+    engine='jansson'
+) SEGMENT REJECT LIMIT 250 ROWS;
+
+CREATE EXTERNAL TABLE twitter_sax (
+    id bigint,
+    created_at text,
+    "user.name" text,
+    "user.id" bigint,
+    "text" text
+) LOCATION (
+    'gpfdist://localhost:8081/data/twitter.json'
+) FORMAT 'custom' (
+    formatter=json_formatter_read,
+    engine='sax'
+) SEGMENT REJECT LIMIT 250 ROWS;
+
+CREATE EXTERNAL TABLE twitter_jansson_filter (
+    id bigint,
+    created_at text,
+    "user.name" text,
+    "user.id" bigint,
+    "text" text
+) LOCATION (
+    'gpfdist://localhost:8081/data/twitter.json'
+) FORMAT 'custom' (
+    formatter=json_formatter_read,
+    engine='jansson',
+    filter='user.lang=ja'
+) SEGMENT REJECT LIMIT 250 ROWS;
+
+CREATE EXTERNAL TABLE twitter_sax_filter (
+    id bigint,
+    created_at text,
+    "user.name" text,
+    "user.id" bigint,
+    "text" text
+) LOCATION (
+    'gpfdist://localhost:8081/data/twitter.json'
+) FORMAT 'custom' (
+    formatter=json_formatter_read,
+    engine='sax',
+    filter='user.lang=ja'
+) SEGMENT REJECT LIMIT 250 ROWS;
+
+CREATE TABLE twitter_rows AS
+SELECT t.*
+FROM twitter_sax t, generate_series(1, 64)
+DISTRIBUTED RANDOMLY;
+
+CREATE WRITABLE EXTERNAL TABLE out_twitter (
+    id bigint,
+    created_at text,
+    "user.name" text,
+    "user.id" bigint,
+    "text" text
+) LOCATION (
+    'gpfdist://localhost:8081/out/bench_twitter.json'
+) FORMAT 'custom' (
+    formatter=json_formatter_write
+);
@@ -0,0 +1,64 @@
+#!/bin/sh
+#
+# Read throughput of each engine over the twitter fixtures, with and
+# without a selective filter (about 5% of rows kept), and write
+# throughput of json_formatter_write over the same rows.  Needs a running
+# gpfdist (test/gpfdist.sh) and the formatter installed, like test/test.sh.
+#
+#   ITERATIONS=50 sh test/bench.sh
+#
+
+SCHEMA_NAME=__json_formatter_bench
+ITERATIONS=${ITERATIONS:-20}
+
+psql -q -f test/bench.ddl.sql 2> /dev/null
+
+bench() {
+    table=$1
+    rows=`psql -tA -c "select count(*) from $SCHEMA_NAME.$table" 2> /dev/null`
+
+    start=`date +%s.%N`
+    i=0
+    while [ $i -lt $ITERATIONS ]
+    do
+        psql -tA -c "select count(*) from $SCHEMA_NAME.$table" > /dev/null 2>&1
+        i=`expr $i + 1`
+    done
+    end=`date +%s.%N`
+
+    echo "$table $rows $ITERATIONS $start $end" | awk '{
+        secs = $5 - $4
+        printf "%-24s %8d rows x %3d  %8.3fs  %12.0f rows/sec\n", $1, $2, $3, secs, ($2 * $3) / secs
+    }'
+}
+
+bench twitter_jansson
+bench twitter_sax
+bench twitter_jansson_filter
+bench twitter_sax_filter
+
+bench_write() {
+    table=$1
+    rows=`psql -tA -c "select count(*) from $SCHEMA_NAME.twitter_rows" 2> /dev/null`
+
+    rm -f test/out/bench_twitter.json
+
+    start=`date +%s.%N`
+    i=0
+    while [ $i -lt $ITERATIONS ]
+    do
+        psql -tA -c "insert into $SCHEMA_NAME.$table select * from $SCHEMA_NAME.twitter_rows" > /dev/null 2>&1
+        i=`expr $i + 1`
+    done
+    end=`date +%s.%N`
+
+    bytes=`wc -c < test/out/bench_twitter.json`
+    rm -f test/out/bench_twitter.json
+
+    echo "$table $rows $ITERATIONS $start $end $bytes" | awk '{
+        secs = $5 - $4
+        printf "%-24s %8d rows x %3d  %8.3fs  %12.0f rows/sec  %8.1f MB/sec\n", $1, $2, $3, secs, ($2 * $3) / secs, $6 / secs / 1048576
+    }'
+}
+
+bench_write out_twitter
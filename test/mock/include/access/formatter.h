@@ -0,0 +1,77 @@
+/*
+ * Copyright (c) 2013 Dillon Woods <dewoods@gmail.com>
+ *
+ * greenplum-json-formatter is free software; you can redistribute it and/or modify
+ * it under the terms of the MIT license. See LICENSE for details.
+ */
+
+#ifndef MOCK_FORMATTER_H
+#define MOCK_FORMATTER_H
+
+#include "postgres.h"
+#include "fmgr.h"
+#include "access/tupdesc.h"
+
+typedef enum {
+    FMT_NONE,
+    FMT_NEED_MORE_DATA,
+    FMT_DONE
+} FmtNotification;
+
+typedef struct {
+    char        *defname;
+    char        *arg;
+} DefElem;
+
+typedef struct List {
+    int         length;
+    DefElem     **elements;
+} List;
+
+/**
+ * Custom format call state, as the format manager keeps it
+ */
+typedef struct FormatterData {
+    TupleDesc       fmt_tupDesc;
+    HeapTuple       fmt_tuple;
+    List            *fmt_args;
+    char            *fmt_databuf;
+    int             fmt_databuf_len;
+    int             fmt_databuf_cur;
+    bool            fmt_saw_eof;
+    void            *fmt_user_ctx;
+    MemoryContext   fmt_perrow_ctx;
+    FmtNotification fmt_notification;
+    char            *fmt_badrow_data;
+    int             fmt_badrow_len;
+    int             fmt_badrow_num;
+} FormatterData;
+
+#define FMT(fcinfo) ((FormatterData *) (fcinfo)->context)
+
+#define CALLED_AS_FORMATTER(fcinfo) ((fcinfo)->context != NULL)
+#define FORMATTER_GET_TUPDESC(fcinfo) (FMT(fcinfo)->fmt_tupDesc)
+#define FORMATTER_GET_PER_ROW_MEM_CTX(fcinfo) (FMT(fcinfo)->fmt_perrow_ctx)
+#define FORMATTER_GET_DATABUF(fcinfo) (FMT(fcinfo)->fmt_databuf)
+#define FORMATTER_GET_DATALEN(fcinfo) (FMT(fcinfo)->fmt_databuf_len)
+#define FORMATTER_GET_DATACURSOR(fcinfo) (FMT(fcinfo)->fmt_databuf_cur)
+#define FORMATTER_GET_SAW_EOF(fcinfo) (FMT(fcinfo)->fmt_saw_eof)
+#define FORMATTER_GET_USER_CTX(fcinfo) (FMT(fcinfo)->fmt_user_ctx)
+#define FORMATTER_GET_NUM_ARGS(fcinfo) (FMT(fcinfo)->fmt_args ? FMT(fcinfo)->fmt_args->length : 0)
+#define FORMATTER_GET_NTH_ARG_KEY(fcinfo, n) (FMT(fcinfo)->fmt_args->elements[(n) - 1]->defname)
+#define FORMATTER_GET_NTH_ARG_VAL(fcinfo, n) (FMT(fcinfo)->fmt_args->elements[(n) - 1]->arg)
+
+#define FORMATTER_SET_USER_CTX(fcinfo, p) (FMT(fcinfo)->fmt_user_ctx = (p))
+#define FORMATTER_SET_DATACURSOR(fcinfo, n) (FMT(fcinfo)->fmt_databuf_cur = (n))
+#define FORMATTER_SET_TUPLE(fcinfo, t) (FMT(fcinfo)->fmt_tuple = (t))
+#define FORMATTER_SET_BAD_ROW_DATA(fcinfo, p, n) (FMT(fcinfo)->fmt_badrow_data = (p), FMT(fcinfo)->fmt_badrow_len = (n))
+#define FORMATTER_SET_BAD_ROW_NUM(fcinfo, n) (FMT(fcinfo)->fmt_badrow_num = (n))
+
+#define FORMATTER_RETURN_TUPLE(tuple) return PointerGetDatum(tuple)
+#define FORMATTER_RETURN_NOTIFICATION(fcinfo, n) \
+    do { \
+        FMT(fcinfo)->fmt_notification = (n); \
+        return PointerGetDatum(NULL); \
+    } while( 0 )
+
+#endif
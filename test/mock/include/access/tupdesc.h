@@ -0,0 +1,56 @@
+/*
+ * Copyright (c) 2013 Dillon Woods <dewoods@gmail.com>
+ *
+ * greenplum-json-formatter is free software; you can redistribute it and/or modify
+ * it under the terms of the MIT license. See LICENSE for details.
+ */
+
+#ifndef MOCK_TUPDESC_H
+#define MOCK_TUPDESC_H
+
+#include "postgres.h"
+
+typedef struct FormData_pg_attribute {
+    NameData    attname;
+    Oid         atttypid;
+    int32       atttypmod;
+} FormData_pg_attribute;
+
+typedef FormData_pg_attribute *Form_pg_attribute;
+
+typedef struct tupleDesc {
+    int                 natts;
+    Form_pg_attribute   *attrs;
+} *TupleDesc;
+
+/**
+ * Tuples only carry their values; a tuple header is what the driver
+ * passes to a writer, a heap tuple what a reader returns
+ */
+typedef struct HeapTupleHeaderData {
+    int         natts;
+    Datum       *values;
+    bool        *nulls;
+} HeapTupleHeaderData;
+
+typedef HeapTupleHeaderData *HeapTupleHeader;
+
+typedef struct {
+    int         ip;
+} ItemPointerData;
+
+typedef struct HeapTupleData {
+    uint32          t_len;
+    ItemPointerData t_self;
+    HeapTupleHeader t_data;
+} HeapTupleData;
+
+typedef HeapTupleData *HeapTuple;
+
+#define HeapTupleHeaderGetDatumLength(tup) ((uint32) sizeof(HeapTupleHeaderData))
+#define ItemPointerSetInvalid(pointer) ((pointer)->ip = 0)
+
+extern HeapTuple heap_form_tuple( TupleDesc tupdesc, Datum *values, bool *isnull );
+extern void heap_deform_tuple( HeapTuple tuple, TupleDesc tupdesc, Datum *values, bool *isnull );
+
+#endif
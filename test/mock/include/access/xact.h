@@ -0,0 +1,23 @@
+/*
+ * Copyright (c) 2013 Dillon Woods <dewoods@gmail.com>
+ *
+ * greenplum-json-formatter is free software; you can redistribute it and/or modify
+ * it under the terms of the MIT license. See LICENSE for details.
+ */
+
+#ifndef MOCK_XACT_H
+#define MOCK_XACT_H
+
+#include "postgres.h"
+
+typedef enum {
+    XACT_EVENT_COMMIT,
+    XACT_EVENT_ABORT,
+    XACT_EVENT_PREPARE
+} XactEvent;
+
+typedef void (*XactCallback)( XactEvent event, void *arg );
+
+extern void RegisterXactCallback( XactCallback callback, void *arg );
+
+#endif
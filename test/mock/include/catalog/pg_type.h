@@ -0,0 +1,37 @@
+/*
+ * Copyright (c) 2013 Dillon Woods <dewoods@gmail.com>
+ *
+ * greenplum-json-formatter is free software; you can redistribute it and/or modify
+ * it under the terms of the MIT license. See LICENSE for details.
+ */
+
+#ifndef MOCK_PG_TYPE_H
+#define MOCK_PG_TYPE_H
+
+#include "postgres.h"
+
+#define BOOLOID 16
+#define INT8OID 20
+#define INT2OID 21
+#define INT4OID 23
+#define TEXTOID 25
+#define JSONOID 114
+#define FLOAT4OID 700
+#define FLOAT8OID 701
+#define VARCHAROID 1043
+#define DATEOID 1082
+#define TIMESTAMPOID 1114
+#define TIMESTAMPTZOID 1184
+#define NUMERICOID 1700
+
+#define BOOLARRAYOID 1000
+#define INT2ARRAYOID 1005
+#define INT4ARRAYOID 1007
+#define TEXTARRAYOID 1009
+#define VARCHARARRAYOID 1015
+#define INT8ARRAYOID 1016
+#define FLOAT4ARRAYOID 1021
+#define FLOAT8ARRAYOID 1022
+#define NUMERICARRAYOID 1231
+
+#endif
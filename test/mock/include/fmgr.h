@@ -0,0 +1,38 @@
+/*
+ * Copyright (c) 2013 Dillon Woods <dewoods@gmail.com>
+ *
+ * greenplum-json-formatter is free software; you can redistribute it and/or modify
+ * it under the terms of the MIT license. See LICENSE for details.
+ */
+
+#ifndef MOCK_FMGR_H
+#define MOCK_FMGR_H
+
+#include "postgres.h"
+
+#define FUNC_MAX_ARGS 4
+
+typedef struct FunctionCallInfoData {
+    void    *context;           /* FormatterData when called as a formatter */
+    int     nargs;
+    Datum   arg[FUNC_MAX_ARGS];
+    bool    argnull[FUNC_MAX_ARGS];
+} FunctionCallInfoData;
+
+typedef FunctionCallInfoData *FunctionCallInfo;
+typedef Datum (*PGFunction)( FunctionCallInfo fcinfo );
+
+#define PG_FUNCTION_ARGS FunctionCallInfo fcinfo
+#define PG_MODULE_MAGIC extern int no_such_variable
+#define PG_FUNCTION_INFO_V1(funcname) extern int no_such_variable
+
+#define PG_GETARG_DATUM(n) (fcinfo->arg[n])
+#define PG_GETARG_HEAPTUPLEHEADER(n) ((HeapTupleHeader) DatumGetPointer(fcinfo->arg[n]))
+#define PG_RETURN_DATUM(x) return (x)
+#define PG_RETURN_BYTEA_P(x) return PointerGetDatum(x)
+#define PG_RETURN_NULL() return (Datum) 0
+
+extern Datum DirectFunctionCall1( PGFunction func, Datum arg1 );
+extern Datum DirectFunctionCall3( PGFunction func, Datum arg1, Datum arg2, Datum arg3 );
+
+#endif
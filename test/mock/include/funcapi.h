@@ -0,0 +1,57 @@
+/*
+ * Copyright (c) 2013 Dillon Woods <dewoods@gmail.com>
+ *
+ * greenplum-json-formatter is free software; you can redistribute it and/or modify
+ * it under the terms of the MIT license. See LICENSE for details.
+ */
+
+#ifndef MOCK_FUNCAPI_H
+#define MOCK_FUNCAPI_H
+
+#include "postgres.h"
+#include "fmgr.h"
+#include "access/tupdesc.h"
+
+/**
+ * Set returning functions keep one call in progress at a time.  There is
+ * no catalog, so get_call_result_type never finds a row type.
+ */
+typedef struct FuncCallContext {
+    uint64          call_cntr;
+    uint64          max_calls;
+    void            *user_fctx;
+    TupleDesc       tuple_desc;
+    MemoryContext   multi_call_memory_ctx;
+} FuncCallContext;
+
+typedef enum {
+    TYPEFUNC_SCALAR,
+    TYPEFUNC_COMPOSITE,
+    TYPEFUNC_RECORD,
+    TYPEFUNC_OTHER
+} TypeFuncClass;
+
+extern FuncCallContext *mock_srf_context;
+
+extern FuncCallContext *mock_srf_init( void );
+extern void mock_srf_done( void );
+extern TypeFuncClass get_call_result_type( FunctionCallInfo fcinfo, Oid *resultTypeId, TupleDesc *resultTupleDesc );
+extern TupleDesc BlessTupleDesc( TupleDesc tupdesc );
+
+#define HeapTupleGetDatum(tuple) PointerGetDatum((tuple)->t_data)
+
+#define SRF_IS_FIRSTCALL() (mock_srf_context == NULL)
+#define SRF_FIRSTCALL_INIT() mock_srf_init()
+#define SRF_PERCALL_SETUP() mock_srf_context
+#define SRF_RETURN_NEXT(funcctx, result) \
+    do { \
+        (funcctx)->call_cntr++; \
+        return (result); \
+    } while( 0 )
+#define SRF_RETURN_DONE(funcctx) \
+    do { \
+        mock_srf_done(); \
+        return (Datum) 0; \
+    } while( 0 )
+
+#endif
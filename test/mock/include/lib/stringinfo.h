@@ -0,0 +1,30 @@
+/*
+ * Copyright (c) 2013 Dillon Woods <dewoods@gmail.com>
+ *
+ * greenplum-json-formatter is free software; you can redistribute it and/or modify
+ * it under the terms of the MIT license. See LICENSE for details.
+ */
+
+#ifndef MOCK_STRINGINFO_H
+#define MOCK_STRINGINFO_H
+
+#include "postgres.h"
+
+typedef struct StringInfoData {
+    char    *data;
+    int     len;
+    int     maxlen;
+    int     cursor;
+} StringInfoData;
+
+typedef StringInfoData *StringInfo;
+
+extern void initStringInfo( StringInfo str );
+extern void resetStringInfo( StringInfo str );
+extern void enlargeStringInfo( StringInfo str, int needed );
+extern void appendStringInfo( StringInfo str, const char *fmt, ... ) __attribute__((format(printf, 2, 3)));
+extern void appendStringInfoString( StringInfo str, const char *s );
+extern void appendStringInfoChar( StringInfo str, char ch );
+extern void appendBinaryStringInfo( StringInfo str, const char *data, int datalen );
+
+#endif
@@ -0,0 +1,19 @@
+/*
+ * Copyright (c) 2013 Dillon Woods <dewoods@gmail.com>
+ *
+ * greenplum-json-formatter is free software; you can redistribute it and/or modify
+ * it under the terms of the MIT license. See LICENSE for details.
+ */
+
+#ifndef MOCK_PG_WCHAR_H
+#define MOCK_PG_WCHAR_H
+
+#include "postgres.h"
+
+#define PG_SQL_ASCII 0
+#define PG_UTF8 6
+
+extern int GetDatabaseEncoding( void );
+extern int pg_mbstrlen_with_len( const char *mbstr, int limit );
+
+#endif
@@ -0,0 +1,191 @@
+/*
+ * Copyright (c) 2013 Dillon Woods <dewoods@gmail.com>
+ *
+ * greenplum-json-formatter is free software; you can redistribute it and/or modify
+ * it under the terms of the MIT license. See LICENSE for details.
+ */
+
+/**
+ * Stand-in for the parts of the server headers the formatter uses, so it
+ * can be built and driven by test/mock_bench.c without Greenplum.  Only
+ * what src/ needs is declared, with the same names and calling
+ * conventions; test/mock/pg_mock.c implements it.  64 bit builds only:
+ * every by-value type fits in a Datum.
+ */
+
+#ifndef MOCK_POSTGRES_H
+#define MOCK_POSTGRES_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <inttypes.h>
+#include <setjmp.h>
+
+#define PG_VERSION_NUM 80300
+#define HAVE_INT64_TIMESTAMP 1
+
+typedef int8_t int8;
+typedef int16_t int16;
+typedef int32_t int32;
+typedef int64_t int64;
+typedef uint8_t uint8;
+typedef uint16_t uint16;
+typedef uint32_t uint32;
+typedef uint64_t uint64;
+typedef float float4;
+typedef double float8;
+typedef size_t Size;
+typedef unsigned int Oid;
+typedef uintptr_t Datum;
+typedef char *Pointer;
+
+#define InvalidOid ((Oid) 0)
+#define NAMEDATALEN 64
+#define INT64CONST(x) ((int64) x##LL)
+#define INT64_FORMAT "%" PRId64
+#define UINT64_FORMAT "%" PRIu64
+
+#define Min(x, y) ((x) < (y) ? (x) : (y))
+#define Max(x, y) ((x) > (y) ? (x) : (y))
+#define lengthof(array) (sizeof(array) / sizeof((array)[0]))
+#define MemSet(start, val, len) memset( (start), (val), (len) )
+#define MAXIMUM_ALIGNOF 8
+#define MAXALIGN(len) (((uintptr_t) (len) + (MAXIMUM_ALIGNOF - 1)) & ~((uintptr_t) (MAXIMUM_ALIGNOF - 1)))
+
+typedef struct {
+    char    data[NAMEDATALEN];
+} NameData;
+
+/**
+ * Datums
+ */
+#define PointerGetDatum(x) ((Datum) (x))
+#define DatumGetPointer(x) ((Pointer) (x))
+#define CStringGetDatum(x) PointerGetDatum(x)
+#define DatumGetCString(x) ((char *) DatumGetPointer(x))
+#define ObjectIdGetDatum(x) ((Datum) (x))
+#define BoolGetDatum(x) ((Datum) ((x) ? 1 : 0))
+#define DatumGetBool(x) ((bool) ((x) != 0))
+#define Int16GetDatum(x) ((Datum) (int16) (x))
+#define DatumGetInt16(x) ((int16) (x))
+#define Int32GetDatum(x) ((Datum) (int32) (x))
+#define DatumGetInt32(x) ((int32) (x))
+#define Int64GetDatum(x) ((Datum) (int64) (x))
+#define DatumGetInt64(x) ((int64) (x))
+
+extern Datum Float4GetDatum( float4 x );
+extern float4 DatumGetFloat4( Datum x );
+extern Datum Float8GetDatum( float8 x );
+extern float8 DatumGetFloat8( Datum x );
+
+/**
+ * Variable length values, always with a 4 byte header
+ */
+struct varlena {
+    char    vl_len_[4];
+    char    vl_dat[1];
+};
+
+typedef struct varlena text;
+typedef struct varlena bytea;
+
+#define VARHDRSZ ((int32) sizeof(int32))
+#define SET_VARSIZE(ptr, len) (*(int32 *) (ptr) = (int32) (len))
+#define VARSIZE(ptr) (*(int32 *) (ptr))
+#define VARDATA(ptr) (((struct varlena *) (ptr))->vl_dat)
+#define VARSIZE_ANY_EXHDR(ptr) (VARSIZE(ptr) - VARHDRSZ)
+#define VARDATA_ANY(ptr) VARDATA(ptr)
+#define DatumGetTextPP(x) ((text *) DatumGetPointer(x))
+
+/**
+ * Memory contexts
+ */
+typedef struct MemoryContextData *MemoryContext;
+
+extern MemoryContext CurrentMemoryContext;
+extern MemoryContext TopMemoryContext;
+
+extern void *palloc( Size size );
+extern void *palloc0( Size size );
+extern void *repalloc( void *pointer, Size size );
+extern void pfree( void *pointer );
+extern char *pstrdup( const char *str );
+extern void *MemoryContextAlloc( MemoryContext context, Size size );
+extern void *MemoryContextAllocZero( MemoryContext context, Size size );
+
+static inline MemoryContext
+MemoryContextSwitchTo( MemoryContext context ) {
+    MemoryContext old = CurrentMemoryContext;
+
+    CurrentMemoryContext = context;
+    return old;
+}
+
+/**
+ * Errors unwind to the innermost PG_TRY, or to the driver
+ */
+#define DEBUG1 14
+#define LOG 15
+#define NOTICE 18
+#define WARNING 19
+#define ERROR 20
+
+#define ERRCODE_DATA_EXCEPTION 1
+#define ERRCODE_NUMERIC_VALUE_OUT_OF_RANGE 2
+#define ERRCODE_INVALID_PARAMETER_VALUE 3
+#define ERRCODE_INVALID_TEXT_REPRESENTATION 4
+#define ERRCODE_FEATURE_NOT_SUPPORTED 5
+#define ERRCODE_INSUFFICIENT_RESOURCES 6
+
+extern jmp_buf *PG_exception_stack;
+extern char mock_errmsg[1024];
+
+extern void errstart( int elevel );
+extern int errcode( int sqlerrcode );
+extern int errmsg( const char *fmt, ... ) __attribute__((format(printf, 1, 2)));
+extern int errdetail( const char *fmt, ... ) __attribute__((format(printf, 1, 2)));
+extern void errfinish( int elevel );
+extern void elog_finish( int elevel, const char *fmt, ... ) __attribute__((format(printf, 2, 3)));
+extern void pg_re_throw( void ) __attribute__((noreturn));
+
+#define ereport(elevel, rest) \
+    do { \
+        errstart( elevel ); \
+        (void) rest; \
+        errfinish( elevel ); \
+        if( (elevel) >= ERROR ) \
+            __builtin_unreachable(); \
+    } while( 0 )
+
+#define elog(elevel, ...) \
+    do { \
+        elog_finish( elevel, __VA_ARGS__ ); \
+        if( (elevel) >= ERROR ) \
+            __builtin_unreachable(); \
+    } while( 0 )
+
+#define PG_TRY() \
+    do { \
+        jmp_buf *save_exception_stack = PG_exception_stack; \
+        jmp_buf local_sigjmp_buf; \
+        if( setjmp( local_sigjmp_buf ) == 0 ) { \
+            PG_exception_stack = &local_sigjmp_buf
+
+#define PG_CATCH() \
+        } else { \
+            PG_exception_stack = save_exception_stack;
+
+#define PG_END_TRY() \
+        } \
+        PG_exception_stack = save_exception_stack; \
+    } while( 0 )
+
+#define PG_RE_THROW() pg_re_throw()
+
+#define Assert(condition) ((void) 0)
+
+#endif
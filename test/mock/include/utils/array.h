@@ -0,0 +1,39 @@
+/*
+ * Copyright (c) 2013 Dillon Woods <dewoods@gmail.com>
+ *
+ * greenplum-json-formatter is free software; you can redistribute it and/or modify
+ * it under the terms of the MIT license. See LICENSE for details.
+ */
+
+#ifndef MOCK_ARRAY_H
+#define MOCK_ARRAY_H
+
+#include "postgres.h"
+
+#define MAXDIM 6
+
+/**
+ * Arrays keep their elements as Datums rather than packed, which is
+ * enough for the formatter: it only builds and takes them apart
+ */
+typedef struct {
+    int     ndim;
+    int     dims[MAXDIM];
+    int     lbs[MAXDIM];
+    Oid     elemtype;
+    int     nitems;
+    Datum   *values;
+    bool    *nulls;
+} ArrayType;
+
+#define DatumGetArrayTypeP(x) ((ArrayType *) DatumGetPointer(x))
+#define ARR_NDIM(a) ((a)->ndim)
+#define ARR_DIMS(a) ((a)->dims)
+#define ARR_LBOUND(a) ((a)->lbs)
+#define ARR_ELEMTYPE(a) ((a)->elemtype)
+
+extern ArrayType *construct_empty_array( Oid elmtype );
+extern ArrayType *construct_md_array( Datum *elems, bool *nulls, int ndims, int *dims, int *lbs, Oid elmtype, int elmlen, bool elmbyval, char elmalign );
+extern void deconstruct_array( ArrayType *array, Oid elmtype, int elmlen, bool elmbyval, char elmalign, Datum **elemsp, bool **nullsp, int *nelemsp );
+
+#endif
@@ -0,0 +1,26 @@
+/*
+ * Copyright (c) 2013 Dillon Woods <dewoods@gmail.com>
+ *
+ * greenplum-json-formatter is free software; you can redistribute it and/or modify
+ * it under the terms of the MIT license. See LICENSE for details.
+ */
+
+#ifndef MOCK_BUILTINS_H
+#define MOCK_BUILTINS_H
+
+#include "postgres.h"
+#include "fmgr.h"
+
+extern Datum textin( PG_FUNCTION_ARGS );
+extern Datum numeric_in( PG_FUNCTION_ARGS );
+extern Datum numeric_out( PG_FUNCTION_ARGS );
+extern Datum int8_numeric( PG_FUNCTION_ARGS );
+extern Datum float8_numeric( PG_FUNCTION_ARGS );
+extern Datum date_in( PG_FUNCTION_ARGS );
+extern Datum date_out( PG_FUNCTION_ARGS );
+extern Datum timestamp_in( PG_FUNCTION_ARGS );
+extern Datum timestamp_out( PG_FUNCTION_ARGS );
+extern Datum timestamptz_in( PG_FUNCTION_ARGS );
+extern Datum timestamptz_out( PG_FUNCTION_ARGS );
+
+#endif
@@ -0,0 +1,20 @@
+/*
+ * Copyright (c) 2013 Dillon Woods <dewoods@gmail.com>
+ *
+ * greenplum-json-formatter is free software; you can redistribute it and/or modify
+ * it under the terms of the MIT license. See LICENSE for details.
+ */
+
+#ifndef MOCK_DATE_H
+#define MOCK_DATE_H
+
+#include "postgres.h"
+
+typedef int32 DateADT;
+
+#define DateADTGetDatum(x) Int32GetDatum(x)
+#define DatumGetDateADT(x) DatumGetInt32(x)
+
+#define DATE_NOT_FINITE(j) ((j) == INT32_MIN || (j) == INT32_MAX)
+
+#endif
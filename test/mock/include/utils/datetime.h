@@ -0,0 +1,36 @@
+/*
+ * Copyright (c) 2013 Dillon Woods <dewoods@gmail.com>
+ *
+ * greenplum-json-formatter is free software; you can redistribute it and/or modify
+ * it under the terms of the MIT license. See LICENSE for details.
+ */
+
+#ifndef MOCK_DATETIME_H
+#define MOCK_DATETIME_H
+
+#include "postgres.h"
+#include "utils/timestamp.h"
+
+struct pg_tm {
+    int     tm_sec;
+    int     tm_min;
+    int     tm_hour;
+    int     tm_mday;
+    int     tm_mon;     /* 1 based, unlike struct tm */
+    int     tm_year;    /* the year itself, unlike struct tm */
+    int     tm_wday;
+    int     tm_yday;
+    int     tm_isdst;
+};
+
+#define POSTGRES_EPOCH_JDATE 2451545
+#define isleap(y) (((y) % 4) == 0 && (((y) % 100) != 0 || ((y) % 400) == 0))
+
+extern const int day_tab[2][13];
+
+extern int date2j( int year, int month, int day );
+extern void j2date( int jd, int *year, int *month, int *day );
+extern int tm2timestamp( struct pg_tm *tm, fsec_t fsec, int *tzp, Timestamp *result );
+extern int timestamp2tm( Timestamp dt, int *tzp, struct pg_tm *tm, fsec_t *fsec, const char **tzn, void *attimezone );
+
+#endif
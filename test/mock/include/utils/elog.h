@@ -0,0 +1,13 @@
+/*
+ * Copyright (c) 2013 Dillon Woods <dewoods@gmail.com>
+ *
+ * greenplum-json-formatter is free software; you can redistribute it and/or modify
+ * it under the terms of the MIT license. See LICENSE for details.
+ */
+
+#ifndef MOCK_ELOG_H
+#define MOCK_ELOG_H
+
+#include "postgres.h"
+
+#endif
@@ -0,0 +1,16 @@
+/*
+ * Copyright (c) 2013 Dillon Woods <dewoods@gmail.com>
+ *
+ * greenplum-json-formatter is free software; you can redistribute it and/or modify
+ * it under the terms of the MIT license. See LICENSE for details.
+ */
+
+#ifndef MOCK_LSYSCACHE_H
+#define MOCK_LSYSCACHE_H
+
+#include "postgres.h"
+
+extern Oid get_element_type( Oid typid );
+extern void get_typlenbyvalalign( Oid typid, int16 *typlen, bool *typbyval, char *typalign );
+
+#endif
@@ -0,0 +1,21 @@
+/*
+ * Copyright (c) 2013 Dillon Woods <dewoods@gmail.com>
+ *
+ * greenplum-json-formatter is free software; you can redistribute it and/or modify
+ * it under the terms of the MIT license. See LICENSE for details.
+ */
+
+#ifndef MOCK_MEMUTILS_H
+#define MOCK_MEMUTILS_H
+
+#include "postgres.h"
+
+#define ALLOCSET_DEFAULT_MINSIZE 0
+#define ALLOCSET_DEFAULT_INITSIZE (8 * 1024)
+#define ALLOCSET_DEFAULT_MAXSIZE (8 * 1024 * 1024)
+
+extern MemoryContext AllocSetContextCreate( MemoryContext parent, const char *name, Size minContextSize, Size initBlockSize, Size maxBlockSize );
+extern void MemoryContextReset( MemoryContext context );
+extern void MemoryContextDelete( MemoryContext context );
+
+#endif
@@ -0,0 +1,24 @@
+/*
+ * Copyright (c) 2013 Dillon Woods <dewoods@gmail.com>
+ *
+ * greenplum-json-formatter is free software; you can redistribute it and/or modify
+ * it under the terms of the MIT license. See LICENSE for details.
+ */
+
+#ifndef MOCK_TIMESTAMP_H
+#define MOCK_TIMESTAMP_H
+
+#include "postgres.h"
+
+typedef int64 Timestamp;
+typedef int64 TimestampTz;
+typedef int32 fsec_t;
+
+#define TimestampGetDatum(x) Int64GetDatum(x)
+#define TimestampTzGetDatum(x) Int64GetDatum(x)
+#define DatumGetTimestamp(x) DatumGetInt64(x)
+#define DatumGetTimestampTz(x) DatumGetInt64(x)
+
+#define TIMESTAMP_NOT_FINITE(j) ((j) == INT64_MIN || (j) == INT64_MAX)
+
+#endif
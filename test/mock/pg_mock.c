@@ -0,0 +1,929 @@
+/*
+ * Copyright (c) 2013 Dillon Woods <dewoods@gmail.com>
+ *
+ * greenplum-json-formatter is free software; you can redistribute it and/or modify
+ * it under the terms of the MIT license. See LICENSE for details.
+ */
+
+/**
+ * Stand-in server for the formatter
+ *
+ * Implements what test/mock/include declares with plain malloc and
+ * longjmp: memory contexts own their chunks and free them on reset,
+ * errors unwind to the innermost PG_TRY or the driver's setjmp, and the
+ * type input and output functions only handle the forms the fixtures
+ * use.  Timestamps are in UTC.  Allocations are counted so the driver can
+ * report them per row.
+ */
+
+#include <ctype.h>
+#include <math.h>
+#include <stdarg.h>
+
+#include "postgres.h"
+#include "fmgr.h"
+#include "funcapi.h"
+#include "access/tupdesc.h"
+#include "access/xact.h"
+#include "catalog/pg_type.h"
+#include "lib/stringinfo.h"
+#include "mb/pg_wchar.h"
+#include "utils/array.h"
+#include "utils/builtins.h"
+#include "utils/date.h"
+#include "utils/datetime.h"
+#include "utils/lsyscache.h"
+#include "utils/memutils.h"
+#include "utils/timestamp.h"
+
+#include "pg_mock.h"
+
+uint64 mock_alloc_calls = 0;
+uint64 mock_alloc_bytes = 0;
+bool mock_quiet = false;
+
+void
+mock_alloc_reset( void ) {
+    mock_alloc_calls = 0;
+    mock_alloc_bytes = 0;
+}
+
+/**
+ * Memory contexts
+ *
+ * Every chunk is linked into its context so a reset can free them all.
+ * The header keeps the chunk 16 byte aligned.
+ */
+typedef struct chunk_t {
+    struct chunk_t  *prev;
+    struct chunk_t  *next;
+    MemoryContext   context;
+    Size            size;
+} chunk_t;
+
+struct MemoryContextData {
+    const char      *name;
+    MemoryContext   parent;
+    MemoryContext   firstchild;
+    MemoryContext   nextchild;
+    chunk_t         chunks;     /* list head */
+};
+
+static struct MemoryContextData top_context = {
+    "TopMemoryContext", NULL, NULL, NULL, { &top_context.chunks, &top_context.chunks, NULL, 0 }
+};
+
+MemoryContext TopMemoryContext = &top_context;
+MemoryContext CurrentMemoryContext = &top_context;
+
+#define CHUNK_HDRSZ sizeof(chunk_t)
+#define CHUNK(pointer) ((chunk_t *) ((char *) (pointer) - CHUNK_HDRSZ))
+
+static void
+out_of_memory( Size size ) {
+    fprintf( stderr, "out of memory allocating %zu bytes\n", size );
+    abort();
+}
+
+static void
+chunk_link( MemoryContext context, chunk_t *chunk ) {
+    chunk->context = context;
+    chunk->next = context->chunks.next;
+    chunk->prev = &context->chunks;
+    chunk->next->prev = chunk;
+    context->chunks.next = chunk;
+}
+
+static void
+chunk_unlink( chunk_t *chunk ) {
+    chunk->prev->next = chunk->next;
+    chunk->next->prev = chunk->prev;
+}
+
+void *
+MemoryContextAlloc( MemoryContext context, Size size ) {
+    chunk_t *chunk = malloc( CHUNK_HDRSZ + size );
+
+    if( !chunk )
+        out_of_memory( size );
+
+    chunk->size = size;
+    chunk_link( context, chunk );
+
+    mock_alloc_calls++;
+    mock_alloc_bytes += size;
+
+    return (char *) chunk + CHUNK_HDRSZ;
+}
+
+void *
+MemoryContextAllocZero( MemoryContext context, Size size ) {
+    void *pointer = MemoryContextAlloc( context, size );
+
+    memset( pointer, 0, size );
+    return pointer;
+}
+
+void *
+palloc( Size size ) {
+    return MemoryContextAlloc( CurrentMemoryContext, size );
+}
+
+void *
+palloc0( Size size ) {
+    return MemoryContextAllocZero( CurrentMemoryContext, size );
+}
+
+void *
+repalloc( void *pointer, Size size ) {
+    chunk_t         *chunk = CHUNK( pointer );
+    MemoryContext   context = chunk->context;
+
+    chunk_unlink( chunk );
+    chunk = realloc( chunk, CHUNK_HDRSZ + size );
+    if( !chunk )
+        out_of_memory( size );
+
+    chunk->size = size;
+    chunk_link( context, chunk );
+
+    mock_alloc_calls++;
+    mock_alloc_bytes += size;
+
+    return (char *) chunk + CHUNK_HDRSZ;
+}
+
+void
+pfree( void *pointer ) {
+    chunk_t *chunk = CHUNK( pointer );
+
+    chunk_unlink( chunk );
+    free( chunk );
+}
+
+char *
+pstrdup( const char *str ) {
+    Size    len = strlen( str ) + 1;
+    char    *copy = palloc( len );
+
+    memcpy( copy, str, len );
+    return copy;
+}
+
+MemoryContext
+AllocSetContextCreate( MemoryContext parent, const char *name, Size minContextSize, Size initBlockSize, Size maxBlockSize ) {
+    MemoryContext context = calloc( 1, sizeof(struct MemoryContextData) );
+
+    if( !context )
+        out_of_memory( sizeof(struct MemoryContextData) );
+
+    context->name = name;
+    context->chunks.next = context->chunks.prev = &context->chunks;
+    context->parent = parent;
+    if( parent ) {
+        context->nextchild = parent->firstchild;
+        parent->firstchild = context;
+    }
+
+    mock_alloc_calls++;
+
+    return context;
+}
+
+/**
+ * Free every chunk, and delete the children as the server does
+ */
+void
+MemoryContextReset( MemoryContext context ) {
+    while( context->firstchild )
+        MemoryContextDelete( context->firstchild );
+
+    while( context->chunks.next != &context->chunks ) {
+        chunk_t *chunk = context->chunks.next;
+
+        chunk_unlink( chunk );
+        free( chunk );
+    }
+}
+
+void
+MemoryContextDelete( MemoryContext context ) {
+    MemoryContextReset( context );
+
+    if( context->parent ) {
+        MemoryContext *link = &context->parent->firstchild;
+
+        while( *link != context )
+            link = &(*link)->nextchild;
+        *link = context->nextchild;
+    }
+
+    if( CurrentMemoryContext == context )
+        CurrentMemoryContext = context->parent ? context->parent : TopMemoryContext;
+
+    if( context != TopMemoryContext )
+        free( context );
+}
+
+/**
+ * Errors
+ */
+jmp_buf *PG_exception_stack = NULL;
+char mock_errmsg[1024];
+
+static int error_level;
+
+static const char *
+level_name( int elevel ) {
+    switch( elevel ) {
+        case NOTICE:
+            return "NOTICE";
+        case WARNING:
+            return "WARNING";
+        case ERROR:
+            return "ERROR";
+        default:
+            return "LOG";
+    }
+}
+
+void
+errstart( int elevel ) {
+    error_level = elevel;
+    mock_errmsg[0] = '\0';
+}
+
+int
+errcode( int sqlerrcode ) {
+    return 0;
+}
+
+int
+errmsg( const char *fmt, ... ) {
+    va_list args;
+
+    va_start( args, fmt );
+    vsnprintf( mock_errmsg, sizeof(mock_errmsg), fmt, args );
+    va_end( args );
+    return 0;
+}
+
+int
+errdetail( const char *fmt, ... ) {
+    return 0;
+}
+
+void
+errfinish( int elevel ) {
+    if( elevel >= ERROR )
+        pg_re_throw();
+
+    if( elevel >= LOG && !mock_quiet )
+        fprintf( stderr, "%s:  %s\n", level_name( elevel ), mock_errmsg );
+}
+
+void
+elog_finish( int elevel, const char *fmt, ... ) {
+    va_list args;
+
+    errstart( elevel );
+    va_start( args, fmt );
+    vsnprintf( mock_errmsg, sizeof(mock_errmsg), fmt, args );
+    va_end( args );
+    errfinish( elevel );
+}
+
+void
+pg_re_throw( void ) {
+    if( !PG_exception_stack ) {
+        fprintf( stderr, "%s:  %s\n", level_name( error_level ), mock_errmsg );
+        exit( 1 );
+    }
+
+    longjmp( *PG_exception_stack, 1 );
+}
+
+/**
+ * Datums and function calls
+ */
+Datum
+Float4GetDatum( float4 x ) {
+    union { float4 f; int32 i; } u;
+
+    u.f = x;
+    return Int32GetDatum( u.i );
+}
+
+float4
+DatumGetFloat4( Datum x ) {
+    union { float4 f; int32 i; } u;
+
+    u.i = DatumGetInt32( x );
+    return u.f;
+}
+
+Datum
+Float8GetDatum( float8 x ) {
+    union { float8 f; int64 i; } u;
+
+    u.f = x;
+    return Int64GetDatum( u.i );
+}
+
+float8
+DatumGetFloat8( Datum x ) {
+    union { float8 f; int64 i; } u;
+
+    u.i = DatumGetInt64( x );
+    return u.f;
+}
+
+Datum
+DirectFunctionCall1( PGFunction func, Datum arg1 ) {
+    FunctionCallInfoData fcinfo = { NULL, 1, { arg1 }, { false } };
+
+    return func( &fcinfo );
+}
+
+Datum
+DirectFunctionCall3( PGFunction func, Datum arg1, Datum arg2, Datum arg3 ) {
+    FunctionCallInfoData fcinfo = { NULL, 3, { arg1, arg2, arg3 }, { false } };
+
+    return func( &fcinfo );
+}
+
+/**
+ * Set returning functions and transactions
+ */
+FuncCallContext *mock_srf_context = NULL;
+
+FuncCallContext *
+mock_srf_init( void ) {
+    mock_srf_context = MemoryContextAllocZero( TopMemoryContext, sizeof(FuncCallContext) );
+    mock_srf_context->multi_call_memory_ctx = AllocSetContextCreate( TopMemoryContext, "SRF multi-call context",
+                                                                     ALLOCSET_DEFAULT_MINSIZE,
+                                                                     ALLOCSET_DEFAULT_INITSIZE,
+                                                                     ALLOCSET_DEFAULT_MAXSIZE );
+    return mock_srf_context;
+}
+
+void
+mock_srf_done( void ) {
+    MemoryContextDelete( mock_srf_context->multi_call_memory_ctx );
+    pfree( mock_srf_context );
+    mock_srf_context = NULL;
+}
+
+TypeFuncClass
+get_call_result_type( FunctionCallInfo fcinfo, Oid *resultTypeId, TupleDesc *resultTupleDesc ) {
+    if( resultTypeId )
+        *resultTypeId = InvalidOid;
+    if( resultTupleDesc )
+        *resultTupleDesc = NULL;
+    return TYPEFUNC_OTHER;
+}
+
+TupleDesc
+BlessTupleDesc( TupleDesc tupdesc ) {
+    return tupdesc;
+}
+
+#define MAX_XACT_CALLBACKS 8
+
+static struct {
+    XactCallback    callback;
+    void            *arg;
+} xact_callbacks[MAX_XACT_CALLBACKS];
+static int nxact_callbacks = 0;
+
+void
+RegisterXactCallback( XactCallback callback, void *arg ) {
+    if( nxact_callbacks == MAX_XACT_CALLBACKS )
+        elog( ERROR, "too many transaction callbacks" );
+
+    xact_callbacks[nxact_callbacks].callback = callback;
+    xact_callbacks[nxact_callbacks].arg = arg;
+    nxact_callbacks++;
+}
+
+void
+mock_xact_end( void ) {
+    int i;
+
+    for( i=0; i < nxact_callbacks; i++ )
+        xact_callbacks[i].callback( XACT_EVENT_COMMIT, xact_callbacks[i].arg );
+}
+
+/**
+ * String buffers
+ */
+void
+initStringInfo( StringInfo str ) {
+    str->maxlen = 1024;
+    str->data = palloc( str->maxlen );
+    resetStringInfo( str );
+}
+
+void
+resetStringInfo( StringInfo str ) {
+    str->data[0] = '\0';
+    str->len = 0;
+    str->cursor = 0;
+}
+
+void
+enlargeStringInfo( StringInfo str, int needed ) {
+    int newlen = str->maxlen;
+
+    needed += str->len + 1;
+    if( needed <= str->maxlen )
+        return;
+
+    while( newlen < needed )
+        newlen *= 2;
+
+    str->data = repalloc( str->data, newlen );
+    str->maxlen = newlen;
+}
+
+void
+appendStringInfo( StringInfo str, const char *fmt, ... ) {
+    for( ;; ) {
+        va_list args;
+        int     avail = str->maxlen - str->len;
+        int     n;
+
+        va_start( args, fmt );
+        n = vsnprintf( str->data + str->len, avail, fmt, args );
+        va_end( args );
+
+        if( n < avail ) {
+            str->len += n;
+            return;
+        }
+        enlargeStringInfo( str, n );
+    }
+}
+
+void
+appendBinaryStringInfo( StringInfo str, const char *data, int datalen ) {
+    enlargeStringInfo( str, datalen );
+    memcpy( str->data + str->len, data, datalen );
+    str->len += datalen;
+    str->data[str->len] = '\0';
+}
+
+void
+appendStringInfoString( StringInfo str, const char *s ) {
+    appendBinaryStringInfo( str, s, strlen( s ) );
+}
+
+void
+appendStringInfoChar( StringInfo str, char ch ) {
+    appendBinaryStringInfo( str, &ch, 1 );
+}
+
+/**
+ * Tuples and arrays
+ */
+HeapTuple
+heap_form_tuple( TupleDesc tupdesc, Datum *values, bool *isnull ) {
+    int         natts = tupdesc->natts;
+    HeapTuple   tuple = palloc( sizeof(HeapTupleData) + sizeof(HeapTupleHeaderData) );
+
+    tuple->t_data = (HeapTupleHeader) (tuple + 1);
+    tuple->t_len = sizeof(HeapTupleHeaderData);
+    ItemPointerSetInvalid( &tuple->t_self );
+
+    tuple->t_data->natts = natts;
+    tuple->t_data->values = palloc( sizeof(Datum) * natts );
+    tuple->t_data->nulls = palloc( sizeof(bool) * natts );
+    memcpy( tuple->t_data->values, values, sizeof(Datum) * natts );
+    memcpy( tuple->t_data->nulls, isnull, sizeof(bool) * natts );
+
+    return tuple;
+}
+
+void
+heap_deform_tuple( HeapTuple tuple, TupleDesc tupdesc, Datum *values, bool *isnull ) {
+    memcpy( values, tuple->t_data->values, sizeof(Datum) * tupdesc->natts );
+    memcpy( isnull, tuple->t_data->nulls, sizeof(bool) * tupdesc->natts );
+}
+
+ArrayType *
+construct_empty_array( Oid elmtype ) {
+    ArrayType *array = palloc0( sizeof(ArrayType) );
+
+    array->elemtype = elmtype;
+    return array;
+}
+
+ArrayType *
+construct_md_array( Datum *elems, bool *nulls, int ndims, int *dims, int *lbs, Oid elmtype, int elmlen, bool elmbyval, char elmalign ) {
+    ArrayType   *array = palloc0( sizeof(ArrayType) );
+    int         i, nitems = 1;
+
+    for( i=0; i < ndims; i++ ) {
+        array->dims[i] = dims[i];
+        array->lbs[i] = lbs[i];
+        nitems *= dims[i];
+    }
+
+    array->ndim = ndims;
+    array->elemtype = elmtype;
+    array->nitems = nitems;
+    array->values = palloc( sizeof(Datum) * (nitems + 1) );
+    array->nulls = palloc0( sizeof(bool) * (nitems + 1) );
+    memcpy( array->values, elems, sizeof(Datum) * nitems );
+    if( nulls )
+        memcpy( array->nulls, nulls, sizeof(bool) * nitems );
+
+    return array;
+}
+
+void
+deconstruct_array( ArrayType *array, Oid elmtype, int elmlen, bool elmbyval, char elmalign, Datum **elemsp, bool **nullsp, int *nelemsp ) {
+    int nitems = array->ndim > 0 ? array->nitems : 0;
+
+    *elemsp = palloc( sizeof(Datum) * (nitems + 1) );
+    *nullsp = palloc( sizeof(bool) * (nitems + 1) );
+    memcpy( *elemsp, array->values, sizeof(Datum) * nitems );
+    memcpy( *nullsp, array->nulls, sizeof(bool) * nitems );
+    *nelemsp = nitems;
+}
+
+/**
+ * Catalog
+ */
+static const struct {
+    const char  *name;
+    Oid         typid;
+    Oid         array;
+    int16       len;
+    bool        byval;
+    char        align;
+} types[] = {
+    { "bool",        BOOLOID,        BOOLARRAYOID,    1,  true,  'c' },
+    { "int2",        INT2OID,        INT2ARRAYOID,    2,  true,  's' },
+    { "int4",        INT4OID,        INT4ARRAYOID,    4,  true,  'i' },
+    { "int8",        INT8OID,        INT8ARRAYOID,    8,  true,  'd' },
+    { "float4",      FLOAT4OID,      FLOAT4ARRAYOID,  4,  true,  'i' },
+    { "float8",      FLOAT8OID,      FLOAT8ARRAYOID,  8,  true,  'd' },
+    { "numeric",     NUMERICOID,     NUMERICARRAYOID, -1, false, 'i' },
+    { "text",        TEXTOID,        TEXTARRAYOID,    -1, false, 'i' },
+    { "varchar",     VARCHAROID,     VARCHARARRAYOID, -1, false, 'i' },
+    { "json",        JSONOID,        InvalidOid,      -1, false, 'i' },
+    { "date",        DATEOID,        InvalidOid,      4,  true,  'i' },
+    { "timestamp",   TIMESTAMPOID,   InvalidOid,      8,  true,  'd' },
+    { "timestamptz", TIMESTAMPTZOID, InvalidOid,      8,  true,  'd' },
+};
+
+/**
+ * Type OID for a name such as int8 or text[], InvalidOid if unknown
+ */
+Oid
+mock_type_oid( const char *name ) {
+    size_t  len = strlen( name );
+    bool    array = len > 2 && strcmp( name + len - 2, "[]" ) == 0;
+    int     i;
+
+    if( array )
+        len -= 2;
+
+    for( i=0; i < lengthof(types); i++ ) {
+        if( strlen( types[i].name ) == len && strncmp( types[i].name, name, len ) == 0 )
+            return array ? types[i].array : types[i].typid;
+    }
+
+    return InvalidOid;
+}
+
+TupleDesc
+mock_tupdesc( int natts, char **names, Oid *typids ) {
+    TupleDesc   desc = palloc( sizeof(struct tupleDesc) );
+    int         i;
+
+    desc->natts = natts;
+    desc->attrs = palloc( sizeof(Form_pg_attribute) * natts );
+    for( i=0; i < natts; i++ ) {
+        desc->attrs[i] = palloc0( sizeof(FormData_pg_attribute) );
+        snprintf( desc->attrs[i]->attname.data, NAMEDATALEN, "%s", names[i] );
+        desc->attrs[i]->atttypid = typids[i];
+        desc->attrs[i]->atttypmod = -1;
+    }
+
+    return desc;
+}
+
+Oid
+get_element_type( Oid typid ) {
+    int i;
+
+    for( i=0; i < lengthof(types); i++ ) {
+        if( types[i].array != InvalidOid && types[i].array == typid )
+            return types[i].typid;
+    }
+
+    return InvalidOid;
+}
+
+void
+get_typlenbyvalalign( Oid typid, int16 *typlen, bool *typbyval, char *typalign ) {
+    int i;
+
+    for( i=0; i < lengthof(types); i++ ) {
+        if( types[i].typid == typid ) {
+            *typlen = types[i].len;
+            *typbyval = types[i].byval;
+            *typalign = types[i].align;
+            return;
+        }
+    }
+
+    elog( ERROR, "cache lookup failed for type %u", typid );
+}
+
+int
+GetDatabaseEncoding( void ) {
+    return PG_UTF8;
+}
+
+int
+pg_mbstrlen_with_len( const char *mbstr, int limit ) {
+    int i, len = 0;
+
+    for( i=0; i < limit; i++ ) {
+        if( ((unsigned char) mbstr[i] & 0xC0) != 0x80 )
+            len++;
+    }
+
+    return len;
+}
+
+/**
+ * Dates and times, as in the server's datetime.c and timestamp.c
+ */
+const int day_tab[2][13] = {
+    { 31, 28, 31, 30, 31, 30, 31, 31, 30, 31, 30, 31, 0 },
+    { 31, 29, 31, 30, 31, 30, 31, 31, 30, 31, 30, 31, 0 }
+};
+
+#define USECS_PER_SEC INT64CONST(1000000)
+#define USECS_PER_DAY INT64CONST(86400000000)
+
+int
+date2j( int y, int m, int d ) {
+    int julian, century;
+
+    if( m > 2 ) {
+        m += 1;
+        y += 4800;
+    } else {
+        m += 13;
+        y += 4799;
+    }
+
+    century = y / 100;
+    julian = y * 365 - 32167;
+    julian += y / 4 - century + century / 4;
+    julian += 7834 * m / 256 + d;
+
+    return julian;
+}
+
+void
+j2date( int jd, int *year, int *month, int *day ) {
+    unsigned int    julian, quad, extra;
+    int             y;
+
+    julian = jd + 32044;
+    quad = julian / 146097;
+    extra = (julian - quad * 146097) * 4 + 3;
+    julian += 60 + quad * 3 + extra / 146097;
+    quad = julian / 1461;
+    julian -= quad * 1461;
+    y = julian * 4 / 1461;
+    julian = ((y != 0) ? ((julian + 305) % 365) : ((julian + 306) % 366)) + 123;
+    y += quad * 4;
+    *year = y - 4800;
+    quad = julian * 2141 / 65536;
+    *day = julian - 7834 * quad / 256;
+    *month = (quad + 10) % 12 + 1;
+}
+
+/**
+ * *tzp is seconds west of UTC
+ */
+int
+tm2timestamp( struct pg_tm *tm, fsec_t fsec, int *tzp, Timestamp *result ) {
+    int64   date = date2j( tm->tm_year, tm->tm_mon, tm->tm_mday ) - POSTGRES_EPOCH_JDATE;
+    int64   time = ((tm->tm_hour * 60 + tm->tm_min) * 60 + tm->tm_sec) * USECS_PER_SEC + fsec;
+
+    *result = date * USECS_PER_DAY + time;
+    if( tzp )
+        *result += *tzp * USECS_PER_SEC;
+
+    return 0;
+}
+
+/**
+ * The session time zone is UTC
+ */
+int
+timestamp2tm( Timestamp dt, int *tzp, struct pg_tm *tm, fsec_t *fsec, const char **tzn, void *attimezone ) {
+    int64   date = dt / USECS_PER_DAY;
+    int64   time = dt % USECS_PER_DAY;
+
+    if( time < 0 ) {
+        time += USECS_PER_DAY;
+        date--;
+    }
+
+    j2date( (int) (date + POSTGRES_EPOCH_JDATE), &tm->tm_year, &tm->tm_mon, &tm->tm_mday );
+    tm->tm_hour = time / (3600 * USECS_PER_SEC);
+    tm->tm_min = time / (60 * USECS_PER_SEC) % 60;
+    tm->tm_sec = time / USECS_PER_SEC % 60;
+    *fsec = time % USECS_PER_SEC;
+
+    if( tzp )
+        *tzp = 0;
+    if( tzn )
+        *tzn = "UTC";
+
+    return 0;
+}
+
+/**
+ * Type input and output.  Numerics are kept as their text.
+ */
+static void
+invalid_input( const char *type, const char *str ) {
+    ereport( ERROR, (
+        errcode( ERRCODE_INVALID_TEXT_REPRESENTATION ),
+        errmsg( "invalid input syntax for type %s: \"%s\"", type, str )
+    ) );
+}
+
+static Datum
+text_datum( const char *str ) {
+    int     len = strlen( str );
+    text    *result = palloc( VARHDRSZ + len );
+
+    SET_VARSIZE( result, VARHDRSZ + len );
+    memcpy( VARDATA( result ), str, len );
+
+    return PointerGetDatum( result );
+}
+
+static char *
+text_cstring( Datum value ) {
+    text    *txt = (text *) DatumGetPointer( value );
+    int     len = VARSIZE( txt ) - VARHDRSZ;
+    char    *str = palloc( len + 1 );
+
+    memcpy( str, VARDATA( txt ), len );
+    str[len] = '\0';
+
+    return str;
+}
+
+Datum
+textin( PG_FUNCTION_ARGS ) {
+    return text_datum( DatumGetCString( PG_GETARG_DATUM( 0 ) ) );
+}
+
+Datum
+numeric_in( PG_FUNCTION_ARGS ) {
+    char    *str = DatumGetCString( PG_GETARG_DATUM( 0 ) );
+    char    *end;
+
+    strtod( str, &end );
+    if( end == str || *end != '\0' )
+        invalid_input( "numeric", str );
+
+    return text_datum( str );
+}
+
+Datum
+numeric_out( PG_FUNCTION_ARGS ) {
+    return CStringGetDatum( text_cstring( PG_GETARG_DATUM( 0 ) ) );
+}
+
+Datum
+int8_numeric( PG_FUNCTION_ARGS ) {
+    char buf[32];
+
+    snprintf( buf, sizeof(buf), INT64_FORMAT, DatumGetInt64( PG_GETARG_DATUM( 0 ) ) );
+    return text_datum( buf );
+}
+
+Datum
+float8_numeric( PG_FUNCTION_ARGS ) {
+    char buf[32];
+
+    snprintf( buf, sizeof(buf), "%.15g", DatumGetFloat8( PG_GETARG_DATUM( 0 ) ) );
+    return text_datum( buf );
+}
+
+Datum
+date_in( PG_FUNCTION_ARGS ) {
+    char    *str = DatumGetCString( PG_GETARG_DATUM( 0 ) );
+    int     y, m, d, n = 0;
+
+    if( sscanf( str, "%d-%d-%d%n", &y, &m, &d, &n ) != 3 || str[n] != '\0'
+        || m < 1 || m > 12 || d < 1 || d > day_tab[isleap( y )][m - 1] )
+        invalid_input( "date", str );
+
+    return DateADTGetDatum( date2j( y, m, d ) - POSTGRES_EPOCH_JDATE );
+}
+
+Datum
+date_out( PG_FUNCTION_ARGS ) {
+    DateADT date = DatumGetDateADT( PG_GETARG_DATUM( 0 ) );
+    char    *str = palloc( 32 );
+    int     y, m, d;
+
+    if( date == INT32_MIN )
+        return CStringGetDatum( strcpy( str, "-infinity" ) );
+    if( date == INT32_MAX )
+        return CStringGetDatum( strcpy( str, "infinity" ) );
+
+    j2date( date + POSTGRES_EPOCH_JDATE, &y, &m, &d );
+    if( y > 0 )
+        snprintf( str, 32, "%04d-%02d-%02d", y, m, d );
+    else
+        snprintf( str, 32, "%04d-%02d-%02d BC", 1 - y, m, d );
+
+    return CStringGetDatum( str );
+}
+
+/**
+ * YYYY-MM-DD[ T]HH:MM:SS[.ffffff], any zone is taken as UTC
+ */
+static Timestamp
+timestamp_parse( const char *type, char *str ) {
+    struct pg_tm    tm;
+    double          sec = 0;
+    Timestamp       result;
+
+    memset( &tm, 0, sizeof(tm) );
+    if( sscanf( str, "%d-%d-%d%*[ T]%d:%d:%lf", &tm.tm_year, &tm.tm_mon, &tm.tm_mday,
+                &tm.tm_hour, &tm.tm_min, &sec ) < 3
+        || tm.tm_mon < 1 || tm.tm_mon > 12 || tm.tm_mday < 1
+        || tm.tm_mday > day_tab[isleap( tm.tm_year )][tm.tm_mon - 1] )
+        invalid_input( type, str );
+
+    tm.tm_sec = (int) sec;
+    tm2timestamp( &tm, (fsec_t) llround( (sec - tm.tm_sec) * USECS_PER_SEC ), NULL, &result );
+
+    return result;
+}
+
+static Datum
+timestamp_format( Timestamp ts, bool with_tz ) {
+    struct pg_tm    tm;
+    fsec_t          fsec;
+    char            *str = palloc( 64 );
+    int             len;
+
+    if( ts == INT64_MIN )
+        return CStringGetDatum( strcpy( str, "-infinity" ) );
+    if( ts == INT64_MAX )
+        return CStringGetDatum( strcpy( str, "infinity" ) );
+
+    timestamp2tm( ts, NULL, &tm, &fsec, NULL, NULL );
+    len = snprintf( str, 64, "%04d-%02d-%02d %02d:%02d:%02d",
+                    tm.tm_year > 0 ? tm.tm_year : 1 - tm.tm_year, tm.tm_mon, tm.tm_mday,
+                    tm.tm_hour, tm.tm_min, tm.tm_sec );
+    if( fsec != 0 ) {
+        len += snprintf( str + len, 64 - len, ".%06d", (int) fsec );
+        while( str[len - 1] == '0' )
+            str[--len] = '\0';
+    }
+    if( with_tz )
+        len += snprintf( str + len, 64 - len, "+00" );
+    if( tm.tm_year <= 0 )
+        snprintf( str + len, 64 - len, " BC" );
+
+    return CStringGetDatum( str );
+}
+
+Datum
+timestamp_in( PG_FUNCTION_ARGS ) {
+    return TimestampGetDatum( timestamp_parse( "timestamp", DatumGetCString( PG_GETARG_DATUM( 0 ) ) ) );
+}
+
+Datum
+timestamp_out( PG_FUNCTION_ARGS ) {
+    return timestamp_format( DatumGetTimestamp( PG_GETARG_DATUM( 0 ) ), false );
+}
+
+Datum
+timestamptz_in( PG_FUNCTION_ARGS ) {
+    return TimestampTzGetDatum( timestamp_parse( "timestamp with time zone", DatumGetCString( PG_GETARG_DATUM( 0 ) ) ) );
+}
+
+Datum
+timestamptz_out( PG_FUNCTION_ARGS ) {
+    return timestamp_format( DatumGetTimestampTz( PG_GETARG_DATUM( 0 ) ), true );
+}
@@ -0,0 +1,33 @@
+/*
+ * Copyright (c) 2013 Dillon Woods <dewoods@gmail.com>
+ *
+ * greenplum-json-formatter is free software; you can redistribute it and/or modify
+ * it under the terms of the MIT license. See LICENSE for details.
+ */
+
+/**
+ * What the stand-in server offers its driver on top of the server API
+ */
+
+#ifndef PG_MOCK_H
+#define PG_MOCK_H
+
+#include "postgres.h"
+#include "access/tupdesc.h"
+
+/* every palloc, repalloc and context created since the last reset */
+extern uint64 mock_alloc_calls;
+extern uint64 mock_alloc_bytes;
+
+extern void mock_alloc_reset( void );
+
+/* messages from LOG up are printed unless quiet */
+extern bool mock_quiet;
+
+/* end the transaction, running the callbacks registered for it */
+extern void mock_xact_end( void );
+
+extern TupleDesc mock_tupdesc( int natts, char **names, Oid *types );
+extern Oid mock_type_oid( const char *name );
+
+#endif
@@ -0,0 +1,800 @@
+/*
+ * Copyright (c) 2013 Dillon Woods <dewoods@gmail.com>
+ *
+ * greenplum-json-formatter is free software; you can redistribute it and/or modify
+ * it under the terms of the MIT license. See LICENSE for details.
+ */
+
+/**
+ * Formatter throughput without Greenplum
+ *
+ * Links json_formatter_read and json_formatter_write against the stand-in
+ * server in test/mock and drives them the way the format manager does:
+ * input is appended to the data buffer a chunk at a time, unread bytes are
+ * moved to the front after FMT_NEED_MORE_DATA, the per row context is
+ * reset before every call and rejected rows are skipped.  The rows read
+ * are then written back.  Each run reports rows/sec, MB/sec, allocations
+ * per row and peak RSS.
+ *
+ *   mock_bench [-d datadir] [-c chunk,...] [-e engine,...] [-s scale]
+ *              [-o key=value]... [-r seed] [-q] [corpus...]
+ *
+ * Corpora:
+ *   twitter   test/data/twitter.json, its complete lines repeated scale times
+ *   tweets    the same, read into 24 columns
+ *   large     rows with a 4kB escaped text field
+ *   wide      rows with 120 integer columns
+ *   deep      rows nested 12 objects deep
+ *
+ * With -r each chunk handed over is of a random size up to the chunk size,
+ * and the rows of every read are checked against the first read with the
+ * same engine, so a split anywhere must give the same rows.
+ *
+ * With -o compression=gzip the corpus is compressed before it is read;
+ * the rows are written back uncompressed.
+ * Each run is a transaction of its own, so a formatter built with
+ * STATS=yes logs its counters after it.
+ */
+
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/resource.h>
+
+#include <zlib.h>
+
+#include "postgres.h"
+#include "fmgr.h"
+#include "access/formatter.h"
+#include "catalog/pg_type.h"
+#include "utils/memutils.h"
+
+#include "pg_mock.h"
+
+extern void _PG_init( void );
+extern Datum json_formatter_read( PG_FUNCTION_ARGS );
+extern Datum json_formatter_write( PG_FUNCTION_ARGS );
+
+#define MAX_COLUMNS 128
+#define MAX_OPTIONS 16
+#define MAX_RUNS 16
+
+typedef struct {
+    char    *data;
+    long    len;
+    long    cap;
+} buf_t;
+
+typedef struct corpus_t {
+    const char  *name;
+    void        (*generate)( struct corpus_t *c, buf_t *out );
+    int         ncols;
+    char        *names[MAX_COLUMNS];
+    Oid         types[MAX_COLUMNS];
+} corpus_t;
+
+/**
+ * Rows kept from a read, to be written back
+ */
+typedef struct {
+    HeapTupleHeaderData *rows;
+    long                count;
+    long                cap;
+} rows_t;
+
+typedef struct {
+    long    rows;
+    long    errors;
+    long    bytes;
+    double  secs;
+    double  allocs;
+    long    rss_kb;
+} result_t;
+
+static const char   *datadir = "test/data";
+static int          scale = 1;
+static DefElem      options[MAX_OPTIONS];
+static DefElem      *option_ptrs[MAX_OPTIONS + 1];
+static int          noptions = 0;
+static bool         split_random = false;
+static unsigned int split_seed = 1;
+
+static void
+buf_append( buf_t *b, const char *data, long len ) {
+    if( b->len + len > b->cap ) {
+        b->cap = (b->len + len) * 2;
+        b->data = realloc( b->data, b->cap );
+        if( !b->data ) {
+            perror( "realloc" );
+            exit( 1 );
+        }
+    }
+
+    memcpy( b->data + b->len, data, len );
+    b->len += len;
+}
+
+static void
+buf_printf( buf_t *b, const char *fmt, ... ) __attribute__((format(printf, 2, 3)));
+
+static void
+buf_printf( buf_t *b, const char *fmt, ... ) {
+    char    tmp[512];
+    va_list args;
+    int     n;
+
+    va_start( args, fmt );
+    n = vsnprintf( tmp, sizeof(tmp), fmt, args );
+    va_end( args );
+
+    buf_append( b, tmp, n );
+}
+
+static double
+now( void ) {
+    struct timespec ts;
+
+    clock_gettime( CLOCK_MONOTONIC, &ts );
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+/**
+ * Peak RSS is reset before each run where the kernel allows it
+ */
+static void
+rss_reset( void ) {
+    FILE *f = fopen( "/proc/self/clear_refs", "w" );
+
+    if( f ) {
+        fputs( "5", f );
+        fclose( f );
+    }
+}
+
+static long
+rss_peak_kb( void ) {
+    FILE            *f = fopen( "/proc/self/status", "r" );
+    char            line[256];
+    long            kb = -1;
+    struct rusage   ru;
+
+    if( f ) {
+        while( fgets( line, sizeof(line), f ) ) {
+            if( sscanf( line, "VmHWM: %ld kB", &kb ) == 1 )
+                break;
+        }
+        fclose( f );
+    }
+
+    if( kb < 0 && getrusage( RUSAGE_SELF, &ru ) == 0 )
+        kb = ru.ru_maxrss;
+
+    return kb;
+}
+
+static void
+column( corpus_t *c, const char *name, Oid type ) {
+    c->names[c->ncols] = strdup( name );
+    c->types[c->ncols] = type;
+    c->ncols++;
+}
+
+/**
+ * Corpora
+ */
+static void
+load_twitter( buf_t *out ) {
+    char    path[1024];
+    buf_t   file = { NULL, 0, 0 };
+    char    tmp[65536];
+    size_t  n;
+    FILE    *f;
+    int     i;
+
+    snprintf( path, sizeof(path), "%s/twitter.json", datadir );
+    if( !(f = fopen( path, "r" )) ) {
+        perror( path );
+        exit( 1 );
+    }
+    while( (n = fread( tmp, 1, sizeof(tmp), f )) > 0 )
+        buf_append( &file, tmp, n );
+    fclose( f );
+
+    /* the file ends inside an object, which is left for the last copy */
+    for( n = file.len; n > 0 && file.data[n - 1] != '\n'; n-- )
+        ;
+    for( i=0; i < scale; i++ )
+        buf_append( out, file.data, n );
+    buf_append( out, file.data + n, file.len - n );
+    free( file.data );
+}
+
+static void
+generate_twitter( corpus_t *c, buf_t *out ) {
+    load_twitter( out );
+
+    column( c, "id", INT8OID );
+    column( c, "created_at", TEXTOID );
+    column( c, "user.name", TEXTOID );
+    column( c, "user.id", INT8OID );
+    column( c, "text", TEXTOID );
+}
+
+static void
+generate_tweets( corpus_t *c, buf_t *out ) {
+    load_twitter( out );
+
+    column( c, "id", INT8OID );
+    column( c, "id_str", TEXTOID );
+    column( c, "created_at", TEXTOID );
+    column( c, "text", TEXTOID );
+    column( c, "source", TEXTOID );
+    column( c, "truncated", BOOLOID );
+    column( c, "favorited", BOOLOID );
+    column( c, "retweeted", BOOLOID );
+    column( c, "retweet_count", TEXTOID );
+    column( c, "in_reply_to_status_id", INT8OID );
+    column( c, "in_reply_to_user_id", INT8OID );
+    column( c, "in_reply_to_screen_name", TEXTOID );
+    column( c, "user.id", INT8OID );
+    column( c, "user.name", TEXTOID );
+    column( c, "user.screen_name", TEXTOID );
+    column( c, "user.location", TEXTOID );
+    column( c, "user.description", TEXTOID );
+    column( c, "user.lang", TEXTOID );
+    column( c, "user.time_zone", TEXTOID );
+    column( c, "user.utc_offset", INT4OID );
+    column( c, "user.verified", BOOLOID );
+    column( c, "user.followers_count", INT4OID );
+    column( c, "user.friends_count", INT4OID );
+    column( c, "user.statuses_count", INT4OID );
+}
+
+static void
+generate_large( corpus_t *c, buf_t *out ) {
+    buf_t   body = { NULL, 0, 0 };
+    long    i;
+
+    while( body.len < 4096 )
+        buf_printf( &body, "line %ld of a \\\"long\\\" caf\\u00e9 review\\n\\t", body.len );
+
+    for( i=0; i < 2000L * scale; i++ ) {
+        buf_printf( out, "{\"id\":%ld,\"user\":{\"name\":\"user %ld\",\"id\":%ld},\"score\":%ld.25,"
+                         "\"created_at\":\"2013-07-02 16:09:%02ld.838681\",\"body\":\"",
+                    i, i % 997, i % 997, i, i % 60 );
+        buf_append( out, body.data, body.len );
+        buf_printf( out, "\"}\n" );
+    }
+    free( body.data );
+
+    column( c, "id", INT8OID );
+    column( c, "user.name", TEXTOID );
+    column( c, "user.id", INT8OID );
+    column( c, "score", FLOAT8OID );
+    column( c, "created_at", TIMESTAMPOID );
+    column( c, "body", TEXTOID );
+}
+
+static void
+generate_wide( corpus_t *c, buf_t *out ) {
+    char    name[16];
+    long    i;
+    int     j;
+
+    for( i=0; i < 20000L * scale; i++ ) {
+        buf_append( out, "{", 1 );
+        for( j=0; j < 120; j++ )
+            buf_printf( out, "%s\"c%d\":%ld", j ? "," : "", j, i * 131 + j );
+        buf_append( out, "}\n", 2 );
+    }
+
+    for( j=0; j < 120; j++ ) {
+        snprintf( name, sizeof(name), "c%d", j );
+        column( c, name, INT4OID );
+    }
+}
+
+#define DEEP_LEVELS 12
+
+static void
+generate_deep( corpus_t *c, buf_t *out ) {
+    char    name[256];
+    int     len = 0;
+    long    i;
+    int     j;
+
+    for( i=0; i < 20000L * scale; i++ ) {
+        buf_printf( out, "{\"id\":%ld", i );
+        for( j=1; j <= DEEP_LEVELS; j++ )
+            buf_printf( out, ",\"l%d\":{\"x\":%ld", j, i + j );
+        buf_printf( out, ",\"v\":\"leaf %ld\"", i );
+        for( j=1; j <= DEEP_LEVELS; j++ )
+            buf_append( out, "}", 1 );
+        buf_append( out, "}\n", 2 );
+    }
+
+    column( c, "id", INT8OID );
+    for( j=1; j <= DEEP_LEVELS; j++ ) {
+        len += snprintf( name + len, sizeof(name) - len, "%sl%d", j > 1 ? "." : "", j );
+        if( j == 1 || j == DEEP_LEVELS / 2 || j == DEEP_LEVELS ) {
+            snprintf( name + len, sizeof(name) - len, ".x" );
+            column( c, name, INT4OID );
+        }
+    }
+    snprintf( name + len, sizeof(name) - len, ".v" );
+    column( c, name, TEXTOID );
+}
+
+/**
+ * For compression=gzip, the corpus as one gzip member
+ */
+static void
+gzip_corpus( buf_t *input ) {
+    z_stream    zs;
+    buf_t       out = { NULL, 0, 0 };
+
+    memset( &zs, 0, sizeof(zs) );
+    if( deflateInit2( &zs, Z_DEFAULT_COMPRESSION, Z_DEFLATED, 16 + MAX_WBITS, 8, Z_DEFAULT_STRATEGY ) != Z_OK ) {
+        fprintf( stderr, "could not initialize gzip encoder\n" );
+        exit( 1 );
+    }
+
+    out.cap = deflateBound( &zs, input->len );
+    out.data = malloc( out.cap );
+    zs.next_in = (Bytef *) input->data;
+    zs.avail_in = input->len;
+    zs.next_out = (Bytef *) out.data;
+    zs.avail_out = out.cap;
+    if( deflate( &zs, Z_FINISH ) != Z_STREAM_END ) {
+        fprintf( stderr, "could not compress corpus\n" );
+        exit( 1 );
+    }
+    out.len = zs.total_out;
+    deflateEnd( &zs );
+
+    free( input->data );
+    *input = out;
+}
+
+static corpus_t corpora[] = {
+    { "twitter", generate_twitter },
+    { "tweets", generate_tweets },
+    { "large", generate_large },
+    { "wide", generate_wide },
+    { "deep", generate_deep },
+};
+
+/**
+ * Copy a row out of the per row context
+ */
+static void
+rows_add( rows_t *rows, corpus_t *c, HeapTuple tuple ) {
+    HeapTupleHeaderData *row;
+    int                 i;
+
+    if( rows->count == rows->cap ) {
+        rows->cap = rows->cap ? rows->cap * 2 : 1024;
+        rows->rows = realloc( rows->rows, sizeof(HeapTupleHeaderData) * rows->cap );
+    }
+
+    row = &rows->rows[rows->count++];
+    row->natts = c->ncols;
+    row->values = malloc( sizeof(Datum) * c->ncols );
+    row->nulls = malloc( sizeof(bool) * c->ncols );
+
+    for( i=0; i < c->ncols; i++ ) {
+        Datum   value = tuple->t_data->values[i];
+
+        row->nulls[i] = tuple->t_data->nulls[i];
+        if( !row->nulls[i] && (c->types[i] == TEXTOID || c->types[i] == NUMERICOID) ) {
+            int32   size = VARSIZE( DatumGetPointer( value ) );
+            char    *copy = malloc( size );
+
+            memcpy( copy, DatumGetPointer( value ), size );
+            value = PointerGetDatum( copy );
+        }
+        row->values[i] = value;
+    }
+}
+
+/**
+ * Compare the rows of two reads, reporting the first difference
+ */
+static bool
+rows_equal( corpus_t *c, rows_t *a, rows_t *b ) {
+    long    r;
+    int     i;
+
+    if( a->count != b->count ) {
+        fprintf( stderr, "%s: %ld rows read, expected %ld\n", c->name, b->count, a->count );
+        return false;
+    }
+
+    for( r=0; r < a->count; r++ ) {
+        for( i=0; i < c->ncols; i++ ) {
+            Datum   x = a->rows[r].values[i];
+            Datum   y = b->rows[r].values[i];
+            bool    same;
+
+            if( a->rows[r].nulls[i] || b->rows[r].nulls[i] )
+                same = (a->rows[r].nulls[i] == b->rows[r].nulls[i]);
+            else if( c->types[i] == TEXTOID || c->types[i] == NUMERICOID )
+                same = (VARSIZE( DatumGetPointer( x ) ) == VARSIZE( DatumGetPointer( y ) ) &&
+                        memcmp( DatumGetPointer( x ), DatumGetPointer( y ), VARSIZE( DatumGetPointer( x ) ) ) == 0);
+            else
+                same = (x == y);
+
+            if( !same ) {
+                fprintf( stderr, "%s: row %ld column %s differs\n", c->name, r + 1, c->names[i] );
+                return false;
+            }
+        }
+    }
+
+    return true;
+}
+
+static void
+rows_free( rows_t *rows, corpus_t *c ) {
+    long    r;
+    int     i;
+
+    for( r=0; r < rows->count; r++ ) {
+        for( i=0; i < c->ncols; i++ ) {
+            if( !rows->rows[r].nulls[i] && (c->types[i] == TEXTOID || c->types[i] == NUMERICOID) )
+                free( DatumGetPointer( rows->rows[r].values[i] ) );
+        }
+        free( rows->rows[r].values );
+        free( rows->rows[r].nulls );
+    }
+    free( rows->rows );
+}
+
+static List *
+formatter_args( const char *engine ) {
+    static DefElem  engine_opt = { "engine", NULL };
+    static List     args;
+    int             i, n = 0;
+
+    if( engine ) {
+        engine_opt.arg = (char *) engine;
+        option_ptrs[n++] = &engine_opt;
+    }
+    for( i=0; i < noptions; i++ ) {
+        /* only reads are compressed */
+        if( !engine && strcmp( options[i].defname, "compression" ) == 0 )
+            continue;
+        option_ptrs[n++] = &options[i];
+    }
+
+    args.length = n;
+    args.elements = option_ptrs;
+
+    return &args;
+}
+
+/**
+ * Read the corpus in chunks, keeping the rows if asked to
+ */
+static bool
+run_read( corpus_t *c, buf_t *input, TupleDesc tupdesc, const char *engine, int chunk, rows_t *keep, result_t *res ) {
+    FormatterData           fd;
+    FunctionCallInfoData    fcinfo;
+    MemoryContext           scan_ctx, row_ctx;
+    jmp_buf                 jb;
+    char                    *buf;
+    int                     cap = chunk * 2;
+    long                    pos = 0;
+    bool                    need = true;
+    unsigned int            seed = split_seed;
+    double                  start;
+
+    memset( &fd, 0, sizeof(fd) );
+    memset( &fcinfo, 0, sizeof(fcinfo) );
+    memset( res, 0, sizeof(*res) );
+    fcinfo.context = &fd;
+    buf = malloc( cap );
+
+    scan_ctx = AllocSetContextCreate( TopMemoryContext, "scan", ALLOCSET_DEFAULT_MINSIZE,
+                                      ALLOCSET_DEFAULT_INITSIZE, ALLOCSET_DEFAULT_MAXSIZE );
+    row_ctx = AllocSetContextCreate( scan_ctx, "per row", ALLOCSET_DEFAULT_MINSIZE,
+                                     ALLOCSET_DEFAULT_INITSIZE, ALLOCSET_DEFAULT_MAXSIZE );
+    fd.fmt_tupDesc = tupdesc;
+    fd.fmt_args = formatter_args( engine );
+    fd.fmt_perrow_ctx = row_ctx;
+    fd.fmt_databuf = buf;
+
+    rss_reset();
+    mock_alloc_reset();
+    start = now();
+
+    for( ;; ) {
+        if( need ) {
+            int keep_len = fd.fmt_databuf_len - fd.fmt_databuf_cur;
+            int size = split_random ? 1 + rand_r( &seed ) % chunk : chunk;
+            int n = (int) Min( (long) size, input->len - pos );
+
+            memmove( buf, buf + fd.fmt_databuf_cur, keep_len );
+            if( keep_len + n > cap ) {
+                cap = (keep_len + n) * 2;
+                buf = realloc( buf, cap );
+            }
+            memcpy( buf + keep_len, input->data + pos, n );
+            pos += n;
+
+            fd.fmt_databuf = buf;
+            fd.fmt_databuf_len = keep_len + n;
+            fd.fmt_databuf_cur = 0;
+            fd.fmt_saw_eof = (pos == input->len);
+            need = false;
+        }
+
+        MemoryContextReset( row_ctx );
+        CurrentMemoryContext = scan_ctx;
+        fd.fmt_notification = FMT_NONE;
+        fd.fmt_badrow_len = 0;
+        fd.fmt_tuple = NULL;
+
+        if( setjmp( jb ) != 0 ) {
+            PG_exception_stack = NULL;
+            if( fd.fmt_badrow_len <= 0 ) {
+                fprintf( stderr, "%s: %s\n", c->name, mock_errmsg );
+                MemoryContextDelete( scan_ctx );
+                free( buf );
+                return false;
+            }
+
+            /* rejected, as with SEGMENT REJECT LIMIT */
+            res->errors++;
+            fd.fmt_databuf_cur = Min( fd.fmt_databuf_cur + fd.fmt_badrow_len, fd.fmt_databuf_len );
+            continue;
+        }
+
+        PG_exception_stack = &jb;
+        json_formatter_read( &fcinfo );
+        PG_exception_stack = NULL;
+
+        if( fd.fmt_notification == FMT_NEED_MORE_DATA ) {
+            if( fd.fmt_saw_eof )
+                break;
+            need = true;
+            continue;
+        }
+
+        res->rows++;
+        if( keep )
+            rows_add( keep, c, fd.fmt_tuple );
+    }
+
+    res->secs = now() - start;
+    res->bytes = input->len;
+    res->allocs = res->rows ? (double) mock_alloc_calls / res->rows : 0;
+    res->rss_kb = rss_peak_kb();
+
+    MemoryContextDelete( scan_ctx );
+    free( buf );
+    mock_xact_end();
+
+    return true;
+}
+
+static bool
+run_write( corpus_t *c, rows_t *rows, TupleDesc tupdesc, result_t *res ) {
+    FormatterData           fd;
+    FunctionCallInfoData    fcinfo;
+    MemoryContext           scan_ctx, row_ctx;
+    jmp_buf                 jb;
+    double                  start;
+    long                    r;
+
+    memset( &fd, 0, sizeof(fd) );
+    memset( &fcinfo, 0, sizeof(fcinfo) );
+    memset( res, 0, sizeof(*res) );
+    fcinfo.context = &fd;
+    fcinfo.nargs = 1;
+
+    scan_ctx = AllocSetContextCreate( TopMemoryContext, "scan", ALLOCSET_DEFAULT_MINSIZE,
+                                      ALLOCSET_DEFAULT_INITSIZE, ALLOCSET_DEFAULT_MAXSIZE );
+    row_ctx = AllocSetContextCreate( scan_ctx, "per row", ALLOCSET_DEFAULT_MINSIZE,
+                                     ALLOCSET_DEFAULT_INITSIZE, ALLOCSET_DEFAULT_MAXSIZE );
+    fd.fmt_tupDesc = tupdesc;
+    fd.fmt_args = formatter_args( NULL );
+    fd.fmt_perrow_ctx = row_ctx;
+
+    rss_reset();
+    mock_alloc_reset();
+    start = now();
+
+    if( setjmp( jb ) != 0 ) {
+        PG_exception_stack = NULL;
+        fprintf( stderr, "%s: %s\n", c->name, mock_errmsg );
+        MemoryContextDelete( scan_ctx );
+        return false;
+    }
+    PG_exception_stack = &jb;
+
+    for( r=0; r < rows->count; r++ ) {
+        bytea   *out;
+
+        MemoryContextReset( row_ctx );
+        CurrentMemoryContext = scan_ctx;
+        fcinfo.arg[0] = PointerGetDatum( &rows->rows[r] );
+
+        out = (bytea *) DatumGetPointer( json_formatter_write( &fcinfo ) );
+        res->bytes += VARSIZE( out ) - VARHDRSZ;
+        res->rows++;
+    }
+
+    PG_exception_stack = NULL;
+
+    res->secs = now() - start;
+    res->allocs = res->rows ? (double) mock_alloc_calls / res->rows : 0;
+    res->rss_kb = rss_peak_kb();
+
+    MemoryContextDelete( scan_ctx );
+    mock_xact_end();
+
+    return true;
+}
+
+static void
+report( corpus_t *c, const char *op, const char *engine, int chunk, result_t *res ) {
+    double  secs = res->secs > 0 ? res->secs : 1e-9;
+    char    chunk_str[16] = "-";
+
+    if( chunk > 0 )
+        snprintf( chunk_str, sizeof(chunk_str), split_random ? "1-%d" : "%d", chunk );
+
+    printf( "%-8s %-5s %-7s %8s %9ld rows %5ld err %8.1f MB %7.3f s %10.0f rows/s %7.1f MB/s %7.1f allocs/row %7ld kB rss\n",
+            c->name, op, engine, chunk_str, res->rows, res->errors, res->bytes / 1048576.0, res->secs,
+            res->rows / secs, res->bytes / 1048576.0 / secs, res->allocs, res->rss_kb );
+    fflush( stdout );
+}
+
+static int
+split_list( char *s, char **out, int max ) {
+    int n = 0;
+
+    for( s = strtok( s, "," ); s && n < max; s = strtok( NULL, "," ) )
+        out[n++] = s;
+
+    return n;
+}
+
+static void
+usage( void ) {
+    fprintf( stderr, "usage: mock_bench [-d datadir] [-c chunk,...] [-e engine,...] [-s scale] [-o key=value]... [-r seed] [-q] [corpus...]\n" );
+    exit( 2 );
+}
+
+int
+main( int argc, char **argv ) {
+    char    default_chunks[] = "65536";
+    char    default_engines[] = "jansson,sax";
+    char    *chunk_list = default_chunks;
+    char    *engine_list = default_engines;
+    char    *chunk_strs[MAX_RUNS];
+    char    *engines[MAX_RUNS];
+    int     chunks[MAX_RUNS];
+    int     nchunks, nengines;
+    bool    gzip = false;
+    int     status = 0;
+    int     opt, i, e, k;
+
+    while( (opt = getopt( argc, argv, "d:c:e:s:o:r:q" )) != -1 ) {
+        switch( opt ) {
+            case 'd':
+                datadir = optarg;
+                break;
+            case 'c':
+                chunk_list = optarg;
+                break;
+            case 'e':
+                engine_list = optarg;
+                break;
+            case 's':
+                scale = atoi( optarg );
+                break;
+            case 'o': {
+                char *eq = strchr( optarg, '=' );
+
+                if( !eq || noptions == MAX_OPTIONS )
+                    usage();
+                *eq = '\0';
+                options[noptions].defname = optarg;
+                options[noptions].arg = eq + 1;
+                noptions++;
+                if( strcmp( optarg, "compression" ) == 0 )
+                    gzip = (strcmp( eq + 1, "gzip" ) == 0);
+                break;
+            }
+            case 'r':
+                split_random = true;
+                split_seed = strtoul( optarg, NULL, 10 );
+                break;
+            case 'q':
+                mock_quiet = true;
+                break;
+            default:
+                usage();
+        }
+    }
+
+    nchunks = split_list( chunk_list, chunk_strs, MAX_RUNS );
+    for( k=0; k < nchunks; k++ ) {
+        chunks[k] = atoi( chunk_strs[k] );
+        if( chunks[k] <= 0 )
+            usage();
+    }
+    nengines = split_list( engine_list, engines, MAX_RUNS );
+    if( scale <= 0 || nchunks == 0 || nengines == 0 )
+        usage();
+
+    _PG_init();
+
+    for( i=0; i < lengthof(corpora); i++ ) {
+        corpus_t    *c = &corpora[i];
+        buf_t       input = { NULL, 0, 0 };
+        rows_t      rows = { NULL, 0, 0 };
+        TupleDesc   tupdesc;
+        result_t    res;
+
+        if( optind < argc ) {
+            int a;
+
+            for( a=optind; a < argc; a++ ) {
+                if( strcmp( argv[a], c->name ) == 0 )
+                    break;
+            }
+            if( a == argc )
+                continue;
+        }
+
+        c->generate( c, &input );
+        if( gzip )
+            gzip_corpus( &input );
+        tupdesc = mock_tupdesc( c->ncols, c->names, c->types );
+
+        for( e=0; e < nengines; e++ ) {
+            rows_t  first = { NULL, 0, 0 };
+
+            for( k=0; k < nchunks; k++ ) {
+                rows_t  split = { NULL, 0, 0 };
+                rows_t  *keep = NULL;
+
+                /* the rows of the first read with each engine are the reference */
+                if( k == 0 )
+                    keep = (e == 0) ? &rows : &first;
+                else if( split_random )
+                    keep = &split;
+
+                if( !run_read( c, &input, tupdesc, engines[e], chunks[k], keep, &res ) ) {
+                    status = 1;
+                    rows_free( &split, c );
+                    continue;
+                }
+                report( c, "read", engines[e], chunks[k], &res );
+
+                if( k > 0 && split_random && !rows_equal( c, (e == 0) ? &rows : &first, &split ) )
+                    status = 1;
+                rows_free( &split, c );
+            }
+            rows_free( &first, c );
+        }
+
+        if( rows.count > 0 ) {
+            if( run_write( c, &rows, tupdesc, &res ) )
+                report( c, "write", "-", 0, &res );
+            else
+                status = 1;
+        }
+
+        rows_free( &rows, c );
+        free( input.data );
+    }
+
+    return status;
+}
@@ -0,0 +1,32 @@
+DROP SCHEMA IF EXISTS __json_formatter_rss CASCADE;
+CREATE SCHEMA __json_formatter_rss;
+
+SET search_path TO __json_formatter_rss;
+
+CREATE EXTERNAL TABLE rss_jansson (
+    id bigint,
+    created_at text,
+    "user.name" text,
+    "user.id" bigint,
+    "text" text,
+    entities text
+) LOCATION (
+    'gpfdist://localhost:8081/out/rss.json'
+) FORMAT 'custom' (
+    formatter=json_formatter_read,
+    engine='jansson'
+) SEGMENT REJECT LIMIT 100 PERCENT;
+
+CREATE EXTERNAL TABLE rss_sax (
+    id bigint,
+    created_at text,
+    "user.name" text,
+    "user.id" bigint,
+    "text" text,
+    entities text
+) LOCATION (
+    'gpfdist://localhost:8081/out/rss.json'
+) FORMAT 'custom' (
+    formatter=json_formatter_read,
+    engine='sax'
+) SEGMENT REJECT LIMIT 100 PERCENT;
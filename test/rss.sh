@@ -0,0 +1,60 @@
+#!/bin/sh
+#
+# Long running load that reports the peak resident set size of every
+# segment backend while each engine reads the same large file.  Memory
+# that grows with the number of rows read shows up as a peak that grows
+# with REPEAT.  Needs a running gpfdist (test/gpfdist.sh), the formatter
+# installed like test/test.sh, and the segments running on this host.
+#
+#   REPEAT=5000 sh test/rss.sh
+#
+
+SCHEMA_NAME=__json_formatter_rss
+REPEAT=${REPEAT:-1000}
+INTERVAL=${INTERVAL:-0.5}
+DATA=test/out/rss.json
+SAMPLES=/tmp/json_formatter_rss.$$
+
+mkdir -p test/out
+rm -f $DATA
+i=0
+while [ $i -lt $REPEAT ]
+do
+    cat test/data/twitter.json.100 >> $DATA
+    i=`expr $i + 1`
+done
+
+psql -q -f test/rss.ddl.sql 2> /dev/null
+
+rss() {
+    table=$1
+
+    rm -f $SAMPLES
+    psql -tA -c "select count(*) from $SCHEMA_NAME.$table" > /dev/null 2>&1 &
+    query=$!
+
+    while kill -0 $query 2> /dev/null
+    do
+        # segment backends are titled "... conN segN ... MPPEXEC SELECT"
+        ps -eo rss=,args= | grep 'MPPEXEC' | grep -v grep >> $SAMPLES
+        sleep $INTERVAL
+    done
+    wait $query
+
+    awk -v table=$table -v rows=`expr $REPEAT \* 100` '
+        match( $0, /seg[0-9]+/ ) {
+            seg = substr( $0, RSTART, RLENGTH )
+            if( $1 > peak[seg] ) peak[seg] = $1
+        }
+        END {
+            for( seg in peak )
+                printf "%-16s %10d rows  %-6s %10d kB peak rss\n", table, rows, seg, peak[seg]
+        }' $SAMPLES | sort
+
+    rm -f $SAMPLES
+}
+
+rss rss_jansson
+rss rss_sax
+
+rm -f $DATA
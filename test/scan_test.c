@@ -0,0 +1,215 @@
+/*
+ * Copyright (c) 2013 Dillon Woods <dewoods@gmail.com>
+ *
+ * greenplum-json-formatter is free software; you can redistribute it and/or modify
+ * it under the terms of the MIT license. See LICENSE for details.
+ */
+
+/**
+ * Object splitting under randomized reads
+ *
+ * Feeds each fixture to json_scan_next the way the format manager feeds
+ * json_formatter_read: data is appended to a buffer in chunks, unconsumed
+ * bytes are moved to the front after every JSON_SCAN_MORE, and the scanner
+ * state is carried across calls.  Every chunking must split the file into
+ * exactly the same objects as reading it in one go, and no byte may be
+ * scanned twice.  With -n the files are split as newline delimited JSON
+ * with json_scan_line instead.
+ *
+ *   scan_test [-n] [-i iterations] [-s seed] file...
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "json_scan.h"
+
+typedef struct {
+    long    *offsets;
+    int     *lengths;
+    int     count;
+    int     cap;
+    long    invalid_at;     /* offset of a non-object byte, -1 if none */
+    long    truncated_at;   /* offset of an object cut off by EOF, -1 if none */
+    long    scanned;        /* bytes examined by the scanner */
+} split_t;
+
+static int ndjson = 0;
+
+static void
+split_add( split_t *out, long offset, int length ) {
+    if( out->count == out->cap ) {
+        out->cap = out->cap ? out->cap * 2 : 1024;
+        out->offsets = realloc( out->offsets, sizeof(long) * out->cap );
+        out->lengths = realloc( out->lengths, sizeof(int) * out->cap );
+    }
+
+    out->offsets[out->count] = offset;
+    out->lengths[out->count] = length;
+    out->count++;
+}
+
+/**
+ * Split data into objects, reading it in chunks of 1..max_chunk bytes
+ */
+static void
+split( const char *data, long size, int max_chunk, split_t *out ) {
+    json_scan_state_t   st;
+    char                *buf = malloc( size + 1 );
+    int                 buf_len = 0;
+    int                 buf_cur = 0;
+    long                base = 0;       /* file offset of buf[0] */
+    long                read = 0;
+
+    memset( out, 0, sizeof(split_t) );
+    out->invalid_at = -1;
+    out->truncated_at = -1;
+
+    json_scan_init( &st );
+
+    while( read < size ) {
+        int chunk = max_chunk > 1 ? 1 + rand() % max_chunk : 1;
+
+        if( chunk > size - read )
+            chunk = size - read;
+
+        memcpy( buf + buf_len, data + read, chunk );
+        buf_len += chunk;
+        read += chunk;
+
+        for( ;; ) {
+            int                 skip, objlen = 0;
+            int                 pos = st.pos;
+            json_scan_result_t  res;
+
+            if( ndjson )
+                res = json_scan_line( &st, buf + buf_cur, buf_len - buf_cur, read == size, &skip, &objlen );
+            else
+                res = json_scan_next( &st, buf + buf_cur, buf_len - buf_cur, &skip, &objlen );
+            buf_cur += skip;
+
+            if( res == JSON_SCAN_INVALID ) {
+                out->invalid_at = base + buf_cur;
+                free( buf );
+                return;
+            }
+
+            if( res == JSON_SCAN_MORE ) {
+                if( st.pos > 0 )
+                    out->scanned += st.pos - pos;
+
+                /* the format manager keeps only the unconsumed bytes */
+                memmove( buf, buf + buf_cur, buf_len - buf_cur );
+                buf_len -= buf_cur;
+                base += buf_cur;
+                buf_cur = 0;
+                break;
+            }
+
+            out->scanned += objlen - pos;
+            split_add( out, base + buf_cur, objlen );
+            buf_cur += objlen;
+        }
+    }
+
+    if( st.pos > 0 )
+        out->truncated_at = base + buf_cur;
+
+    free( buf );
+}
+
+static int
+same_split( const split_t *a, const split_t *b ) {
+    return a->count == b->count
+        && a->invalid_at == b->invalid_at
+        && a->truncated_at == b->truncated_at
+        && memcmp( a->offsets, b->offsets, sizeof(long) * a->count ) == 0
+        && memcmp( a->lengths, b->lengths, sizeof(int) * a->count ) == 0;
+}
+
+static char *
+read_file( const char *path, long *size ) {
+    FILE    *f = fopen( path, "rb" );
+    char    *data;
+
+    if( !f ) {
+        perror( path );
+        exit( 2 );
+    }
+
+    fseek( f, 0, SEEK_END );
+    *size = ftell( f );
+    fseek( f, 0, SEEK_SET );
+
+    data = malloc( *size + 1 );
+    if( fread( data, 1, *size, f ) != (size_t)*size ) {
+        perror( path );
+        exit( 2 );
+    }
+    fclose( f );
+
+    return data;
+}
+
+int
+main( int argc, char **argv ) {
+    static const int    max_chunks[] = { 1, 2, 7, 64, 1000, 32768 };
+    int                 iterations = 20;
+    unsigned int        seed = 1;
+    int                 failed = 0;
+    int                 opt, f;
+
+    while( (opt = getopt( argc, argv, "ni:s:" )) != -1 ) {
+        switch( opt ) {
+            case 'n': ndjson = 1; break;
+            case 'i': iterations = atoi( optarg ); break;
+            case 's': seed = strtoul( optarg, NULL, 10 ); break;
+            default:
+                fprintf( stderr, "usage: %s [-n] [-i iterations] [-s seed] file...\n", argv[0] );
+                return 2;
+        }
+    }
+
+    srand( seed );
+    printf( "scanner: %s, seed %u\n", ndjson ? "ndjson" : json_scan_impl_name(), seed );
+
+    for( f = optind; f < argc; f++ ) {
+        split_t     expected;
+        long        size;
+        char        *data = read_file( argv[f], &size );
+        int         it, bad = 0;
+
+        split( data, size, size > 0 ? size : 1, &expected );
+
+        for( it=0; it < iterations; it++ ) {
+            split_t     got;
+            int         max_chunk = max_chunks[it % (sizeof(max_chunks) / sizeof(max_chunks[0]))];
+
+            split( data, size, max_chunk, &got );
+
+            if( !same_split( &expected, &got ) ) {
+                fprintf( stderr, "%s: split differs with chunks of up to %d bytes (%d objects, expected %d)\n",
+                    argv[f], max_chunk, got.count, expected.count );
+                bad = 1;
+            } else if( got.scanned > size ) {
+                fprintf( stderr, "%s: scanned %ld bytes of %ld with chunks of up to %d bytes\n",
+                    argv[f], got.scanned, size, max_chunk );
+                bad = 1;
+            }
+
+            free( got.offsets );
+            free( got.lengths );
+        }
+
+        printf( "%-32s %6d objects  %s\n", argv[f], expected.count, bad ? "FAIL" : "ok" );
+
+        failed |= bad;
+        free( expected.offsets );
+        free( expected.lengths );
+        free( data );
+    }
+
+    return failed;
+}
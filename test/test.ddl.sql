@@ -88,6 +88,314 @@ CREATE EXTERNAL TABLE nested (
     formatter=json_formatter_read
 );
 
+DROP EXTERNAL TABLE IF EXISTS types_sax;
+CREATE EXTERNAL TABLE types_sax (
+    id int,
+    i2 int2,
+    i4 int4,
+    i8 int8,
+    t text,
+    v varchar(255),
+    ts text,
+    f4 float4,
+    f8 float8
+) LOCATION (
+    'gpfdist://localhost:8081/data/types.dat'
+) FORMAT 'custom' (
+    formatter=json_formatter_read,
+    engine='sax'
+);
+
+DROP EXTERNAL TABLE IF EXISTS types_columns;
+CREATE EXTERNAL TABLE types_columns (
+    id int,
+    i2 int2,
+    i4 int4,
+    i8 int8,
+    t text,
+    v varchar(255),
+    ts text,
+    f4 float4,
+    f8 float8
+) LOCATION (
+    'gpfdist://localhost:8081/data/types.dat'
+) FORMAT 'custom' (
+    formatter=json_formatter_read,
+    engine='jansson',
+    columns='id, t, f8'
+);
+
+DROP EXTERNAL TABLE IF EXISTS types_columns_sax;
+CREATE EXTERNAL TABLE types_columns_sax (
+    id int,
+    i2 int2,
+    i4 int4,
+    i8 int8,
+    t text,
+    v varchar(255),
+    ts text,
+    f4 float4,
+    f8 float8
+) LOCATION (
+    'gpfdist://localhost:8081/data/types.dat'
+) FORMAT 'custom' (
+    formatter=json_formatter_read,
+    engine='sax',
+    columns='id, t, f8'
+);
+
+DROP EXTERNAL TABLE IF EXISTS nested_sax;
+CREATE EXTERNAL TABLE nested_sax (
+    id int,
+    "sub.subid" int,
+    "sub.subsub.subsubid" int
+) LOCATION (
+    'gpfdist://localhost:8081/data/nested.dat'
+) FORMAT 'custom' (
+    formatter=json_formatter_read,
+    engine='sax'
+);
+
+DROP EXTERNAL TABLE IF EXISTS twitter100_sax;
+CREATE EXTERNAL TABLE twitter100_sax (
+    id bigint,
+    created_at text,
+    "user.name" text,
+    "user.id" bigint,
+    "user.friends_count" int,
+    "text" text
+) LOCATION (
+    'gpfdist://localhost:8081/data/twitter.json.100'
+) FORMAT 'custom' (
+    formatter=json_formatter_read,
+    engine='sax'
+) LOG ERRORS INTO twitter100_sax_err SEGMENT REJECT LIMIT 25 ROWS;
+
+DROP EXTERNAL TABLE IF EXISTS twitter100_threads;
+CREATE EXTERNAL TABLE twitter100_threads (
+    id bigint,
+    created_at text,
+    "user.name" text,
+    "user.id" bigint,
+    "user.friends_count" int,
+    "text" text
+) LOCATION (
+    'gpfdist://localhost:8081/data/twitter.json.100'
+) FORMAT 'custom' (
+    formatter=json_formatter_read,
+    threads='4'
+) LOG ERRORS INTO twitter100_threads_err SEGMENT REJECT LIMIT 25 ROWS;
+
+DROP EXTERNAL TABLE IF EXISTS twitter100_ndjson;
+CREATE EXTERNAL TABLE twitter100_ndjson (
+    id bigint,
+    created_at text,
+    "user.name" text,
+    "user.id" bigint,
+    "user.friends_count" int,
+    "text" text
+) LOCATION (
+    'gpfdist://localhost:8081/data/twitter.json.100'
+) FORMAT 'custom' (
+    formatter=json_formatter_read,
+    engine='sax',
+    framing='ndjson'
+) LOG ERRORS INTO twitter100_ndjson_err SEGMENT REJECT LIMIT 25 ROWS;
+
+DROP EXTERNAL TABLE IF EXISTS ndjson_error;
+CREATE EXTERNAL TABLE ndjson_error (
+    id int,
+    t text
+) LOCATION (
+    'gpfdist://localhost:8081/data/ndjson_error.dat'
+) FORMAT 'custom' (
+    formatter=json_formatter_read,
+    engine='sax',
+    framing='ndjson'
+) LOG ERRORS INTO ndjson_error_err SEGMENT REJECT LIMIT 25 ROWS;
+
+DROP EXTERNAL TABLE IF EXISTS convert;
+CREATE EXTERNAL TABLE convert (
+    id int,
+    i2 int2,
+    d date,
+    ts timestamp,
+    tz timestamptz,
+    n numeric,
+    b boolean,
+    v varchar(5)
+) LOCATION (
+    'gpfdist://localhost:8081/data/convert.dat'
+) FORMAT 'custom' (
+    formatter=json_formatter_read
+) LOG ERRORS INTO convert_err SEGMENT REJECT LIMIT 25 ROWS;
+
+DROP EXTERNAL TABLE IF EXISTS convert_sax;
+CREATE EXTERNAL TABLE convert_sax (
+    id int,
+    i2 int2,
+    d date,
+    ts timestamp,
+    tz timestamptz,
+    n numeric,
+    b boolean,
+    v varchar(5)
+) LOCATION (
+    'gpfdist://localhost:8081/data/convert.dat'
+) FORMAT 'custom' (
+    formatter=json_formatter_read,
+    engine='sax'
+) LOG ERRORS INTO convert_sax_err SEGMENT REJECT LIMIT 25 ROWS;
+
+DROP EXTERNAL TABLE IF EXISTS convert_threads;
+CREATE EXTERNAL TABLE convert_threads (
+    id int,
+    i2 int2,
+    d date,
+    ts timestamp,
+    tz timestamptz,
+    n numeric,
+    b boolean,
+    v varchar(5)
+) LOCATION (
+    'gpfdist://localhost:8081/data/convert.dat'
+) FORMAT 'custom' (
+    formatter=json_formatter_read,
+    engine='sax',
+    threads='2'
+) LOG ERRORS INTO convert_threads_err SEGMENT REJECT LIMIT 25 ROWS;
+
+DROP EXTERNAL TABLE IF EXISTS raw;
+CREATE EXTERNAL TABLE raw (
+    id int,
+    e text
+) LOCATION (
+    'gpfdist://localhost:8081/data/raw.dat'
+) FORMAT 'custom' (
+    formatter=json_formatter_read
+);
+
+DROP EXTERNAL TABLE IF EXISTS raw_minify;
+CREATE EXTERNAL TABLE raw_minify (
+    id int,
+    e text
+) LOCATION (
+    'gpfdist://localhost:8081/data/raw.dat'
+) FORMAT 'custom' (
+    formatter=json_formatter_read,
+    engine='sax',
+    minify='true'
+);
+
+DROP EXTERNAL TABLE IF EXISTS filter;
+CREATE EXTERNAL TABLE filter (
+    id int,
+    "event.type" text,
+    "event.amount" text
+) LOCATION (
+    'gpfdist://localhost:8081/data/filter.dat'
+) FORMAT 'custom' (
+    formatter=json_formatter_read,
+    engine='jansson',
+    filter='event.type=purchase'
+);
+
+DROP EXTERNAL TABLE IF EXISTS filter_range;
+CREATE EXTERNAL TABLE filter_range (
+    id int,
+    "event.type" text,
+    "event.amount" text
+) LOCATION (
+    'gpfdist://localhost:8081/data/filter.dat'
+) FORMAT 'custom' (
+    formatter=json_formatter_read,
+    engine='sax',
+    filter='event.type=purchase; event.amount>=10'
+);
+
+DROP EXTERNAL TABLE IF EXISTS filter_exact;
+CREATE EXTERNAL TABLE filter_exact (
+    id int,
+    "event.type" text,
+    "event.amount" text
+) LOCATION (
+    'gpfdist://localhost:8081/data/filter.dat'
+) FORMAT 'custom' (
+    formatter=json_formatter_read,
+    engine='sax',
+    filter='event.type="a;b"; event.amount=104644726506012673'
+);
+
+DROP EXTERNAL TABLE IF EXISTS unnest;
+CREATE EXTERNAL TABLE unnest (
+    id int,
+    name text,
+    "items.sku" text,
+    "items.qty" int
+) LOCATION (
+    'gpfdist://localhost:8081/data/unnest.dat'
+) FORMAT 'custom' (
+    formatter=json_formatter_read,
+    unnest='items'
+);
+
+DROP EXTERNAL TABLE IF EXISTS array;
+CREATE EXTERNAL TABLE array (
+    id int,
+    name text
+) LOCATION (
+    'gpfdist://localhost:8081/data/array.dat'
+) FORMAT 'custom' (
+    formatter=json_formatter_read
+);
+
+DROP EXTERNAL TABLE IF EXISTS array_nested;
+CREATE EXTERNAL TABLE array_nested (
+    id int,
+    name text
+) LOCATION (
+    'gpfdist://localhost:8081/data/array_nested.dat'
+) FORMAT 'custom' (
+    formatter=json_formatter_read
+);
+
+DROP EXTERNAL TABLE IF EXISTS array_unclosed;
+CREATE EXTERNAL TABLE array_unclosed (
+    id int,
+    name text
+) LOCATION (
+    'gpfdist://localhost:8081/data/array_unclosed.dat'
+) FORMAT 'custom' (
+    formatter=json_formatter_read
+);
+
+DROP EXTERNAL TABLE IF EXISTS arrays;
+CREATE EXTERNAL TABLE arrays (
+    id int,
+    tags text[],
+    ids int8[],
+    f float8[],
+    n numeric[]
+) LOCATION (
+    'gpfdist://localhost:8081/data/arrays.dat'
+) FORMAT 'custom' (
+    formatter=json_formatter_read
+) LOG ERRORS INTO arrays_err SEGMENT REJECT LIMIT 25 ROWS;
+
+DROP EXTERNAL TABLE IF EXISTS arrays_sax;
+CREATE EXTERNAL TABLE arrays_sax (
+    id int,
+    tags text[],
+    ids int8[],
+    f float8[],
+    n numeric[]
+) LOCATION (
+    'gpfdist://localhost:8081/data/arrays.dat'
+) FORMAT 'custom' (
+    formatter=json_formatter_read,
+    engine='sax'
+) LOG ERRORS INTO arrays_sax_err SEGMENT REJECT LIMIT 25 ROWS;
+
 DROP EXTERNAL TABLE IF EXISTS out_basic;
 CREATE WRITABLE EXTERNAL TABLE out_basic (
     id int
@@ -114,6 +422,31 @@ CREATE WRITABLE EXTERNAL TABLE out_types (
     formatter=json_formatter_write
 );
 
+DROP EXTERNAL TABLE IF EXISTS out_convert;
+CREATE WRITABLE EXTERNAL TABLE out_convert (
+    id int,
+    n numeric,
+    d date,
+    ts timestamp,
+    b boolean
+) LOCATION (
+    'gpfdist://localhost:8081/out/convert.dat'
+) FORMAT 'custom' (
+    formatter=json_formatter_write
+);
+
+DROP EXTERNAL TABLE IF EXISTS out_arrays;
+CREATE WRITABLE EXTERNAL TABLE out_arrays (
+    id int,
+    tags text[],
+    ids int[],
+    f float8[]
+) LOCATION (
+    'gpfdist://localhost:8081/out/arrays.dat'
+) FORMAT 'custom' (
+    formatter=json_formatter_write
+);
+
 DROP EXTERNAL TABLE IF EXISTS out_nested;
 CREATE WRITABLE EXTERNAL TABLE out_nested (
     id int,
@@ -125,6 +458,30 @@ CREATE WRITABLE EXTERNAL TABLE out_nested (
     formatter=json_formatter_write
 );
 
+DROP EXTERNAL TABLE IF EXISTS out_null_null;
+CREATE WRITABLE EXTERNAL TABLE out_null_null (
+    id int,
+    "sub.subid" int,
+    "sub.subsub.subsubid" text
+) LOCATION (
+    'gpfdist://localhost:8081/out/null_null.dat'
+) FORMAT 'custom' (
+    formatter=json_formatter_write,
+    null_mode='null'
+);
+
+DROP EXTERNAL TABLE IF EXISTS out_null_omit;
+CREATE WRITABLE EXTERNAL TABLE out_null_omit (
+    id int,
+    "sub.subid" int,
+    "sub.subsub.subsubid" text
+) LOCATION (
+    'gpfdist://localhost:8081/out/null_omit.dat'
+) FORMAT 'custom' (
+    formatter=json_formatter_write,
+    null_mode='omit'
+);
+
 DROP EXTERNAL TABLE IF EXISTS out_twitter;
 CREATE WRITABLE EXTERNAL TABLE out_twitter (
     id bigint,
@@ -138,3 +495,134 @@ CREATE WRITABLE EXTERNAL TABLE out_twitter (
 ) FORMAT 'custom' (
     formatter=json_formatter_write
 );
+
+DROP EXTERNAL TABLE IF EXISTS out_types_msgpack;
+CREATE WRITABLE EXTERNAL TABLE out_types_msgpack (
+    id int,
+    i2 int2,
+    i4 int4,
+    i8 int8,
+    t text,
+    v varchar(255),
+    ts text,
+    f4 float4,
+    f8 float8
+) LOCATION (
+    'gpfdist://localhost:8081/out/types.msgpack'
+) FORMAT 'custom' (
+    formatter=json_formatter_msgpack_write
+);
+
+DROP EXTERNAL TABLE IF EXISTS types_msgpack;
+CREATE EXTERNAL TABLE types_msgpack (
+    id int,
+    i2 int2,
+    i4 int4,
+    i8 int8,
+    t text,
+    v varchar(255),
+    ts text,
+    f4 float4,
+    f8 float8
+) LOCATION (
+    'gpfdist://localhost:8081/out/types.msgpack'
+) FORMAT 'custom' (
+    formatter=json_formatter_msgpack_read
+);
+
+DROP EXTERNAL TABLE IF EXISTS out_nested_msgpack;
+CREATE WRITABLE EXTERNAL TABLE out_nested_msgpack (
+    id int,
+    "sub.subid" int,
+    "sub.subsub.subsubid" int
+) LOCATION (
+    'gpfdist://localhost:8081/out/nested.msgpack'
+) FORMAT 'custom' (
+    formatter=json_formatter_msgpack_write
+);
+
+DROP EXTERNAL TABLE IF EXISTS nested_msgpack;
+CREATE EXTERNAL TABLE nested_msgpack (
+    id int,
+    "sub.subid" int,
+    "sub.subsub.subsubid" int
+) LOCATION (
+    'gpfdist://localhost:8081/out/nested.msgpack'
+) FORMAT 'custom' (
+    formatter=json_formatter_msgpack_read
+);
+
+DROP EXTERNAL TABLE IF EXISTS out_arrays_msgpack;
+CREATE WRITABLE EXTERNAL TABLE out_arrays_msgpack (
+    id int,
+    tags text[],
+    ids int8[],
+    f float8[],
+    n numeric[]
+) LOCATION (
+    'gpfdist://localhost:8081/out/arrays.msgpack'
+) FORMAT 'custom' (
+    formatter=json_formatter_msgpack_write
+);
+
+DROP EXTERNAL TABLE IF EXISTS arrays_msgpack;
+CREATE EXTERNAL TABLE arrays_msgpack (
+    id int,
+    tags text[],
+    ids int8[],
+    f float8[],
+    n numeric[]
+) LOCATION (
+    'gpfdist://localhost:8081/out/arrays.msgpack'
+) FORMAT 'custom' (
+    formatter=json_formatter_msgpack_read
+);
+
+DROP EXTERNAL TABLE IF EXISTS out_types_gzip;
+CREATE WRITABLE EXTERNAL TABLE out_types_gzip (
+    id int,
+    i2 int2,
+    i4 int4,
+    i8 int8,
+    t text,
+    v varchar(255),
+    ts text,
+    f4 float4,
+    f8 float8
+) LOCATION (
+    'gpfdist://localhost:8081/out/types_gzip.dat'
+) FORMAT 'custom' (
+    formatter=json_formatter_write,
+    compression='gzip'
+);
+
+DROP EXTERNAL TABLE IF EXISTS types_gzip;
+CREATE EXTERNAL TABLE types_gzip (
+    id int,
+    i2 int2,
+    i4 int4,
+    i8 int8,
+    t text,
+    v varchar(255),
+    ts text,
+    f4 float4,
+    f8 float8
+) LOCATION (
+    'gpfdist://localhost:8081/data/types_gzip.dat'
+) FORMAT 'custom' (
+    formatter=json_formatter_read,
+    compression='gzip'
+);
+
+DROP EXTERNAL TABLE IF EXISTS nested_zstd;
+CREATE EXTERNAL TABLE nested_zstd (
+    id int,
+    "sub.subid" int,
+    "sub.subsub.subsubid" int
+) LOCATION (
+    'gpfdist://localhost:8081/data/nested_zstd.dat'
+) FORMAT 'custom' (
+    formatter=json_formatter_read,
+    compression='zstd',
+    engine='sax'
+);
@@ -49,6 +49,100 @@ it_in_twitter1000() {
     psql -tA -c "select linenum, errmsg, rawbytes from $SCHEMA_NAME.twitter1000_err" 2>&1 | diff - test/expected/twitter1000_err.out
 }
 
+it_in_sax_types() {
+    psql -tA -c "select * from $SCHEMA_NAME.types_sax" | diff - test/expected/types.out
+}
+
+it_in_types_columns() {
+    psql -tA -c "select * from $SCHEMA_NAME.types_columns" | diff - test/expected/types_columns.out
+}
+
+it_in_sax_types_columns() {
+    psql -tA -c "select * from $SCHEMA_NAME.types_columns_sax" | diff - test/expected/types_columns.out
+}
+
+it_in_sax_nested() {
+    psql -tA -c "select * from $SCHEMA_NAME.nested_sax" | diff - test/expected/nested.out
+}
+
+it_in_sax_twitter100() {
+    psql -tA -c "select * from $SCHEMA_NAME.twitter100_sax" 2>&1 | diff - test/expected/twitter100_sax.out
+    psql -tA -c "select linenum, errmsg, rawbytes from $SCHEMA_NAME.twitter100_sax_err" 2>&1 | diff - /dev/null
+}
+
+it_in_threads_twitter100() {
+    psql -tA -c "select * from $SCHEMA_NAME.twitter100_threads" 2>&1 | diff - test/expected/twitter100_sax.out
+    psql -tA -c "select linenum, errmsg, rawbytes from $SCHEMA_NAME.twitter100_threads_err" 2>&1 | diff - /dev/null
+}
+
+it_in_ndjson_twitter100() {
+    psql -tA -c "select * from $SCHEMA_NAME.twitter100_ndjson" 2>&1 | diff - test/expected/twitter100_sax.out
+    psql -tA -c "select linenum, errmsg, rawbytes from $SCHEMA_NAME.twitter100_ndjson_err" 2>&1 | diff - /dev/null
+}
+
+it_in_ndjson_error() {
+    psql -tA -c "select * from $SCHEMA_NAME.ndjson_error" 2>&1 | diff - test/expected/ndjson_error.out
+    psql -tA -c "select linenum, errmsg, rawbytes from $SCHEMA_NAME.ndjson_error_err" 2>&1 | diff - test/expected/ndjson_error_err.out
+}
+
+it_in_convert() {
+    psql -tA -c "select id, i2, d, ts, tz at time zone 'UTC', n, b, v from $SCHEMA_NAME.convert" 2>&1 | diff - test/expected/convert.out
+    psql -tA -c "select linenum, errmsg, rawbytes from $SCHEMA_NAME.convert_err" 2>&1 | diff - test/expected/convert_err.out
+}
+
+it_in_arrays() {
+    psql -tA -c "select * from $SCHEMA_NAME.arrays order by id" 2>&1 | diff - test/expected/arrays.out
+    psql -tA -c "select linenum, errmsg, rawbytes from $SCHEMA_NAME.arrays_err" 2>&1 | diff - test/expected/arrays_err.out
+}
+
+it_in_sax_arrays() {
+    psql -tA -c "select * from $SCHEMA_NAME.arrays_sax order by id" 2>&1 | diff - test/expected/arrays.out
+    psql -tA -c "select linenum, errmsg, rawbytes from $SCHEMA_NAME.arrays_sax_err" 2>&1 | diff - test/expected/arrays_err.out
+}
+
+it_in_sax_convert() {
+    psql -tA -c "select id, i2, d, ts, tz at time zone 'UTC', n, b, v from $SCHEMA_NAME.convert_sax" 2>&1 | diff - test/expected/convert.out
+    psql -tA -c "select linenum, errmsg, rawbytes from $SCHEMA_NAME.convert_sax_err" 2>&1 | diff - test/expected/convert_err.out
+}
+
+it_in_threads_convert() {
+    psql -tA -c "select id, i2, d, ts, tz at time zone 'UTC', n, b, v from $SCHEMA_NAME.convert_threads" 2>&1 | diff - test/expected/convert.out
+    psql -tA -c "select linenum, errmsg, rawbytes from $SCHEMA_NAME.convert_threads_err" 2>&1 | diff - test/expected/convert_err.out
+}
+
+it_in_raw() {
+    psql -tA -c "select * from $SCHEMA_NAME.raw" | diff - test/expected/raw.out
+}
+
+it_in_raw_minify() {
+    psql -tA -c "select * from $SCHEMA_NAME.raw_minify" | diff - test/expected/raw_minify.out
+}
+
+it_in_filter() {
+    psql -tA -c "select * from $SCHEMA_NAME.filter order by id" | diff - test/expected/filter.out
+}
+
+it_in_filter_range() {
+    psql -tA -c "select * from $SCHEMA_NAME.filter_range order by id" | diff - test/expected/filter_range.out
+}
+
+it_in_filter_exact() {
+    psql -tA -c "select * from $SCHEMA_NAME.filter_exact order by id" | diff - test/expected/filter_exact.out
+}
+
+it_in_unnest() {
+    psql -tA -c "select * from $SCHEMA_NAME.unnest order by id, \"items.sku\"" | diff - test/expected/unnest.out
+}
+
+it_in_array() {
+    psql -tA -c "select * from $SCHEMA_NAME.array order by id" | diff - test/expected/array.out
+}
+
+it_in_array_malformed() {
+    psql -tA -c "select * from $SCHEMA_NAME.array_nested" 2>&1 | grep -q "expected '{' found '\['"
+    psql -tA -c "select * from $SCHEMA_NAME.array_unclosed" 2>&1 | grep -q "top level array is not closed"
+}
+
 it_out_sanity() {
     psql -tA -c "insert into $SCHEMA_NAME.out_basic select generate_series(0,3)"
     diff test/out/basic.dat test/expected/out_basic.dat
@@ -59,13 +153,60 @@ it_out_types() {
     diff test/out/types.dat test/expected/out_types.dat
 }
 
+it_out_convert() {
+    psql -tA -c "insert into $SCHEMA_NAME.out_convert select 1, 12.50, '2013-05-01'::date, '2013-05-01 12:30:00.25'::timestamp, true union all select 2, null, null, null, null"
+    sort test/out/convert.dat | diff - test/expected/out_convert.dat
+}
+
+it_out_arrays() {
+    psql -tA -c "insert into $SCHEMA_NAME.out_arrays select 1, array['a', 'b\"c'], array[1, 2, null], array[[1.5, 2], [3, 4]]::float8[] union all select 2, '{}', null, null"
+    sort test/out/arrays.dat | diff - test/expected/out_arrays.dat
+}
+
 it_out_nested() {
     psql -tA -c "insert into $SCHEMA_NAME.out_nested select 1, 2, 3"
     diff test/out/nested.dat test/expected/out_nested.dat
 }
 
+it_out_null_null() {
+    psql -tA -c "insert into $SCHEMA_NAME.out_null_null values (1, 2, 'a'), (2, null, 'b'), (3, 4, null), (4, null, null), (null, null, null)"
+    sort test/out/null_null.dat | diff - test/expected/out_null_null.dat
+}
+
+it_out_null_omit() {
+    psql -tA -c "insert into $SCHEMA_NAME.out_null_omit values (1, 2, 'a'), (2, null, 'b'), (3, 4, null), (4, null, null), (null, null, null)"
+    sort test/out/null_omit.dat | diff - test/expected/out_null_omit.dat
+}
+
 it_out_twitter() {
     psql -tA -c "insert into $SCHEMA_NAME.out_twitter select * from $SCHEMA_NAME.twitter100 order by id"
     #diff test/out/twitter.json test/expected/out_twitter100.json
     sort test/out/twitter.json | diff - test/expected/out_twitter100.json
 }
+
+it_msgpack_types() {
+    psql -tA -c "insert into $SCHEMA_NAME.out_types_msgpack select * from $SCHEMA_NAME.types"
+    psql -tA -c "select * from $SCHEMA_NAME.types_msgpack" | diff - test/expected/types.out
+}
+
+it_msgpack_nested() {
+    psql -tA -c "insert into $SCHEMA_NAME.out_nested_msgpack select * from $SCHEMA_NAME.nested"
+    psql -tA -c "select * from $SCHEMA_NAME.nested_msgpack order by id" | diff - test/expected/nested.out
+}
+
+it_msgpack_arrays() {
+    psql -tA -c "insert into $SCHEMA_NAME.out_arrays_msgpack select * from $SCHEMA_NAME.arrays"
+    psql -tA -c "select * from $SCHEMA_NAME.arrays_msgpack order by id" | diff - test/expected/arrays.out
+}
+
+it_out_gzip() {
+    psql -tA -c "insert into $SCHEMA_NAME.out_types_gzip select * from $SCHEMA_NAME.types" 2>&1 | grep -q "only readable tables can be compressed"
+}
+
+it_in_gzip() {
+    psql -tA -c "select * from $SCHEMA_NAME.types_gzip" | diff - test/expected/types.out
+}
+
+it_in_zstd() {
+    psql -tA -c "select * from $SCHEMA_NAME.nested_zstd order by id" | diff - test/expected/nested.out
+}